@@ -0,0 +1,413 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "BrickCache.h"
+#include "Trace.h"
+#include <algorithm>
+#include <string.h>
+#include <QDebug>
+
+/**
+ * @brief BrickCache::BrickCache
+ */
+BrickCache::BrickCache() :
+    volumeFile_(NULL),
+    classifier_(NULL),
+    useCounter_(0),
+    frameCounter_(0),
+    framePageIns_(0),
+    framePageInBudget_(PAGE_IN_BUDGET),
+    frameDeferred_(0),
+    slotSize_(0),
+    scalarTexture_(false),
+    pageInCount_(0)
+{
+    volumeSize_[0] = volumeSize_[1] = volumeSize_[2] = 0;
+}
+
+/**
+ * @brief BrickCache::~BrickCache
+ * The textures belong to the OpenGL context, call Release while it is
+ * still current.
+ */
+BrickCache::~BrickCache() { }
+
+/**
+ * @brief BrickCache::Initialize
+ * @param volumeFile
+ * @param classifier
+ * @param width
+ * @param height
+ * @param depth
+ * @param brickSize
+ * @param memoryBudget
+ * @param scalarTexture
+ */
+void BrickCache::Initialize(VolumeFile* volumeFile,
+                            const VolumeClassifier* classifier,
+                            int width, int height, int depth,
+                            int brickSize, qint64 memoryBudget,
+                            bool scalarTexture)
+{
+    Release();
+
+    volumeFile_ = volumeFile;
+    classifier_ = classifier;
+    volumeSize_[0] = width;
+    volumeSize_[1] = height;
+    volumeSize_[2] = depth;
+    scalarTexture_ = scalarTexture;
+
+    // Lay out the bricks, the last one along each axis may be shorter
+    int brickCount[3];
+    for (int axis = 0; axis < 3; axis++) {
+        brickCount[axis] = (volumeSize_[axis] + brickSize - 1) / brickSize;
+    }
+
+    bricks_.clear();
+    for (int k = 0; k < brickCount[2]; k++) {
+        for (int j = 0; j < brickCount[1]; j++) {
+            for (int i = 0; i < brickCount[0]; i++) {
+                Brick brick;
+                const int index[3] = { i, j, k };
+                for (int axis = 0; axis < 3; axis++) {
+                    brick.origin[axis] = index[axis] * brickSize;
+                    brick.size[axis] = qMin(brickSize,
+                            volumeSize_[axis] - brick.origin[axis]);
+                }
+                brick.slot = -1;
+                bricks_.push_back(brick);
+            }
+        }
+    }
+
+    // Size the pool from the memory budget
+    slotSize_ = brickSize + 2 * GHOST_VOXELS;
+    const qint64 texelBytes = scalarTexture_ ? 1 : 4;
+    const qint64 slotBytes =
+            texelBytes * slotSize_ * slotSize_ * (qint64) slotSize_;
+    const int slotCount = qBound((qint64) 1, memoryBudget / slotBytes,
+                                 (qint64) bricks_.size());
+
+    slotTextures_.resize(slotCount);
+    slotBricks_.fill(-1, slotCount);
+    slotLastUse_.fill(0, slotCount);
+    slotFrame_.fill(-1, slotCount);
+
+    glGenTextures(slotCount, slotTextures_.data());
+    for (int slot = 0; slot < slotCount; slot++) {
+        glBindTexture(GL_TEXTURE_3D, slotTextures_[slot]);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+        if (scalarTexture_) {
+            glTexImage3D(GL_TEXTURE_3D, 0, GL_R8,
+                         slotSize_, slotSize_, slotSize_,
+                         0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+        } else {
+            glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA,
+                         slotSize_, slotSize_, slotSize_,
+                         0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        }
+    }
+
+    rawStaging_.resize(slotSize_ * slotSize_ * slotSize_);
+    if (!scalarTexture_)
+        rgbaStaging_.resize(4 * rawStaging_.size());
+}
+
+/**
+ * @brief BrickCache::Release
+ */
+void BrickCache::Release()
+{
+    if (!slotTextures_.isEmpty())
+        glDeleteTextures(slotTextures_.size(), slotTextures_.constData());
+
+    slotTextures_.clear();
+    slotBricks_.clear();
+    slotLastUse_.clear();
+    slotFrame_.clear();
+    bricks_.clear();
+}
+
+/**
+ * @brief BrickCache::Invalidate
+ */
+void BrickCache::Invalidate()
+{
+    for (int slot = 0; slot < slotBricks_.size(); slot++) {
+        if (slotBricks_[slot] >= 0)
+            bricks_[slotBricks_[slot]].slot = -1;
+
+        slotBricks_[slot] = -1;
+        slotLastUse_[slot] = 0;
+        slotFrame_[slot] = -1;
+    }
+}
+
+/**
+ * @brief BrickCache::GetBrickCount
+ * @return
+ */
+int BrickCache::GetBrickCount() const
+{
+    return bricks_.size();
+}
+
+/**
+ * @brief BrickCache::GetBrick
+ * @param index
+ * @return
+ */
+const BrickCache::Brick& BrickCache::GetBrick(int index) const
+{
+    return bricks_[index];
+}
+
+/**
+ * @brief BrickCache::GetSlotSize
+ * @return
+ */
+int BrickCache::GetSlotSize() const
+{
+    return slotSize_;
+}
+
+/**
+ * @brief BrickCache::GetPageInCount
+ * @return
+ */
+qint64 BrickCache::GetPageInCount() const
+{
+    return pageInCount_;
+}
+
+/**
+ * @brief BrickCache::GetVisibilityOrder
+ * The bricks form a regular grid, so ordering their centres by depth along
+ * the view direction is a valid back-to-front order.
+ * @param viewDirection
+ * @return
+ */
+QVector<int> BrickCache::GetVisibilityOrder(
+        const QVector3D& viewDirection) const
+{
+    QVector< QPair<float, int> > depths;
+    depths.reserve(bricks_.size());
+
+    for (int i = 0; i < bricks_.size(); i++) {
+        const Brick& brick = bricks_[i];
+        const QVector3D centre(brick.origin[0] + 0.5f * brick.size[0],
+                               brick.origin[1] + 0.5f * brick.size[1],
+                               brick.origin[2] + 0.5f * brick.size[2]);
+        depths.push_back(qMakePair(QVector3D::dotProduct(centre,
+                                                         viewDirection), i));
+    }
+
+    // Farthest first
+    std::sort(depths.begin(), depths.end());
+
+    QVector<int> order;
+    order.reserve(depths.size());
+    for (int i = depths.size() - 1; i >= 0; i--) {
+        order.push_back(depths[i].second);
+    }
+
+    return order;
+}
+
+/**
+ * @brief BrickCache::BeginFrame
+ * @param pageInBudget
+ */
+void BrickCache::BeginFrame(int pageInBudget)
+{
+    frameCounter_++;
+    framePageIns_ = 0;
+    framePageInBudget_ = pageInBudget;
+    frameDeferred_ = 0;
+}
+
+/**
+ * @brief BrickCache::GetDeferredCount
+ * @return
+ */
+int BrickCache::GetDeferredCount() const
+{
+    return frameDeferred_;
+}
+
+/**
+ * @brief BrickCache::Bind
+ * @param index
+ * @return
+ */
+bool BrickCache::Bind(int index)
+{
+    Brick& brick = bricks_[index];
+
+    if (brick.slot < 0) {
+        // Reading and classifying a brick takes milliseconds, spread the
+        // misses of a new view over several frames
+        if (framePageInBudget_ >= 0 && framePageIns_ >= framePageInBudget_) {
+            frameDeferred_++;
+            return false;
+        }
+
+        // Evict the least recently used slot among the ones this frame has
+        // not drawn with. If the frame drew with all of them, evicting the
+        // most recently used one keeps the rest of the pool for the next
+        // frame, where LRU order would evict each brick just before it is
+        // needed again.
+        int victim = -1;
+        int newest = 0;
+        for (int slot = 0; slot < slotLastUse_.size(); slot++) {
+            if (slotFrame_[slot] != frameCounter_ &&
+                    (victim < 0 || slotLastUse_[slot] < slotLastUse_[victim]))
+                victim = slot;
+            if (slotLastUse_[slot] > slotLastUse_[newest])
+                newest = slot;
+        }
+        if (victim < 0)
+            victim = newest;
+
+        if (slotBricks_[victim] >= 0)
+            bricks_[slotBricks_[victim]].slot = -1;
+
+        PageIn(index, victim);
+        slotBricks_[victim] = index;
+        brick.slot = victim;
+        framePageIns_++;
+    }
+
+    slotLastUse_[brick.slot] = ++useCounter_;
+    slotFrame_[brick.slot] = frameCounter_;
+    glBindTexture(GL_TEXTURE_3D, slotTextures_[brick.slot]);
+    return true;
+}
+
+/**
+ * @brief BrickCache::PageIn
+ * @param index
+ * @param slot
+ */
+void BrickCache::PageIn(int index, int slot)
+{
+    TRACE_SCOPE("BrickCache::PageIn");
+
+    const Brick& brick = bricks_[index];
+    const int g = GHOST_VOXELS;
+    const int width = volumeSize_[0];
+    const int height = volumeSize_[1];
+    const int depth = volumeSize_[2];
+
+    // Texels of the brick, ghost voxels included
+    const int tx = brick.size[0] + 2 * g;
+    const int ty = brick.size[1] + 2 * g;
+    const int tz = brick.size[2] + 2 * g;
+
+    // Columns covered by the file, the ghost columns outside the volume
+    // replicate the border
+    const int x0 = qMax(brick.origin[0] - g, 0);
+    const int x1 = qMin(brick.origin[0] + brick.size[0] + g, width);
+    const int leftPad = x0 - (brick.origin[0] - g);
+    const int columns = x1 - x0;
+
+    GLubyte* row = rawStaging_.data();
+    for (int k = 0; k < tz; k++) {
+        const int z = qBound(0, brick.origin[2] - g + k, depth - 1);
+
+        for (int j = 0; j < ty; j++) {
+            const int y = qBound(0, brick.origin[1] - g + j, height - 1);
+            const qint64 offset = ((qint64) z * height + y) * width + x0;
+
+            if (!volumeFile_->Read(offset, columns, row + leftPad)) {
+                qDebug() << "Could not read brick" << index;
+                memset(row + leftPad, 0, columns);
+            }
+
+            for (int i = 0; i < leftPad; i++) {
+                row[i] = row[leftPad];
+            }
+            for (int i = leftPad + columns; i < tx; i++) {
+                row[i] = row[leftPad + columns - 1];
+            }
+
+            row += tx;
+        }
+    }
+
+    PaintOutline(brick);
+
+    glBindTexture(GL_TEXTURE_3D, slotTextures_[slot]);
+    if (scalarTexture_) {
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, tx, ty, tz,
+                        GL_RED, GL_UNSIGNED_BYTE, rawStaging_.constData());
+    } else {
+        classifier_->Classify(rawStaging_.constData(), rgbaStaging_.data(),
+                              (qint64) tx * ty * tz);
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, tx, ty, tz,
+                        GL_RGBA, GL_UNSIGNED_BYTE, rgbaStaging_.constData());
+    }
+
+    pageInCount_++;
+}
+
+/**
+ * @brief BrickCache::PaintOutline
+ * A voxel is on the outline when two of its volume coordinates are in the
+ * outline band.
+ * @param brick
+ */
+void BrickCache::PaintOutline(const Brick& brick)
+{
+    const int g = GHOST_VOXELS;
+    const int tx = brick.size[0] + 2 * g;
+    const int ty = brick.size[1] + 2 * g;
+    const int tz = brick.size[2] + 2 * g;
+
+    GLubyte* row = rawStaging_.data();
+    for (int k = 0; k < tz; k++) {
+        const int z = qBound(0, brick.origin[2] - g + k, volumeSize_[2] - 1);
+        const bool zInBand = VolumeClassifier::InOutlineBand(z, volumeSize_[2]);
+
+        for (int j = 0; j < ty; j++, row += tx) {
+            const int y = qBound(0, brick.origin[1] - g + j,
+                                 volumeSize_[1] - 1);
+            const bool yInBand =
+                    VolumeClassifier::InOutlineBand(y, volumeSize_[1]);
+
+            if (!zInBand && !yInBand)
+                continue;
+
+            for (int i = 0; i < tx; i++) {
+                const int x = qBound(0, brick.origin[0] - g + i,
+                                     volumeSize_[0] - 1);
+                if ((zInBand && yInBand) ||
+                        VolumeClassifier::InOutlineBand(x, volumeSize_[0])) {
+                    row[i] = VolumeClassifier::OUTLINE_VALUE;
+                }
+            }
+        }
+    }
+}
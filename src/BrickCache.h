@@ -0,0 +1,238 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef BRICKCACHE_H
+#define BRICKCACHE_H
+
+#include <QPair>
+#include <QVector>
+#include <QVector3D>
+#include "VolumeFile.h"
+#include "VolumeClassifier.h"
+
+/**
+ * @brief The BrickCache class
+ * Splits a volume that does not fit in a single 3D texture into bricks and
+ * keeps the most recently used ones resident in a fixed pool of textures.
+ * Bricks are read from the volume file when they are first needed, a few of
+ * them per frame, and carry a layer of ghost voxels so
+ * that linear filtering is seamless across brick faces.
+ */
+class BrickCache
+{
+public:
+    /**
+     * @brief The Brick struct
+     */
+    struct Brick
+    {
+        /** \brief First voxel of the brick, ghost voxels excluded */
+        int origin[3];
+
+        /** \brief Number of voxels, ghost voxels excluded */
+        int size[3];
+
+        /** \brief Texture pool slot, -1 if the brick is not resident */
+        int slot;
+    };
+
+    /**
+     * @brief BrickCache
+     */
+    BrickCache();
+
+    /**
+     * @brief ~BrickCache
+     */
+    ~BrickCache();
+
+    /**
+     * @brief Initialize
+     * Lays out the bricks and allocates the texture pool, needs a current
+     * OpenGL context.
+     * @param volumeFile Source of the voxels, must stay open.
+     * @param classifier Transfer function for RGBA bricks.
+     * @param width
+     * @param height
+     * @param depth
+     * @param brickSize Edge of a brick in voxels, ghost voxels excluded.
+     * @param memoryBudget Bytes of texture memory for the pool.
+     * @param scalarTexture Store raw scalars instead of RGBA texels.
+     */
+    void Initialize(VolumeFile* volumeFile,
+                    const VolumeClassifier* classifier,
+                    int width, int height, int depth,
+                    int brickSize, qint64 memoryBudget,
+                    bool scalarTexture);
+
+    /**
+     * @brief Release
+     * Deletes the texture pool, needs a current OpenGL context.
+     */
+    void Release();
+
+    /**
+     * @brief Invalidate
+     * Drops every resident brick, for example when the transfer function
+     * baked into RGBA bricks changes.
+     */
+    void Invalidate();
+
+    /**
+     * @brief GetBrickCount
+     * @return
+     */
+    int GetBrickCount() const;
+
+    /**
+     * @brief GetBrick
+     * @param index
+     * @return
+     */
+    const Brick& GetBrick(int index) const;
+
+    /**
+     * @brief GetSlotSize
+     * @return Edge of a pool texture in texels, ghost voxels included.
+     */
+    int GetSlotSize() const;
+
+    /**
+     * @brief GetVisibilityOrder
+     * Sorts the bricks back to front for an orthographic view.
+     * @param viewDirection Direction the camera looks at in normalized
+     * volume space, divided by the volume dimensions.
+     * @return Brick indices, farthest first.
+     */
+    QVector<int> GetVisibilityOrder(const QVector3D& viewDirection) const;
+
+    /**
+     * @brief BeginFrame
+     * Starts a frame, the slots bound from here on are not evicted again
+     * before the next call.
+     * @param pageInBudget Bricks that may be paged in during the frame,
+     * negative for as many as it needs.
+     */
+    void BeginFrame(int pageInBudget = PAGE_IN_BUDGET);
+
+    /**
+     * @brief Bind
+     * Makes the brick resident and binds its texture to GL_TEXTURE_3D. A
+     * full pool evicts the least recently used brick that was not bound
+     * in this frame, or the most recently used one if all of them were, so
+     * that a frame needing more bricks than slots does not cycle the whole
+     * pool.
+     * @param index
+     * @return False if the brick is not resident and the page-in budget of
+     * the frame is spent, the brick should be skipped until a later frame.
+     */
+    bool Bind(int index);
+
+    /**
+     * @brief GetDeferredCount
+     * @return Number of bricks left out of the current frame for the
+     * page-in budget.
+     */
+    int GetDeferredCount() const;
+
+    /**
+     * @brief GetPageInCount
+     * @return Number of bricks read from the volume file so far.
+     */
+    qint64 GetPageInCount() const;
+
+    /** \brief Ghost voxels on each side of a brick */
+    static const int GHOST_VOXELS = 1;
+
+    /** \brief Bricks read and uploaded per frame at most */
+    static const int PAGE_IN_BUDGET = 4;
+
+private:
+    /**
+     * @brief PageIn
+     * Reads the brick from the volume file and uploads it to a slot.
+     * @param index
+     * @param slot
+     */
+    void PageIn(int index, int slot);
+
+    /**
+     * @brief PaintOutline
+     * Writes the bounding-box outline into the raw staging buffer.
+     * @param brick
+     */
+    void PaintOutline(const Brick& brick);
+
+private:
+    /** \brief Volume file */
+    VolumeFile* volumeFile_;
+
+    /** \brief Transfer function */
+    const VolumeClassifier* classifier_;
+
+    /** \brief Volume dimensions */
+    int volumeSize_[3];
+
+    /** \brief Bricks in x-fastest order */
+    QVector<Brick> bricks_;
+
+    /** \brief Pool textures */
+    QVector<GLuint> slotTextures_;
+
+    /** \brief Brick held by each slot, -1 if the slot is free */
+    QVector<int> slotBricks_;
+
+    /** \brief Last use of each slot, for the LRU eviction */
+    QVector<qint64> slotLastUse_;
+
+    /** \brief Frame in which each slot was last bound */
+    QVector<qint64> slotFrame_;
+
+    /** \brief Incremented on every Bind */
+    qint64 useCounter_;
+
+    /** \brief Incremented on every BeginFrame */
+    qint64 frameCounter_;
+
+    /** \brief Bricks paged in during the current frame */
+    int framePageIns_;
+
+    /** \brief Bricks that may be paged in during the current frame */
+    int framePageInBudget_;
+
+    /** \brief Bricks left out of the current frame */
+    int frameDeferred_;
+
+    /** \brief Edge of a pool texture in texels */
+    int slotSize_;
+
+    /** \brief Store raw scalars instead of RGBA texels */
+    bool scalarTexture_;
+
+    /** \brief Raw voxels of the brick being paged in */
+    QVector<GLubyte> rawStaging_;
+
+    /** \brief Classified voxels of the brick being paged in */
+    QVector<GLubyte> rgbaStaging_;
+
+    /** \brief Number of bricks read so far */
+    qint64 pageInCount_;
+};
+
+#endif // BRICKCACHE_H
@@ -0,0 +1,126 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "CameraPath.h"
+#include <QFile>
+#include <QTextStream>
+
+/**
+ * @brief CameraPath::CameraPath
+ */
+CameraPath::CameraPath()
+{
+}
+
+/**
+ * @brief CameraPath::Clear
+ */
+void CameraPath::Clear()
+{
+    keyframes_.clear();
+}
+
+/**
+ * @brief CameraPath::Append
+ * @param time
+ * @param camera
+ */
+void CameraPath::Append(qint64 time, const CameraState& camera)
+{
+    Keyframe keyframe;
+    keyframe.time = time;
+    keyframe.camera = camera;
+    keyframes_.append(keyframe);
+}
+
+/**
+ * @brief CameraPath::GetKeyframes
+ * @return
+ */
+const QVector<CameraPath::Keyframe>& CameraPath::GetKeyframes() const
+{
+    return keyframes_;
+}
+
+/**
+ * @brief CameraPath::Load
+ * @param fileName
+ * @return
+ */
+bool CameraPath::Load(const QString& fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+
+    keyframes_.clear();
+    QTextStream stream(&file);
+    while (!stream.atEnd()) {
+        const QString line = stream.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        const QStringList fields = line.split(' ', QString::SkipEmptyParts);
+        if (fields.size() != 6)
+            return false;
+
+        bool valid[6];
+        Keyframe keyframe;
+        keyframe.time = fields[0].toLongLong(&valid[0]);
+        keyframe.camera.xRotation = fields[1].toFloat(&valid[1]);
+        keyframe.camera.yRotation = fields[2].toFloat(&valid[2]);
+        keyframe.camera.zRotation = fields[3].toFloat(&valid[3]);
+        keyframe.camera.zTranslation = fields[4].toFloat(&valid[4]);
+        keyframe.camera.scale = fields[5].toFloat(&valid[5]);
+        for (int i = 0; i < 6; i++) {
+            if (!valid[i])
+                return false;
+        }
+        keyframes_.append(keyframe);
+    }
+    return true;
+}
+
+/**
+ * @brief CameraPath::Save
+ * @param fileName
+ * @return
+ */
+bool CameraPath::Save(const QString& fileName) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate |
+                   QIODevice::Text))
+        return false;
+
+    QTextStream stream(&file);
+    stream << "# time_ms x_rotation y_rotation z_rotation z_translation scale\n";
+    stream.setRealNumberPrecision(9);
+    for (int i = 0; i < keyframes_.size(); i++) {
+        const Keyframe& keyframe = keyframes_[i];
+        stream << keyframe.time << ' '
+               << keyframe.camera.xRotation << ' '
+               << keyframe.camera.yRotation << ' '
+               << keyframe.camera.zRotation << ' '
+               << keyframe.camera.zTranslation << ' '
+               << keyframe.camera.scale << '\n';
+    }
+    stream.flush();
+    return stream.status() == QTextStream::Ok;
+}
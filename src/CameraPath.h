@@ -0,0 +1,108 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef CAMERAPATH_H
+#define CAMERAPATH_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief The CameraState struct
+ * Everything the view of the volume depends on.
+ */
+struct CameraState
+{
+    /** \brief Rotations about the X, Y and Z axes in degrees */
+    float xRotation;
+    float yRotation;
+    float zRotation;
+
+    /** \brief Distance along the view axis */
+    float zTranslation;
+
+    /** \brief Zoom factor */
+    float scale;
+};
+
+/**
+ * @brief The CameraPath class
+ * Timestamped camera states, recorded once per frame from an interactive
+ * session and replayed frame by frame. Stored as text, one frame per line.
+ */
+class CameraPath
+{
+public:
+    /**
+     * @brief The Keyframe struct
+     * Camera of a frame.
+     */
+    struct Keyframe
+    {
+        /** \brief Milliseconds since the recording started */
+        qint64 time;
+
+        CameraState camera;
+    };
+
+    /**
+     * @brief CameraPath
+     */
+    CameraPath();
+
+    /**
+     * @brief Clear
+     */
+    void Clear();
+
+    /**
+     * @brief Append
+     * Adds the keyframe of a frame.
+     * @param time
+     * @param camera
+     */
+    void Append(qint64 time, const CameraState& camera);
+
+    /**
+     * @brief GetKeyframes
+     * @return
+     */
+    const QVector<Keyframe>& GetKeyframes() const;
+
+    /**
+     * @brief Load
+     * @param fileName
+     * @return False if the file could not be read or is malformed.
+     */
+    bool Load(const QString& fileName);
+
+    /**
+     * @brief Save
+     * @param fileName
+     * @return False if the file could not be written.
+     */
+    bool Save(const QString& fileName) const;
+
+private:
+    /** \brief Keyframes in time order */
+    QVector<Keyframe> keyframes_;
+};
+
+#endif // CAMERAPATH_H
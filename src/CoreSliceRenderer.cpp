@@ -0,0 +1,248 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "CoreSliceRenderer.h"
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QDebug>
+#include <math.h>
+
+/** \brief Places the instance of the quad on its plane */
+static const char* SLICE_VERTEX_SHADER =
+    "#version 330 core\n"
+    "layout(location = 0) in vec2 corner;\n"
+    "uniform mat4 projection;\n"
+    "uniform mat4 eyeToVolume;\n"
+    "uniform vec2 boxCenter;\n"
+    "uniform float boxRadius;\n"
+    "uniform int firstSlice;\n"
+    "uniform float sliceSpacing;\n"
+    "uniform float sliceOffset;\n"
+    "uniform vec3 textureScale;\n"
+    "uniform vec3 textureOffset;\n"
+    "out vec3 volumeCoord;\n"
+    "out vec3 textureCoord;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 eye = vec4(boxCenter + corner * boxRadius,\n"
+    "                    (float(firstSlice + gl_InstanceID) + sliceOffset) *\n"
+    "                    sliceSpacing, 1.0);\n"
+    "    volumeCoord = (eyeToVolume * eye).xyz;\n"
+    "    textureCoord = volumeCoord * textureScale + textureOffset;\n"
+    "    gl_Position = projection * eye;\n"
+    "}\n";
+
+/** \brief Clips the quad to the box and samples the volume, the scalar is
+ * rescaled so that it hits the centres of the table texels. The opacities
+ * are corrected for the ratio between the slice and the reference
+ * distance. */
+static const char* SLICE_FRAGMENT_SHADER =
+    "in vec3 volumeCoord;\n"
+    "in vec3 textureCoord;\n"
+    "uniform sampler3D volume;\n"
+    "uniform sampler1D transferFunction;\n"
+    "uniform vec3 boxMin;\n"
+    "uniform vec3 boxMax;\n"
+    "uniform float opacityExponent;\n"
+    "out vec4 color;\n"
+    "void main()\n"
+    "{\n"
+    "    if (any(lessThan(volumeCoord, boxMin)) ||\n"
+    "            any(greaterThanEqual(volumeCoord, boxMax)))\n"
+    "        discard;\n"
+    "    vec4 texel = texture(volume, textureCoord);\n"
+    "#ifdef SCALAR_TEXTURE\n"
+    "    color = texture(transferFunction,\n"
+    "                    texel.r * (255.0 / 256.0) + 0.5 / 256.0);\n"
+    "#else\n"
+    "    color = texel;\n"
+    "#endif\n"
+    "    if (color.a > 0.0)\n"
+    "        color *= (1.0 - pow(1.0 - color.a, opacityExponent)) / color.a;\n"
+    "}\n";
+
+/**
+ * @brief CoreSliceRenderer::CoreSliceRenderer
+ */
+CoreSliceRenderer::CoreSliceRenderer() :
+    program_(NULL),
+    quadBuffer_(QOpenGLBuffer::VertexBuffer),
+    halfSlices_(0),
+    eyeSpacing_(1.f),
+    offset_(0.f) { }
+
+/**
+ * @brief CoreSliceRenderer::~CoreSliceRenderer
+ */
+CoreSliceRenderer::~CoreSliceRenderer()
+{
+    delete program_;
+}
+
+/**
+ * @brief CoreSliceRenderer::Initialize
+ * @param scalarTexture
+ * @return
+ */
+bool CoreSliceRenderer::Initialize(bool scalarTexture)
+{
+    QByteArray fragmentSource("#version 330 core\n");
+    if (scalarTexture)
+        fragmentSource += "#define SCALAR_TEXTURE\n";
+    fragmentSource += SLICE_FRAGMENT_SHADER;
+
+    program_ = new QOpenGLShaderProgram();
+    program_->addShaderFromSourceCode(QOpenGLShader::Vertex,
+                                      SLICE_VERTEX_SHADER);
+    program_->addShaderFromSourceCode(QOpenGLShader::Fragment,
+                                      fragmentSource);
+    if (!program_->link()) {
+        qDebug() << "Could not link the core slicing shader "
+                 << program_->log();
+        return false;
+    }
+
+    program_->bind();
+    program_->setUniformValue("volume", 0);
+    program_->setUniformValue("transferFunction", 1);
+    program_->release();
+
+    // One quad for all the slices, resized per box in the vertex shader
+    const GLfloat corners[] = {
+        -1.0, -1.0,
+         1.0, -1.0,
+        -1.0,  1.0,
+         1.0,  1.0
+    };
+
+    vertexArray_.create();
+    vertexArray_.bind();
+
+    quadBuffer_.create();
+    quadBuffer_.bind();
+    quadBuffer_.allocate(corners, sizeof(corners));
+
+    program_->enableAttributeArray(0);
+    program_->setAttributeBuffer(0, GL_FLOAT, 0, 2);
+
+    vertexArray_.release();
+    quadBuffer_.release();
+
+    return true;
+}
+
+/**
+ * @brief CoreSliceRenderer::Release
+ */
+void CoreSliceRenderer::Release()
+{
+    vertexArray_.destroy();
+    quadBuffer_.destroy();
+    delete program_;
+    program_ = NULL;
+}
+
+/**
+ * @brief CoreSliceRenderer::Begin
+ * @param projection
+ * @param modelView
+ * @param halfSlices
+ * @param spacing
+ * @param offset
+ * @param opacityExponent
+ */
+void CoreSliceRenderer::Begin(const QMatrix4x4& projection,
+                              const QMatrix4x4& modelView,
+                              int halfSlices, float spacing, float offset,
+                              float opacityExponent)
+{
+    modelView_ = modelView;
+    halfSlices_ = halfSlices;
+    offset_ = offset;
+
+    // The planes are fixed in the view, only the volume scale moves them
+    eyeSpacing_ = spacing * modelView.mapVector(QVector3D(1.0, 0.0, 0.0))
+                                     .length();
+
+    program_->bind();
+    program_->setUniformValue("projection", projection);
+    program_->setUniformValue("eyeToVolume", modelView.inverted());
+    program_->setUniformValue("sliceSpacing", eyeSpacing_);
+    program_->setUniformValue("sliceOffset", offset_);
+    program_->setUniformValue("opacityExponent", opacityExponent);
+    vertexArray_.bind();
+}
+
+/**
+ * @brief CoreSliceRenderer::DrawBox
+ * @param boxMin
+ * @param boxMax
+ * @param textureScale
+ * @param textureOffset
+ */
+void CoreSliceRenderer::DrawBox(const QVector3D& boxMin,
+                                const QVector3D& boxMax,
+                                const QVector3D& textureScale,
+                                const QVector3D& textureOffset)
+{
+    // Depth range of the box in eye space
+    float zMin = HUGE_VALF;
+    float zMax = -HUGE_VALF;
+    for (int c = 0; c < 8; c++) {
+        const QVector3D corner((c & 1) ? boxMax.x() : boxMin.x(),
+                               (c & 2) ? boxMax.y() : boxMin.y(),
+                               (c & 4) ? boxMax.z() : boxMin.z());
+        const float z = modelView_.map(corner).z();
+        zMin = qMin(zMin, z);
+        zMax = qMax(zMax, z);
+    }
+
+    const int first = qMax(-halfSlices_,
+                           (int) ceil(zMin / eyeSpacing_ - offset_));
+    const int last = qMin(halfSlices_,
+                          (int) floor(zMax / eyeSpacing_ - offset_));
+    if (first > last)
+        return;
+
+    // The quad covers the bounding sphere of the box
+    const QVector3D center = modelView_.map((boxMin + boxMax) * 0.5);
+    const float radius = 0.5 * (modelView_.map(boxMax) -
+                                modelView_.map(boxMin)).length();
+
+    program_->setUniformValue("boxCenter", center.toVector2D());
+    program_->setUniformValue("boxRadius", radius);
+    program_->setUniformValue("firstSlice", first);
+    program_->setUniformValue("boxMin", boxMin);
+    program_->setUniformValue("boxMax", boxMax);
+    program_->setUniformValue("textureScale", textureScale);
+    program_->setUniformValue("textureOffset", textureOffset);
+
+    // Instances are rasterized in order, so the planes stay back to front
+    QOpenGLContext::currentContext()->extraFunctions()->
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, last - first + 1);
+}
+
+/**
+ * @brief CoreSliceRenderer::End
+ */
+void CoreSliceRenderer::End()
+{
+    vertexArray_.release();
+    program_->release();
+}
@@ -0,0 +1,121 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef CORESLICERENDERER_H
+#define CORESLICERENDERER_H
+
+#include <QMatrix4x4>
+#include <QVector3D>
+#include <QOpenGLBuffer>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLVertexArrayObject>
+
+/**
+ * @brief The CoreSliceRenderer class
+ * Draws the slice stack with an OpenGL 3.3 core-profile pipeline. A single
+ * quad is instanced once per slice, the vertex shader places every
+ * instance on its plane and computes the texture coordinates, and the
+ * fragment shader discards whatever falls outside the box being drawn.
+ */
+class CoreSliceRenderer
+{
+public:
+    /**
+     * @brief CoreSliceRenderer
+     */
+    CoreSliceRenderer();
+
+    /**
+     * @brief ~CoreSliceRenderer
+     */
+    ~CoreSliceRenderer();
+
+    /**
+     * @brief Initialize
+     * Builds the shaders and the quad, needs a current core-profile
+     * context.
+     * @param scalarTexture Classify raw scalars through the 1D transfer
+     * function bound to texture unit 1.
+     * @return False if the shaders could not be built.
+     */
+    bool Initialize(bool scalarTexture);
+
+    /**
+     * @brief Release
+     * Deletes the GPU objects, needs a current context.
+     */
+    void Release();
+
+    /**
+     * @brief Begin
+     * Binds the pipeline for a frame.
+     * @param projection Eye to clip space.
+     * @param modelView Unit volume cube to eye space.
+     * @param halfSlices Number of planes on each side of the centre plane.
+     * @param spacing Distance between two planes in the unit cube.
+     * @param offset Shift of all the planes along the view axis, as a
+     * fraction of _spacing_.
+     * @param opacityExponent Ratio between _spacing_ and the distance the
+     * opacities of the volume are defined for.
+     */
+    void Begin(const QMatrix4x4& projection, const QMatrix4x4& modelView,
+               int halfSlices, float spacing, float offset,
+               float opacityExponent);
+
+    /**
+     * @brief DrawBox
+     * Draws the slices that cross a box of the unit cube, farthest first.
+     * @param boxMin
+     * @param boxMax
+     * @param textureScale Texture coordinate per unit of the cube.
+     * @param textureOffset Texture coordinate at the cube origin.
+     */
+    void DrawBox(const QVector3D& boxMin, const QVector3D& boxMax,
+                 const QVector3D& textureScale,
+                 const QVector3D& textureOffset);
+
+    /**
+     * @brief End
+     */
+    void End();
+
+private:
+    /** \brief Slicing program */
+    QOpenGLShaderProgram* program_;
+
+    /** \brief Vertex array of the quad */
+    QOpenGLVertexArrayObject vertexArray_;
+
+    /** \brief Corners of the quad */
+    QOpenGLBuffer quadBuffer_;
+
+    /** \brief Unit cube to eye space of the current frame */
+    QMatrix4x4 modelView_;
+
+    /** \brief Planes on each side of the centre plane */
+    int halfSlices_;
+
+    /** \brief Distance between two planes in eye space */
+    float eyeSpacing_;
+
+    /** \brief Shift of the planes in units of the spacing */
+    float offset_;
+};
+
+#endif // CORESLICERENDERER_H
@@ -0,0 +1,229 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "FrameAccumulator.h"
+#include "ShaderPrelude.h"
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QDebug>
+
+/** \brief Passes the window corner through */
+static const char* COPY_VERTEX_SHADER =
+    "attribute vec2 corner;\n"
+    "varying vec2 textureCoord;\n"
+    "void main()\n"
+    "{\n"
+    "    textureCoord = corner * 0.5 + 0.5;\n"
+    "    gl_Position = vec4(corner, 0.0, 1.0);\n"
+    "}\n";
+
+/** \brief Copies the texel under the pixel, the blending does the rest */
+static const char* COPY_FRAGMENT_SHADER =
+    "uniform sampler2D frame;\n"
+    "varying vec2 textureCoord;\n"
+    "void main()\n"
+    "{\n"
+    "    FRAG_COLOR = texture2D(frame, textureCoord);\n"
+    "}\n";
+
+/**
+ * @brief FrameAccumulator::FrameAccumulator
+ */
+FrameAccumulator::FrameAccumulator() :
+    program_(NULL),
+    quadBuffer_(QOpenGLBuffer::VertexBuffer),
+    frameFbo_(NULL),
+    averageFbo_(NULL),
+    targetFbo_(0),
+    frameCount_(0) { }
+
+/**
+ * @brief FrameAccumulator::~FrameAccumulator
+ */
+FrameAccumulator::~FrameAccumulator()
+{
+    delete program_;
+    delete frameFbo_;
+    delete averageFbo_;
+}
+
+/**
+ * @brief FrameAccumulator::Initialize
+ * @param coreProfile
+ * @return
+ */
+bool FrameAccumulator::Initialize(bool coreProfile)
+{
+    const QByteArray vertexSource = ShaderPrelude::Prefix(
+                QOpenGLShader::Vertex, coreProfile, COPY_VERTEX_SHADER);
+    const QByteArray fragmentSource = ShaderPrelude::Prefix(
+                QOpenGLShader::Fragment, coreProfile, COPY_FRAGMENT_SHADER);
+
+    program_ = new QOpenGLShaderProgram();
+    program_->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexSource);
+    program_->addShaderFromSourceCode(QOpenGLShader::Fragment,
+                                      fragmentSource);
+    program_->bindAttributeLocation("corner", 0);
+    if (!program_->link()) {
+        qDebug() << "Could not link the accumulation shader "
+                 << program_->log();
+        return false;
+    }
+
+    program_->bind();
+    program_->setUniformValue("frame", 0);
+    program_->release();
+
+    // Covers the whole viewport
+    const GLfloat corners[] = {
+        -1.0, -1.0,
+         1.0, -1.0,
+        -1.0,  1.0,
+         1.0,  1.0
+    };
+
+    vertexArray_.create();
+    QOpenGLVertexArrayObject::Binder binder(&vertexArray_);
+
+    quadBuffer_.create();
+    quadBuffer_.bind();
+    quadBuffer_.allocate(corners, sizeof(corners));
+    quadBuffer_.release();
+
+    return true;
+}
+
+/**
+ * @brief FrameAccumulator::Release
+ */
+void FrameAccumulator::Release()
+{
+    vertexArray_.destroy();
+    quadBuffer_.destroy();
+    delete program_;
+    program_ = NULL;
+    delete frameFbo_;
+    frameFbo_ = NULL;
+    delete averageFbo_;
+    averageFbo_ = NULL;
+    frameCount_ = 0;
+}
+
+/**
+ * @brief FrameAccumulator::Reset
+ */
+void FrameAccumulator::Reset()
+{
+    frameCount_ = 0;
+}
+
+/**
+ * @brief FrameAccumulator::GetFrameCount
+ * @return
+ */
+int FrameAccumulator::GetFrameCount() const
+{
+    return frameCount_;
+}
+
+/**
+ * @brief FrameAccumulator::BeginFrame
+ * @param size
+ */
+void FrameAccumulator::BeginFrame(const QSize& size)
+{
+    QOpenGLFunctions* functions = QOpenGLContext::currentContext()->functions();
+    functions->glGetIntegerv(GL_FRAMEBUFFER_BINDING, &targetFbo_);
+
+    if (!frameFbo_ || frameFbo_->size() != size) {
+        delete frameFbo_;
+        delete averageFbo_;
+        frameFbo_ = new QOpenGLFramebufferObject(size);
+
+        // Eight bits would round every frame added to the average away
+        averageFbo_ = new QOpenGLFramebufferObject(
+                    size, QOpenGLFramebufferObject::NoAttachment,
+                    GL_TEXTURE_2D, GL_RGBA16F);
+        frameCount_ = 0;
+    }
+
+    frameFbo_->bind();
+    functions->glClear(GL_COLOR_BUFFER_BIT);
+}
+
+/**
+ * @brief FrameAccumulator::EndFrame
+ */
+void FrameAccumulator::EndFrame()
+{
+    QOpenGLFunctions* functions = QOpenGLContext::currentContext()->functions();
+
+    // The blending of the renderer is restored at the end
+    GLint blendSource = GL_ONE;
+    GLint blendDestination = GL_ZERO;
+    const GLboolean blend = functions->glIsEnabled(GL_BLEND);
+    functions->glGetIntegerv(GL_BLEND_SRC_RGB, &blendSource);
+    functions->glGetIntegerv(GL_BLEND_DST_RGB, &blendDestination);
+
+    // Running average, the new frame weighs 1 / n of it
+    averageFbo_->bind();
+    frameCount_++;
+    if (frameCount_ == 1) {
+        functions->glDisable(GL_BLEND);
+    } else {
+        functions->glEnable(GL_BLEND);
+        functions->glBlendColor(0.0, 0.0, 0.0, 1.0 / frameCount_);
+        functions->glBlendFunc(GL_CONSTANT_ALPHA,
+                               GL_ONE_MINUS_CONSTANT_ALPHA);
+    }
+    DrawTexture(frameFbo_->texture());
+
+    // Show the average as is
+    functions->glBindFramebuffer(GL_FRAMEBUFFER, targetFbo_);
+    functions->glDisable(GL_BLEND);
+    DrawTexture(averageFbo_->texture());
+
+    functions->glBlendFunc(blendSource, blendDestination);
+    if (blend)
+        functions->glEnable(GL_BLEND);
+}
+
+/**
+ * @brief FrameAccumulator::DrawTexture
+ * @param textureId
+ */
+void FrameAccumulator::DrawTexture(GLuint textureId)
+{
+    QOpenGLFunctions* functions = QOpenGLContext::currentContext()->functions();
+    functions->glBindTexture(GL_TEXTURE_2D, textureId);
+
+    program_->bind();
+    QOpenGLVertexArrayObject::Binder binder(&vertexArray_);
+    quadBuffer_.bind();
+    program_->enableAttributeArray(0);
+    program_->setAttributeBuffer(0, GL_FLOAT, 0, 2);
+
+    functions->glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    program_->disableAttributeArray(0);
+    quadBuffer_.release();
+    program_->release();
+
+    functions->glBindTexture(GL_TEXTURE_2D, 0);
+}
@@ -0,0 +1,121 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef FRAMEACCUMULATOR_H
+#define FRAMEACCUMULATOR_H
+
+#include <QSize>
+#include <QOpenGLBuffer>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLVertexArrayObject>
+
+/**
+ * @brief The FrameAccumulator class
+ * Averages successive frames of the same view. Every frame is rendered
+ * into a target of its own, added to a running average kept in a
+ * half-float framebuffer object, and the average is drawn into the
+ * framebuffer that was bound before. Frames that differ slightly, e.g.
+ * in the position of the slices, converge to a smoother image.
+ */
+class FrameAccumulator
+{
+public:
+    /**
+     * @brief FrameAccumulator
+     */
+    FrameAccumulator();
+
+    /**
+     * @brief ~FrameAccumulator
+     */
+    ~FrameAccumulator();
+
+    /**
+     * @brief Initialize
+     * Builds the shaders and the quad, needs a current context.
+     * @param coreProfile Build GLSL 3.30 core shaders instead of 1.20.
+     * @return False if the shaders could not be built.
+     */
+    bool Initialize(bool coreProfile);
+
+    /**
+     * @brief Release
+     * Deletes the GPU objects, needs a current context.
+     */
+    void Release();
+
+    /**
+     * @brief Reset
+     * Drops the frames averaged so far.
+     */
+    void Reset();
+
+    /**
+     * @brief GetFrameCount
+     * @return Number of frames in the average.
+     */
+    int GetFrameCount() const;
+
+    /**
+     * @brief BeginFrame
+     * Binds the target of the next frame and clears it. A new size drops
+     * the average.
+     * @param size Size of the frame in pixels, also the viewport.
+     */
+    void BeginFrame(const QSize& size);
+
+    /**
+     * @brief EndFrame
+     * Adds the frame to the average and draws the average into the
+     * framebuffer that was bound at BeginFrame.
+     */
+    void EndFrame();
+
+private:
+    /**
+     * @brief DrawTexture
+     * Covers the viewport with a 2D texture.
+     * @param textureId
+     */
+    void DrawTexture(GLuint textureId);
+
+    /** \brief Copies a texture */
+    QOpenGLShaderProgram* program_;
+
+    /** \brief Vertex array of the quad */
+    QOpenGLVertexArrayObject vertexArray_;
+
+    /** \brief Corners of the quad */
+    QOpenGLBuffer quadBuffer_;
+
+    /** \brief Target of the current frame */
+    QOpenGLFramebufferObject* frameFbo_;
+
+    /** \brief Running average of the frames */
+    QOpenGLFramebufferObject* averageFbo_;
+
+    /** \brief Framebuffer bound at BeginFrame */
+    GLint targetFbo_;
+
+    /** \brief Frames in the average */
+    int frameCount_;
+};
+
+#endif // FRAMEACCUMULATOR_H
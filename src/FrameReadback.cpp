@@ -0,0 +1,142 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "FrameReadback.h"
+#include <string.h>
+
+/**
+ * @brief FrameReadback::FrameReadback
+ */
+FrameReadback::FrameReadback() :
+    first_(0),
+    pending_(0)
+{
+}
+
+/**
+ * @brief FrameReadback::~FrameReadback
+ */
+FrameReadback::~FrameReadback()
+{
+}
+
+/**
+ * @brief FrameReadback::Initialize
+ * @param size
+ * @param ringSize
+ */
+void FrameReadback::Initialize(const QSize& size, int ringSize)
+{
+    Release();
+
+    size_ = size;
+    const int frameBytes = size.width() * size.height() * 4;
+    for (int i = 0; i < qMax(ringSize, 2); i++) {
+        QOpenGLBuffer buffer(QOpenGLBuffer::PixelPackBuffer);
+        buffer.setUsagePattern(QOpenGLBuffer::StreamRead);
+        buffer.create();
+        buffer.bind();
+        buffer.allocate(frameBytes);
+        buffer.release();
+        buffers_.append(buffer);
+    }
+}
+
+/**
+ * @brief FrameReadback::Release
+ */
+void FrameReadback::Release()
+{
+    for (int i = 0; i < buffers_.size(); i++) {
+        buffers_[i].destroy();
+    }
+    buffers_.clear();
+    first_ = 0;
+    pending_ = 0;
+}
+
+/**
+ * @brief FrameReadback::Read
+ */
+void FrameReadback::Read()
+{
+    Q_ASSERT(!IsFull());
+
+    QOpenGLBuffer& buffer = buffers_[(first_ + pending_) % buffers_.size()];
+    pending_++;
+
+    // With a pack buffer bound the pointer is an offset into it, and the
+    // call returns without waiting for the frame. BGRA is the byte order
+    // of a little-endian QImage::Format_ARGB32.
+    buffer.bind();
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, size_.width(), size_.height(),
+                 GL_BGRA, GL_UNSIGNED_BYTE, 0);
+    buffer.release();
+}
+
+/**
+ * @brief FrameReadback::Take
+ * @return
+ */
+QImage FrameReadback::Take()
+{
+    Q_ASSERT(!IsEmpty());
+
+    QOpenGLBuffer& buffer = buffers_[first_];
+    first_ = (first_ + 1) % buffers_.size();
+    pending_--;
+
+    // The frames are blended with premultiplied colours
+    QImage frame(size_, QImage::Format_ARGB32_Premultiplied);
+
+    buffer.bind();
+    const void* pixels = buffer.map(QOpenGLBuffer::ReadOnly);
+    if (pixels) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+        memcpy(frame.bits(), pixels, frame.sizeInBytes());
+#else
+        memcpy(frame.bits(), pixels, frame.byteCount());
+#endif
+        buffer.unmap();
+    } else {
+        frame.fill(Qt::transparent);
+    }
+    buffer.release();
+
+    return frame;
+}
+
+/**
+ * @brief FrameReadback::IsFull
+ * @return
+ */
+bool FrameReadback::IsFull() const
+{
+    return pending_ == buffers_.size();
+}
+
+/**
+ * @brief FrameReadback::IsEmpty
+ * @return
+ */
+bool FrameReadback::IsEmpty() const
+{
+    return pending_ == 0;
+}
@@ -0,0 +1,102 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef FRAMEREADBACK_H
+#define FRAMEREADBACK_H
+
+#include <QImage>
+#include <QVector>
+#include <QOpenGLBuffer>
+
+/**
+ * @brief The FrameReadback class
+ * Reads frames back from the GPU through a ring of pixel buffer objects.
+ * A read only queues the copy into the next buffer of the ring, and the
+ * frame is mapped when the ring wraps around, so the transfer of a frame
+ * overlaps the rendering of the following ones.
+ */
+class FrameReadback
+{
+public:
+    /**
+     * @brief FrameReadback
+     */
+    FrameReadback();
+
+    /**
+     * @brief ~FrameReadback
+     */
+    ~FrameReadback();
+
+    /**
+     * @brief Initialize
+     * Allocates the ring, needs a current context.
+     * @param size Frame size in pixels.
+     * @param ringSize Number of pixel buffers, at least 2.
+     */
+    void Initialize(const QSize& size, int ringSize);
+
+    /**
+     * @brief Release
+     * Deletes the pixel buffers, needs a current context.
+     */
+    void Release();
+
+    /**
+     * @brief Read
+     * Queues the copy of the bound framebuffer into the next buffer of the
+     * ring. The ring must not be full.
+     */
+    void Read();
+
+    /**
+     * @brief Take
+     * Maps the oldest pending frame, waiting for its transfer if needed.
+     * The ring must not be empty.
+     * @return The frame, bottom row first as OpenGL stores it.
+     */
+    QImage Take();
+
+    /**
+     * @brief IsFull
+     * @return True if a frame has to be taken before the next read.
+     */
+    bool IsFull() const;
+
+    /**
+     * @brief IsEmpty
+     * @return True if there is no pending frame.
+     */
+    bool IsEmpty() const;
+
+private:
+    /** \brief Pixel pack buffers */
+    QVector<QOpenGLBuffer> buffers_;
+
+    /** \brief Buffer of the oldest pending frame */
+    int first_;
+
+    /** \brief Number of pending frames */
+    int pending_;
+
+    /** \brief Frame size */
+    QSize size_;
+};
+
+#endif // FRAMEREADBACK_H
@@ -0,0 +1,144 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "FrameStatistics.h"
+#include <algorithm>
+#include <math.h>
+
+/**
+ * @brief NearestRank
+ * @param sorted
+ * @param percentile In [0, 1].
+ * @return Smallest sample with at least _percentile_ of the samples at or
+ * below it.
+ */
+static float NearestRank(const QVector<float>& sorted, double percentile)
+{
+    const int rank = (int) ceil(percentile * sorted.size());
+    return sorted[qBound(0, rank - 1, sorted.size() - 1)];
+}
+
+/**
+ * @brief FrameStatistics::FrameStatistics
+ * @param windowSize
+ */
+FrameStatistics::FrameStatistics(int windowSize) :
+    windowSize_(qMax(windowSize, 1))
+{
+    for (int i = 0; i < SERIES_COUNT; i++) {
+        samples_[i].reserve(windowSize_);
+        nextSample_[i] = 0;
+    }
+}
+
+/**
+ * @brief FrameStatistics::Add
+ * @param series
+ * @param milliseconds
+ */
+void FrameStatistics::Add(Series series, float milliseconds)
+{
+    QVector<float>& samples = samples_[series];
+    if (samples.size() < windowSize_) {
+        samples.append(milliseconds);
+    } else {
+        samples[nextSample_[series]] = milliseconds;
+    }
+    nextSample_[series] = (nextSample_[series] + 1) % windowSize_;
+}
+
+/**
+ * @brief FrameStatistics::Summarize
+ * @param series
+ * @return
+ */
+FrameStatistics::Summary FrameStatistics::Summarize(Series series) const
+{
+    Summary summary = {0, 0.f, 0.f, 0.f, 0.f};
+
+    QVector<float> sorted = samples_[series];
+    if (sorted.isEmpty())
+        return summary;
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0.0;
+    for (int i = 0; i < sorted.size(); i++) {
+        sum += sorted[i];
+    }
+
+    summary.count = sorted.size();
+    summary.minimum = sorted[0];
+    summary.average = sum / sorted.size();
+    summary.percentile95 = NearestRank(sorted, 0.95);
+    summary.percentile99 = NearestRank(sorted, 0.99);
+    return summary;
+}
+
+/**
+ * @brief FrameStatistics::GetLast
+ * @param series
+ * @return
+ */
+float FrameStatistics::GetLast(Series series) const
+{
+    const QVector<float>& samples = samples_[series];
+    if (samples.isEmpty())
+        return 0.f;
+
+    return samples[(nextSample_[series] + windowSize_ - 1) % windowSize_];
+}
+
+/**
+ * @brief FrameStatistics::GetHistogram
+ * @param series
+ * @param bucketMilliseconds
+ * @param bucketCount
+ * @return
+ */
+QVector<int> FrameStatistics::GetHistogram(Series series,
+                                           float bucketMilliseconds,
+                                           int bucketCount) const
+{
+    QVector<int> histogram(qMax(bucketCount, 1), 0);
+
+    const QVector<float>& samples = samples_[series];
+    for (int i = 0; i < samples.size(); i++) {
+        const int bucket = (int) (samples[i] / bucketMilliseconds);
+        histogram[qBound(0, bucket, histogram.size() - 1)]++;
+    }
+    return histogram;
+}
+
+/**
+ * @brief FrameStatistics::GetSeriesName
+ * @param series
+ * @return
+ */
+const char* FrameStatistics::GetSeriesName(Series series)
+{
+    switch (series) {
+    case SERIES_FRAME:         return "frame";
+    case SERIES_MAKE_CURRENT:  return "make current";
+    case SERIES_RENDER:        return "render";
+    case SERIES_SWAP:          return "swap";
+    case SERIES_GPU:           return "GPU";
+    case SERIES_INPUT_LATENCY: return "input latency";
+    default:                   return "";
+    }
+}
@@ -0,0 +1,134 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef FRAMESTATISTICS_H
+#define FRAMESTATISTICS_H
+
+#include <QtGlobal>
+#include <QVector>
+
+/**
+ * @brief The FrameStatistics class
+ * Keeps the timings of the last frames, one rolling window per phase of a
+ * frame, and summarizes them as minimum, average and percentiles.
+ */
+class FrameStatistics
+{
+public:
+    /**
+     * @brief The Series enum
+     * Timed phases.
+     */
+    enum Series {
+        /** Interval between the starts of two frames */
+        SERIES_FRAME,
+
+        /** Making the context current */
+        SERIES_MAKE_CURRENT,
+
+        /** CPU time of the frame rendering */
+        SERIES_RENDER,
+
+        /** Swapping the buffers, includes the wait for the display */
+        SERIES_SWAP,
+
+        /** GPU time of the frame rendering */
+        SERIES_GPU,
+
+        /** From the arrival of an input to the swap of the first frame
+         * that shows its result */
+        SERIES_INPUT_LATENCY,
+
+        /** Number of series */
+        SERIES_COUNT
+    };
+
+    /**
+     * @brief The Summary struct
+     * Statistics of a series in milliseconds.
+     */
+    struct Summary
+    {
+        /** \brief Number of samples in the window */
+        int count;
+
+        float minimum;
+        float average;
+        float percentile95;
+        float percentile99;
+    };
+
+    /**
+     * @brief FrameStatistics
+     * @param windowSize Number of samples kept per series.
+     */
+    explicit FrameStatistics(int windowSize = 240);
+
+    /**
+     * @brief Add
+     * Replaces the oldest sample once the window is full.
+     * @param series
+     * @param milliseconds
+     */
+    void Add(Series series, float milliseconds);
+
+    /**
+     * @brief Summarize
+     * @param series
+     * @return Statistics of the samples in the window, all zero if empty.
+     */
+    Summary Summarize(Series series) const;
+
+    /**
+     * @brief GetLast
+     * @param series
+     * @return The most recent sample, 0 if none.
+     */
+    float GetLast(Series series) const;
+
+    /**
+     * @brief GetHistogram
+     * @param series
+     * @param bucketMilliseconds Width of a bucket.
+     * @param bucketCount Number of buckets, the last one also counts the
+     * longer samples.
+     * @return Number of samples of the window in each bucket.
+     */
+    QVector<int> GetHistogram(Series series, float bucketMilliseconds,
+                              int bucketCount) const;
+
+    /**
+     * @brief GetSeriesName
+     * @param series
+     * @return Printable name of the series.
+     */
+    static const char* GetSeriesName(Series series);
+
+private:
+    /** \brief Rolling window of each series */
+    QVector<float> samples_[SERIES_COUNT];
+
+    /** \brief Slot of the next sample of each series */
+    int nextSample_[SERIES_COUNT];
+
+    /** \brief Number of samples kept per series */
+    int windowSize_;
+};
+
+#endif // FRAMESTATISTICS_H
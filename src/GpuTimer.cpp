@@ -0,0 +1,120 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "GpuTimer.h"
+
+/**
+ * @brief GpuTimer::GpuTimer
+ */
+GpuTimer::GpuTimer() :
+    next_(0),
+    active_(-1)
+{
+}
+
+/**
+ * @brief GpuTimer::~GpuTimer
+ */
+GpuTimer::~GpuTimer()
+{
+    qDeleteAll(queries_);
+}
+
+/**
+ * @brief GpuTimer::Initialize
+ * @param ringSize
+ * @return
+ */
+bool GpuTimer::Initialize(int ringSize)
+{
+    Release();
+
+    for (int i = 0; i < ringSize; i++) {
+        QOpenGLTimerQuery* query = new QOpenGLTimerQuery();
+        if (!query->create()) {
+            delete query;
+            Release();
+            return false;
+        }
+        queries_.append(query);
+        pending_.append(false);
+    }
+    return true;
+}
+
+/**
+ * @brief GpuTimer::Release
+ */
+void GpuTimer::Release()
+{
+    for (int i = 0; i < queries_.size(); i++) {
+        queries_[i]->destroy();
+    }
+    qDeleteAll(queries_);
+    queries_.clear();
+    pending_.clear();
+    next_ = 0;
+    active_ = -1;
+}
+
+/**
+ * @brief GpuTimer::Begin
+ */
+void GpuTimer::Begin()
+{
+    if (queries_.isEmpty() || pending_[next_])
+        return;
+
+    active_ = next_;
+    next_ = (next_ + 1) % queries_.size();
+    queries_[active_]->begin();
+}
+
+/**
+ * @brief GpuTimer::End
+ */
+void GpuTimer::End()
+{
+    if (active_ < 0)
+        return;
+
+    queries_[active_]->end();
+    pending_[active_] = true;
+    active_ = -1;
+}
+
+/**
+ * @brief GpuTimer::Collect
+ * @param statistics
+ */
+void GpuTimer::Collect(FrameStatistics* statistics)
+{
+    // Oldest first, the queries finish in the order they were issued
+    for (int i = 0; i < queries_.size(); i++) {
+        const int query = (next_ + i) % queries_.size();
+        if (!pending_[query])
+            continue;
+        if (!queries_[query]->isResultAvailable())
+            return;
+
+        statistics->Add(FrameStatistics::SERIES_GPU,
+                        queries_[query]->waitForResult() / 1e6);
+        pending_[query] = false;
+    }
+}
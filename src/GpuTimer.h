@@ -0,0 +1,94 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include <QVector>
+#include <QOpenGLTimerQuery>
+#include "FrameStatistics.h"
+
+/**
+ * @brief The GpuTimer class
+ * Measures the GPU time of frames with GL_TIME_ELAPSED queries. The
+ * queries are kept in a ring and only read once their result is
+ * available, so measuring never stalls the pipeline; a frame is simply
+ * not measured when every query of the ring is still in flight.
+ */
+class GpuTimer
+{
+public:
+    /**
+     * @brief GpuTimer
+     */
+    GpuTimer();
+
+    /**
+     * @brief ~GpuTimer
+     */
+    ~GpuTimer();
+
+    /**
+     * @brief Initialize
+     * Needs a current context.
+     * @param ringSize Number of frames that can be in flight.
+     * @return False if the context has no timer queries.
+     */
+    bool Initialize(int ringSize);
+
+    /**
+     * @brief Release
+     * Deletes the queries, needs a current context.
+     */
+    void Release();
+
+    /**
+     * @brief Begin
+     * Starts timing a frame if a query is free.
+     */
+    void Begin();
+
+    /**
+     * @brief End
+     * Stops timing the frame started with Begin.
+     */
+    void End();
+
+    /**
+     * @brief Collect
+     * Adds the finished frames to the GPU series, without waiting.
+     * @param statistics
+     */
+    void Collect(FrameStatistics* statistics);
+
+private:
+    /** \brief Query ring */
+    QVector<QOpenGLTimerQuery*> queries_;
+
+    /** \brief Query in flight */
+    QVector<bool> pending_;
+
+    /** \brief Next query to start */
+    int next_;
+
+    /** \brief Query started by Begin, -1 if none */
+    int active_;
+};
+
+#endif // GPUTIMER_H
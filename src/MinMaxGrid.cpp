@@ -0,0 +1,348 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "MinMaxGrid.h"
+#include "Trace.h"
+#include "VolumeClassifier.h"
+#include <climits>
+
+/**
+ * @brief TouchesOutlineBand
+ * @param first First voxel of the cell along an axis.
+ * @param last Last voxel of the cell along the axis.
+ * @param size Volume size along the axis.
+ * @return True if the cell overlaps the outline band of the axis.
+ */
+static bool TouchesOutlineBand(int first, int last, int size)
+{
+    return VolumeClassifier::InOutlineBand(first, size) ||
+           VolumeClassifier::InOutlineBand(last, size);
+}
+
+/**
+ * @brief MinMaxGrid::MinMaxGrid
+ */
+MinMaxGrid::MinMaxGrid() :
+    cellSize_(1),
+    apron_(1)
+{
+    for (int axis = 0; axis < 3; axis++) {
+        volumeSize_[axis] = 0;
+        cellCount_[axis] = 0;
+    }
+}
+
+/**
+ * @brief MinMaxGrid::Build
+ * @param volumeFile
+ * @param width
+ * @param height
+ * @param depth
+ * @param cellSize
+ * @param apron
+ * @param threadPool
+ */
+void MinMaxGrid::Build(VolumeFile* volumeFile,
+                       int width, int height, int depth,
+                       int cellSize, int apron, ThreadPool* threadPool)
+{
+    TRACE_SCOPE("MinMaxGrid::Build");
+
+    volumeSize_[0] = width;
+    volumeSize_[1] = height;
+    volumeSize_[2] = depth;
+    cellSize_ = cellSize;
+    apron_ = qMax(apron, 1);
+
+    for (int axis = 0; axis < 3; axis++) {
+        cellCount_[axis] = (volumeSize_[axis] + cellSize_ - 1) / cellSize_;
+    }
+
+    const int cells = cellCount_[0] * cellCount_[1] * cellCount_[2];
+    minimum_.fill(255, cells);
+    maximum_.fill(0, cells);
+    skipDistance_.fill(0, cells);
+
+    // Every layer of cells is updated by one task only, so no two tasks
+    // touch the same cell. The slices of the aprons between two layers are
+    // read by both tasks.
+    const GLubyte* rawVolume = volumeFile->GetData();
+    if (rawVolume) {
+        threadPool->ParallelFor(0, cellCount_[2], 1,
+                                [&] (qint64 firstLayer, qint64 lastLayer) {
+            const int kBegin = qMax((int) firstLayer * cellSize_ - apron_, 0);
+            const int kEnd = qMin((int) lastLayer * cellSize_ + apron_, depth);
+            for (int k = kBegin; k < kEnd; k++) {
+                for (int j = 0; j < height; j++) {
+                    ScanRow(rawVolume + ((qint64) k * height + j) * width,
+                            j, k, firstLayer, lastLayer);
+                }
+            }
+        });
+    } else {
+        // Reading on demand goes through a single file handle
+        QVector<GLubyte> row(width);
+        for (int k = 0; k < depth; k++) {
+            for (int j = 0; j < height; j++) {
+                volumeFile->Read(((qint64) k * height + j) * width, width,
+                                 row.data());
+                ScanRow(row.constData(), j, k, 0, cellCount_[2]);
+            }
+        }
+    }
+
+    // The outline runs along the edges of the volume, a cell holds a piece
+    // of it when its apron touches the band of two axes
+    for (int k = 0; k < cellCount_[2]; k++) {
+        for (int j = 0; j < cellCount_[1]; j++) {
+            for (int i = 0; i < cellCount_[0]; i++) {
+                const int index[3] = { i, j, k };
+                int bands = 0;
+                for (int axis = 0; axis < 3; axis++) {
+                    const int begin = index[axis] * cellSize_;
+                    const int first = qMax(begin - apron_, 0);
+                    const int last = qMin(begin + cellSize_ + apron_,
+                                          volumeSize_[axis]) - 1;
+                    if (TouchesOutlineBand(first, last, volumeSize_[axis]))
+                        bands++;
+                }
+
+                if (bands >= 2) {
+                    const int cell = CellIndex(i, j, k);
+                    minimum_[cell] = qMin(minimum_[cell],
+                            (GLubyte) VolumeClassifier::OUTLINE_VALUE);
+                    maximum_[cell] = qMax(maximum_[cell],
+                            (GLubyte) VolumeClassifier::OUTLINE_VALUE);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief MinMaxGrid::ScanRow
+ * @param row
+ * @param j
+ * @param k
+ * @param firstLayer
+ * @param lastLayer
+ */
+void MinMaxGrid::ScanRow(const GLubyte* row, int j, int k,
+                         int firstLayer, int lastLayer)
+{
+    // Cells whose apron holds the row, the clamped voxels at the volume
+    // faces are the ones next to them
+    const int cjFirst = qMax(j - apron_, 0) / cellSize_;
+    const int cjLast = qMin(j + apron_, volumeSize_[1] - 1) / cellSize_;
+    const int ckFirst = qMax(qMax(k - apron_, 0) / cellSize_, firstLayer);
+    const int ckLast = qMin(qMin(k + apron_, volumeSize_[2] - 1) / cellSize_,
+                            lastLayer - 1);
+
+    for (int ci = 0; ci < cellCount_[0]; ci++) {
+        const int begin = qMax(ci * cellSize_ - apron_, 0);
+        const int end = qMin((ci + 1) * cellSize_ + apron_, volumeSize_[0]);
+
+        GLubyte rowMin = 255;
+        GLubyte rowMax = 0;
+        for (int i = begin; i < end; i++) {
+            rowMin = qMin(rowMin, row[i]);
+            rowMax = qMax(rowMax, row[i]);
+        }
+
+        for (int ck = ckFirst; ck <= ckLast; ck++) {
+            for (int cj = cjFirst; cj <= cjLast; cj++) {
+                const int cell = CellIndex(ci, cj, ck);
+                minimum_[cell] = qMin(minimum_[cell], rowMin);
+                maximum_[cell] = qMax(maximum_[cell], rowMax);
+            }
+        }
+    }
+}
+
+/**
+ * @brief MinMaxGrid::Classify
+ * @param lookupTable
+ */
+void MinMaxGrid::Classify(const GLubyte* lookupTable)
+{
+    // Number of visible entries up to each scalar, so that a range can be
+    // tested with two lookups
+    int visible[257];
+    visible[0] = 0;
+    for (int v = 0; v < 256; v++) {
+        visible[v + 1] = visible[v] + (lookupTable[4 * v + 3] > 0 ? 1 : 0);
+    }
+
+    for (int cell = 0; cell < skipDistance_.size(); cell++) {
+        const bool empty = (minimum_[cell] > maximum_[cell]) ||
+                (visible[maximum_[cell] + 1] == visible[minimum_[cell]]);
+
+        // Non-empty cells are the seeds of the distance transform
+        skipDistance_[cell] = empty ? INT_MAX : 0;
+    }
+
+    ComputeSkipDistances();
+}
+
+/**
+ * @brief MinMaxGrid::ComputeSkipDistances
+ * Two raster passes over the 26-neighbourhood give the exact chessboard
+ * distance to the nearest non-empty cell.
+ */
+void MinMaxGrid::ComputeSkipDistances()
+{
+    const int ni = cellCount_[0];
+    const int nj = cellCount_[1];
+    const int nk = cellCount_[2];
+
+    for (int pass = 0; pass < 2; pass++) {
+        // The forward pass looks at the neighbours visited before, the
+        // backward pass at the ones visited after
+        const int step = (pass == 0) ? 1 : -1;
+        const int kStart = (pass == 0) ? 0 : nk - 1;
+        const int jStart = (pass == 0) ? 0 : nj - 1;
+        const int iStart = (pass == 0) ? 0 : ni - 1;
+
+        for (int k = kStart; k >= 0 && k < nk; k += step) {
+            for (int j = jStart; j >= 0 && j < nj; j += step) {
+                for (int i = iStart; i >= 0 && i < ni; i += step) {
+                    int& distance = skipDistance_[CellIndex(i, j, k)];
+                    if (distance == 0)
+                        continue;
+
+                    for (int dk = -1; dk <= 1; dk++) {
+                        for (int dj = -1; dj <= 1; dj++) {
+                            for (int di = -1; di <= 1; di++) {
+                                const int order = (dk * nj + dj) * ni + di;
+                                if (order * step >= 0)
+                                    continue;
+
+                                const int x = i + di;
+                                const int y = j + dj;
+                                const int z = k + dk;
+                                if (x < 0 || y < 0 || z < 0 ||
+                                        x >= ni || y >= nj || z >= nk)
+                                    continue;
+
+                                const int neighbour =
+                                        skipDistance_[CellIndex(x, y, z)];
+                                if (neighbour != INT_MAX)
+                                    distance = qMin(distance, neighbour + 1);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief MinMaxGrid::GetCellSize
+ * @return
+ */
+int MinMaxGrid::GetCellSize() const
+{
+    return cellSize_;
+}
+
+/**
+ * @brief MinMaxGrid::GetCellCount
+ * @param axis
+ * @return
+ */
+int MinMaxGrid::GetCellCount(int axis) const
+{
+    return cellCount_[axis];
+}
+
+/**
+ * @brief MinMaxGrid::CellIndex
+ * @param i
+ * @param j
+ * @param k
+ * @return
+ */
+int MinMaxGrid::CellIndex(int i, int j, int k) const
+{
+    return (k * cellCount_[1] + j) * cellCount_[0] + i;
+}
+
+/**
+ * @brief MinMaxGrid::IsEmpty
+ * @param i
+ * @param j
+ * @param k
+ * @return
+ */
+bool MinMaxGrid::IsEmpty(int i, int j, int k) const
+{
+    return skipDistance_[CellIndex(i, j, k)] != 0;
+}
+
+/**
+ * @brief MinMaxGrid::GetSkipDistance
+ * A cell at distance d from the nearest non-empty cell has d - 1 empty
+ * cells around it. Without any non-empty cell the whole grid is empty.
+ * @param i
+ * @param j
+ * @param k
+ * @return
+ */
+int MinMaxGrid::GetSkipDistance(int i, int j, int k) const
+{
+    const int distance = skipDistance_[CellIndex(i, j, k)];
+    if (distance == 0)
+        return 0;
+
+    if (distance == INT_MAX) {
+        return qMax(cellCount_[0], qMax(cellCount_[1], cellCount_[2]));
+    }
+
+    return distance - 1;
+}
+
+/**
+ * @brief MinMaxGrid::GetDistanceField
+ * @param distances
+ */
+void MinMaxGrid::GetDistanceField(GLubyte* distances) const
+{
+    for (int cell = 0; cell < skipDistance_.size(); cell++) {
+        distances[cell] = (GLubyte) qMin(skipDistance_[cell], 255);
+    }
+}
+
+/**
+ * @brief MinMaxGrid::GetEmptyFraction
+ * @return
+ */
+float MinMaxGrid::GetEmptyFraction() const
+{
+    if (skipDistance_.isEmpty())
+        return 0.f;
+
+    int empty = 0;
+    for (int cell = 0; cell < skipDistance_.size(); cell++) {
+        if (skipDistance_[cell] != 0)
+            empty++;
+    }
+
+    return (float) empty / skipDistance_.size();
+}
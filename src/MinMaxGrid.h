@@ -0,0 +1,168 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef MINMAXGRID_H
+#define MINMAXGRID_H
+
+#include <QVector>
+#include "VolumeFile.h"
+#include "ThreadPool.h"
+
+/**
+ * @brief The MinMaxGrid class
+ * Coarse grid over the volume that stores the scalar range of every cell.
+ * Combined with a transfer function it tells which cells are fully
+ * transparent, and how many cells a ray can skip from any empty cell.
+ */
+class MinMaxGrid
+{
+public:
+    /**
+     * @brief MinMaxGrid
+     */
+    MinMaxGrid();
+
+    /**
+     * @brief Build
+     * Scans the volume and records the scalar range of every cell,
+     * including the bounding-box outline. The range of a cell covers an
+     * apron of voxels around it, so that a cell is only empty if every
+     * filtered sample inside it is transparent. All cells are non-empty
+     * until Classify is called.
+     * @param volumeFile
+     * @param width
+     * @param height
+     * @param depth
+     * @param cellSize Edge of a cell in voxels.
+     * @param apron Voxels read by a sample on either side of it, at least
+     * 1 for trilinear filtering.
+     * @param threadPool Used when the volume is in memory.
+     */
+    void Build(VolumeFile* volumeFile, int width, int height, int depth,
+               int cellSize, int apron, ThreadPool* threadPool);
+
+    /**
+     * @brief Classify
+     * Marks the cells whose scalar range maps to zero opacity and updates
+     * the skip distances. Must be called again whenever the transfer
+     * function changes.
+     * @param lookupTable 256 RGBA entries.
+     */
+    void Classify(const GLubyte* lookupTable);
+
+    /**
+     * @brief GetCellSize
+     * @return Edge of a cell in voxels.
+     */
+    int GetCellSize() const;
+
+    /**
+     * @brief GetCellCount
+     * @param axis
+     * @return Number of cells along _axis_.
+     */
+    int GetCellCount(int axis) const;
+
+    /**
+     * @brief IsEmpty
+     * @param i
+     * @param j
+     * @param k
+     * @return True if the cell is fully transparent.
+     */
+    bool IsEmpty(int i, int j, int k) const;
+
+    /**
+     * @brief GetSkipDistance
+     * @param i
+     * @param j
+     * @param k
+     * @return Number of cells around the cell, in every direction, that are
+     * guaranteed to be empty, 0 for a non-empty cell.
+     */
+    int GetSkipDistance(int i, int j, int k) const;
+
+    /**
+     * @brief GetDistanceField
+     * @param distances Receives, for every cell in x-fastest order, the
+     * chessboard distance in cells to the nearest non-empty cell, 0 for a
+     * non-empty cell and clamped to 255. An empty cell at distance d has
+     * d - 1 empty cells around it in every direction.
+     */
+    void GetDistanceField(GLubyte* distances) const;
+
+    /**
+     * @brief GetEmptyFraction
+     * @return Fraction of the cells that are empty.
+     */
+    float GetEmptyFraction() const;
+
+private:
+    /**
+     * @brief CellIndex
+     * @param i
+     * @param j
+     * @param k
+     * @return
+     */
+    int CellIndex(int i, int j, int k) const;
+
+    /**
+     * @brief ScanRow
+     * Folds a row of voxels into the ranges of the cells whose apron it
+     * crosses, in the layers [firstLayer, lastLayer) only.
+     * @param row
+     * @param j
+     * @param k
+     * @param firstLayer
+     * @param lastLayer
+     */
+    void ScanRow(const GLubyte* row, int j, int k,
+                 int firstLayer, int lastLayer);
+
+    /**
+     * @brief ComputeSkipDistances
+     * Chessboard distance transform of the empty cells.
+     */
+    void ComputeSkipDistances();
+
+private:
+    /** \brief Volume dimensions */
+    int volumeSize_[3];
+
+    /** \brief Edge of a cell in voxels */
+    int cellSize_;
+
+    /** \brief Number of cells along each axis */
+    int cellCount_[3];
+
+    /** \brief Voxels around a cell folded into its range */
+    int apron_;
+
+    /** \brief Smallest scalar of every cell */
+    QVector<GLubyte> minimum_;
+
+    /** \brief Largest scalar of every cell */
+    QVector<GLubyte> maximum_;
+
+    /** \brief Skip distance of every cell, 0 if non-empty */
+    QVector<int> skipDistance_;
+};
+
+#endif // MINMAXGRID_H
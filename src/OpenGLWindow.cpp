@@ -18,6 +18,8 @@
  ******************************************************************************/
 
 #include "OpenGLWindow.h"
+#include "Trace.h"
+#include <QDebug>
 
 /**
  * @brief OpenGLWindow::OpenGLWindow
@@ -28,7 +30,23 @@ OpenGLWindow::OpenGLWindow(QWindow *parent) :
     QWindow(parent),
     updatePending_(false),
     animating_(false),
+    renderThreadEnabled_(true),
+    renderThreadStarted_(false),
+    frameRequested_(false),
+    stopRendering_(false),
+    exposed_(false),
+    inputTime_(0),
+    pendingInputTime_(0),
+    framePacing_(FRAME_PACING_IMMEDIATE),
+    pacingMargin_(2000000),
+    lastSwapTime_(0),
     context_(NULL),
+    offscreenSurface_(NULL),
+    offscreenFbo_(NULL),
+    offscreenResolveFbo_(NULL),
+    gpuTimerAvailable_(false),
+    showFrameStatistics_(false),
+    statisticsDevice_(NULL),
     fullScreen_(false)
 {
     // Specify whether the window is meant for raster rendering with
@@ -47,6 +65,9 @@ OpenGLWindow::OpenGLWindow(QWindow *parent) :
     xTranslation_ = 0.f;
     yTranslation_ = 0.f;
     zTranslation_ = -10.0f;
+
+    // The context has to go before the window surface
+    connect(qApp, SIGNAL(aboutToQuit()), this, SLOT(StopRenderThread()));
 }
 
 /**
@@ -56,6 +77,15 @@ OpenGLWindow::OpenGLWindow(QWindow *parent) :
 OpenGLWindow::~OpenGLWindow()
 {
     // Perform any clean-up operations here.
+    StopRenderThread();
+    delete statisticsDevice_;
+    if (offscreenSurface_) {
+        context_->makeCurrent(offscreenSurface_);
+        delete offscreenFbo_;
+        delete offscreenResolveFbo_;
+        context_->doneCurrent();
+        delete offscreenSurface_;
+    }
 }
 
 /**
@@ -66,6 +96,22 @@ void OpenGLWindow::Render()
     // Implement the rendering code here.
 }
 
+/**
+ * @brief OpenGLWindow::PublishState
+ */
+void OpenGLWindow::PublishState()
+{
+    // Hand the state of the derived window over here.
+}
+
+/**
+ * @brief OpenGLWindow::SynchronizeState
+ */
+void OpenGLWindow::SynchronizeState()
+{
+    // Take the state of the derived window over here.
+}
+
 /**
  * @brief OpenGLWindow::Initialize
  */
@@ -110,25 +156,446 @@ void OpenGLWindow::ToogleAnimation(bool animating)
 
 }
 
+/**
+ * @brief OpenGLWindow::SetRenderThread
+ * @param enabled
+ */
+void OpenGLWindow::SetRenderThread(bool enabled)
+{
+    renderThreadEnabled_ = enabled;
+}
+
+/**
+ * @brief OpenGLWindow::SetFramePacing
+ * @param pacing
+ * @param marginMilliseconds
+ */
+void OpenGLWindow::SetFramePacing(FramePacing pacing, float marginMilliseconds)
+{
+    framePacing_ = pacing;
+    pacingMargin_ = qMax(marginMilliseconds, 0.f) * 1e6;
+}
+
+/**
+ * @brief OpenGLWindow::GetFrameStatistics
+ * @return
+ */
+const FrameStatistics& OpenGLWindow::GetFrameStatistics() const
+{
+    return frameStatistics_;
+}
+
+/**
+ * @brief OpenGLWindow::GetTimestamp
+ * @return
+ */
+qint64 OpenGLWindow::GetTimestamp()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief OpenGLWindow::StartRenderThread
+ * Starts the render thread on the first expose, unless the platform
+ * cannot make a context current on a window from another thread.
+ */
+void OpenGLWindow::StartRenderThread()
+{
+    if (!renderThreadEnabled_ || renderThreadStarted_ || context_)
+        return;
+
+    if (!QOpenGLContext::supportsThreadedOpenGL()) {
+        qDebug() << "No threaded OpenGL, rendering on the UI thread";
+        return;
+    }
+
+    renderThreadStarted_ = true;
+    renderThread_ = std::thread(&OpenGLWindow::RenderLoop, this);
+}
+
+/**
+ * @brief OpenGLWindow::StopRenderThread
+ */
+void OpenGLWindow::StopRenderThread()
+{
+    if (!renderThread_.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(frameMutex_);
+        stopRendering_ = true;
+    }
+    frameCondition_.notify_one();
+    renderThread_.join();
+}
+
+/**
+ * @brief OpenGLWindow::RenderLoop
+ * Sleeps until a frame is requested. Requests made while a frame is
+ * rendered result in one more frame, which picks up the latest state.
+ */
+void OpenGLWindow::RenderLoop()
+{
+    Trace::SetThreadName("Render");
+
+    // A context can only be made current on the thread it belongs to
+    context_ = new QOpenGLContext();
+    context_->setFormat(requestedFormat());
+    context_->create();
+
+    bool initialize = true;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(frameMutex_);
+            while (!frameRequested_ && !stopRendering_)
+                frameCondition_.wait(lock);
+
+            if (stopRendering_)
+                break;
+            frameRequested_ = false;
+
+            // Requests and inputs until the start go into this frame
+            const qint64 startTime = GetFrameStartTime();
+            if (startTime != 0) {
+                const std::chrono::steady_clock::time_point start(
+                            std::chrono::duration_cast<
+                                std::chrono::steady_clock::duration>(
+                                std::chrono::nanoseconds(startTime)));
+                frameCondition_.wait_until(lock, start,
+                                           [this] { return stopRendering_; });
+                if (stopRendering_)
+                    break;
+                frameRequested_ = false;
+            }
+        }
+
+        // The next expose asks again
+        if (!exposed_)
+            continue;
+
+        PresentFrame(initialize);
+        initialize = false;
+
+        // Frames are otherwise only rendered when something changed
+        if (animating_)
+            RequestFrame();
+    }
+
+    // The GPU objects of the window go with the context
+    if (!initialize) {
+        context_->makeCurrent(this);
+        gpuTimer_.Release();
+        delete statisticsDevice_;
+        statisticsDevice_ = NULL;
+        context_->doneCurrent();
+    }
+    delete context_;
+    context_ = NULL;
+}
+
+/**
+ * @brief OpenGLWindow::GetFrameStartTime
+ * Aims at the first refresh that a frame started now can still make, and
+ * starts it as late as the slower frames of the window allow. A frame
+ * started earlier would only wait in the swap, with older input.
+ * @return
+ */
+qint64 OpenGLWindow::GetFrameStartTime()
+{
+    const qint64 period = renderSize_.refreshPeriod;
+    if (framePacing_ != FRAME_PACING_LATE || period <= 0 || lastSwapTime_ == 0)
+        return 0;
+
+    // The swaps return at a refresh, but the phase drifts away from the
+    // last one
+    const qint64 now = GetTimestamp();
+    if (now - lastSwapTime_ > 1000000000)
+        return 0;
+
+    // The GPU runs behind the CPU, whichever takes longer bounds the frame
+    const FrameStatistics::Summary makeCurrent =
+            frameStatistics_.Summarize(FrameStatistics::SERIES_MAKE_CURRENT);
+    const FrameStatistics::Summary render =
+            frameStatistics_.Summarize(FrameStatistics::SERIES_RENDER);
+    const FrameStatistics::Summary gpu =
+            frameStatistics_.Summarize(FrameStatistics::SERIES_GPU);
+    const qint64 frameCost = (makeCurrent.percentile95 +
+                              qMax(render.percentile95, gpu.percentile95)) *
+            1e6 + pacingMargin_;
+
+    // Slower than the refresh, any wait is added latency
+    if (frameCost >= period)
+        return 0;
+
+    qint64 refresh = lastSwapTime_ + period;
+    while (refresh - frameCost < now)
+        refresh += period;
+    return refresh - frameCost;
+}
+
+/**
+ * @brief OpenGLWindow::CreateOffscreenContext
+ * @param size
+ * @param samples
+ * @return
+ */
+bool OpenGLWindow::CreateOffscreenContext(const QSize& size, int samples)
+{
+    // Multisampling is done by the framebuffer object
+    QSurfaceFormat format = requestedFormat();
+    format.setSamples(0);
+
+    offscreenSurface_ = new QOffscreenSurface();
+    offscreenSurface_->setFormat(format);
+    offscreenSurface_->create();
+
+    context_ = new QOpenGLContext(this);
+    context_->setFormat(format);
+    if (!context_->create() || !context_->makeCurrent(offscreenSurface_))
+        return false;
+
+    initializeOpenGLFunctions();
+
+    // Custom initialization, as for a window, with the state set so far
+    PublishState();
+    SynchronizeState();
+    Initialize();
+
+    QOpenGLFramebufferObjectFormat fboFormat;
+    fboFormat.setSamples(samples);
+    offscreenFbo_ = new QOpenGLFramebufferObject(size, fboFormat);
+    if (!offscreenFbo_->isValid())
+        return false;
+
+    offscreenFbo_->bind();
+    ResizeGLWindow(size.width(), size.height());
+    return true;
+}
+
+/**
+ * @brief OpenGLWindow::RenderOffscreen
+ * @return
+ */
+QImage OpenGLWindow::RenderOffscreen()
+{
+    RenderOffscreenFrame();
+
+    // Blocks until the frame is done
+    return offscreenResolveFbo_ ? offscreenResolveFbo_->toImage() :
+                                  offscreenFbo_->toImage();
+}
+
+/**
+ * @brief OpenGLWindow::RenderOffscreenFrame
+ */
+void OpenGLWindow::RenderOffscreenFrame()
+{
+    TRACE_SCOPE("OpenGLWindow::RenderOffscreenFrame");
+
+    // Render may have bound a target of its own
+    offscreenFbo_->bind();
+    SynchronizeState();
+    Render();
+
+    if (offscreenFbo_->format().samples() == 0)
+        return;
+
+    // Pixels cannot be read from a multisampled target
+    if (!offscreenResolveFbo_) {
+        offscreenResolveFbo_ =
+                new QOpenGLFramebufferObject(offscreenFbo_->size());
+    }
+    QOpenGLFramebufferObject::blitFramebuffer(offscreenResolveFbo_,
+                                              offscreenFbo_);
+    offscreenResolveFbo_->bind();
+}
+
+/**
+ * @brief OpenGLWindow::FinishOffscreenFrame
+ */
+void OpenGLWindow::FinishOffscreenFrame()
+{
+    glFinish();
+}
+
+/**
+ * @brief OpenGLWindow::IsOffscreen
+ * @return
+ */
+bool OpenGLWindow::IsOffscreen() const
+{
+    return offscreenSurface_ != NULL;
+}
+
+/**
+ * @brief OpenGLWindow::ToggleFrameStatistics
+ */
+void OpenGLWindow::ToggleFrameStatistics()
+{
+    showFrameStatistics_ = !showFrameStatistics_;
+}
+
+/**
+ * @brief OpenGLWindow::DrawFrameStatistics
+ */
+void OpenGLWindow::DrawFrameStatistics()
+{
+    // The window may be resized meanwhile on the UI thread
+    if (!statisticsDevice_)
+        statisticsDevice_ = new QOpenGLPaintDevice();
+    statisticsDevice_->setSize(QSize(renderSize_.width, renderSize_.height));
+    statisticsDevice_->setDevicePixelRatio(renderSize_.pixelRatio);
+
+    // QPainter leaves its own state behind, keep the one of the renderer.
+    // The attribute stacks only exist outside of a core profile.
+    const bool coreProfile =
+            (context_->format().profile() == QSurfaceFormat::CoreProfile);
+    GLint blendSource = GL_ONE;
+    GLint blendDestination = GL_ZERO;
+    const GLboolean blend = glIsEnabled(GL_BLEND);
+    glGetIntegerv(GL_BLEND_SRC_RGB, &blendSource);
+    glGetIntegerv(GL_BLEND_DST_RGB, &blendDestination);
+    if (!coreProfile) {
+        glPushAttrib(GL_ALL_ATTRIB_BITS);
+        glPushClientAttrib(GL_CLIENT_ALL_ATTRIB_BITS);
+        glMatrixMode(GL_PROJECTION);
+        glPushMatrix();
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+    }
+
+    QStringList lines;
+    lines << QString("%1 %2 %3 %4 %5").arg("", -13)
+             .arg("min", 7).arg("avg", 7).arg("p95", 7).arg("p99", 7);
+    for (int i = 0; i < FrameStatistics::SERIES_COUNT; i++) {
+        const FrameStatistics::Series series = (FrameStatistics::Series) i;
+        const FrameStatistics::Summary summary =
+                frameStatistics_.Summarize(series);
+
+        // No GPU timer, or no input so far
+        if (summary.count == 0) {
+            lines << QString("%1 n/a")
+                     .arg(FrameStatistics::GetSeriesName(series), -13);
+            continue;
+        }
+
+        lines << QString("%1 %2 %3 %4 %5")
+                 .arg(FrameStatistics::GetSeriesName(series), -13)
+                 .arg(summary.minimum, 7, 'f', 2)
+                 .arg(summary.average, 7, 'f', 2)
+                 .arg(summary.percentile95, 7, 'f', 2)
+                 .arg(summary.percentile99, 7, 'f', 2);
+    }
+
+    const FrameStatistics::Summary frame =
+            frameStatistics_.Summarize(FrameStatistics::SERIES_FRAME);
+    if (frame.average > 0.f)
+        lines << QString("%1 frames/s, times in ms")
+                 .arg(1000.f / frame.average, 0, 'f', 1);
+
+    // Inputs per 10 ms of latency, the last bucket holds the slower ones
+    const QVector<int> latencies = frameStatistics_.GetHistogram(
+                FrameStatistics::SERIES_INPUT_LATENCY, 10.f, 8);
+    QString histogram = QString("%1").arg("per 10 ms", -13);
+    for (int i = 0; i < latencies.size(); i++) {
+        histogram += QString(" %1").arg(latencies[i], 4);
+    }
+    lines << histogram;
+
+    QPainter painter(statisticsDevice_);
+    QFont font("Monospace");
+    font.setStyleHint(QFont::TypeWriter);
+    painter.setFont(font);
+    const QFontMetrics metrics(font);
+    int textWidth = 0;
+    for (int i = 0; i < lines.size(); i++) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+        textWidth = qMax(textWidth, metrics.horizontalAdvance(lines[i]));
+#else
+        textWidth = qMax(textWidth, metrics.width(lines[i]));
+#endif
+    }
+    const QRect box(8, 8, textWidth + 16,
+                    metrics.lineSpacing() * lines.size() + 12);
+    painter.fillRect(box, QColor(0, 0, 0, 160));
+    painter.setPen(Qt::white);
+    painter.drawText(box.adjusted(8, 6, -8, -6), Qt::AlignLeft | Qt::AlignTop,
+                     lines.join('\n'));
+    painter.end();
+
+    // The fixed-function pipeline has no program
+    glUseProgram(0);
+    if (!coreProfile) {
+        glMatrixMode(GL_PROJECTION);
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+        glPopMatrix();
+        glPopClientAttrib();
+        glPopAttrib();
+    }
+    glBlendFunc(blendSource, blendDestination);
+    if (blend)
+        glEnable(GL_BLEND);
+    else
+        glDisable(GL_BLEND);
+}
+
 /**
  * @brief OpenGLWindow::RenderLater
- * Update some operation and then render the screen.
+ * Marks the window dirty. Any number of calls before the next frame
+ * result in a single frame.
  */
 void OpenGLWindow::RenderLater()
 {
+    PublishState();
+
+    // The input goes with the state it changed, and is measured with the
+    // first frame that takes the state
+    if (inputTime_ != 0) {
+        qint64 noInput = 0;
+        pendingInputTime_.compare_exchange_strong(noInput, inputTime_);
+    }
+
+    RequestFrame();
+}
+
+/**
+ * @brief OpenGLWindow::RequestFrame
+ */
+void OpenGLWindow::RequestFrame()
+{
+    // _renderThreadStarted_ is set before the render thread exists
+    if (renderThreadStarted_) {
+        {
+            std::lock_guard<std::mutex> lock(frameMutex_);
+            frameRequested_ = true;
+        }
+        frameCondition_.notify_one();
+        return;
+    }
+
     if (!updatePending_) {
         // There is an update pending and then render the window.
         updatePending_ = true;
 
-        QCoreApplication::postEvent(this, new QEvent(QEvent::UpdateRequest));
+        // Delivered in step with the display refresh where the platform
+        // supports it
+        requestUpdate();
     }
 }
 
 /**
  * @brief OpenGLWindow::RenderNow
+ * Renders on the UI thread, or wakes the render thread up.
  */
 void OpenGLWindow::RenderNow()
 {
+    if (renderThreadStarted_) {
+        RenderLater();
+        return;
+    }
+
     // If the window is not show, then return.
     if (!isExposed())
         return;
@@ -150,11 +617,38 @@ void OpenGLWindow::RenderNow()
         needsInitialize = true;
     }
 
+    PublishState();
+    PresentFrame(needsInitialize);
+
+    // Frames are otherwise only rendered when something changed
+    if (animating_)
+        RenderLater();
+}
+
+/**
+ * @brief OpenGLWindow::PresentFrame
+ * @param initialize
+ */
+void OpenGLWindow::PresentFrame(bool initialize)
+{
+    TRACE_SCOPE("OpenGLWindow::PresentFrame");
+
+    // Interval since the previous frame
+    if (frameTimer_.isValid()) {
+        frameStatistics_.Add(FrameStatistics::SERIES_FRAME,
+                             frameTimer_.nsecsElapsed() / 1e6);
+    }
+    frameTimer_.start();
+    QElapsedTimer phaseTimer;
+
     // Make this context the current context.
+    phaseTimer.start();
     context_->makeCurrent(this);
+    frameStatistics_.Add(FrameStatistics::SERIES_MAKE_CURRENT,
+                         phaseTimer.nsecsElapsed() / 1e6);
 
     // If it is a new context, then initialize the context, else render directly
-    if (needsInitialize) {
+    if (initialize) {
 
         // Initialize OpenGL windowing system
         initializeOpenGLFunctions();
@@ -162,23 +656,64 @@ void OpenGLWindow::RenderNow()
         // Custom initialization
         Initialize();
 
-        // Adjust the aspect ratio of the window
-        const qreal retinaScale = devicePixelRatio();
+        // A ring deep enough for the frames the driver queues ahead
+        gpuTimerAvailable_ = gpuTimer_.Initialize(4);
+    }
 
-        // Resize the window
-        ResizeGLWindow(width() * retinaScale, height() * retinaScale);
+    // Resizes take effect with the context current
+    if (surfaceSizes_.Update() || initialize) {
+        renderSize_ = surfaceSizes_.Read();
+        ResizeGLWindow(renderSize_.width, renderSize_.height);
     }
 
+    // Taken first, so that the state of the input is published already
+    const qint64 inputTime = pendingInputTime_.exchange(0);
+
+    // Latest camera and parameters of the UI
+    SynchronizeState();
+
     // Render the frame
+    phaseTimer.start();
+    gpuTimer_.Begin();
     Render();
+    gpuTimer_.End();
+    frameStatistics_.Add(FrameStatistics::SERIES_RENDER,
+                         phaseTimer.nsecsElapsed() / 1e6);
+    gpuTimer_.Collect(&frameStatistics_);
+
+    if (showFrameStatistics_)
+        DrawFrameStatistics();
 
     // Push pixels and swap buffers
-    context_->swapBuffers(this);
+    phaseTimer.start();
+    {
+        TRACE_SCOPE("QOpenGLContext::swapBuffers");
+        context_->swapBuffers(this);
+    }
+    frameStatistics_.Add(FrameStatistics::SERIES_SWAP,
+                         phaseTimer.nsecsElapsed() / 1e6);
+
+    // The frame is queued for the display, scan-out is not accounted
+    lastSwapTime_ = GetTimestamp();
+    if (inputTime != 0) {
+        frameStatistics_.Add(FrameStatistics::SERIES_INPUT_LATENCY,
+                             (lastSwapTime_ - inputTime) / 1e6);
+    }
+}
 
-    // If the window is animating, stop rendering and render later once the
-    // window is stopped.
-    if (animating_)
-        RenderLater();
+/**
+ * @brief OpenGLWindow::PublishSurfaceSize
+ */
+void OpenGLWindow::PublishSurfaceSize()
+{
+    // Adjust the aspect ratio of the window
+    SurfaceSize size;
+    size.pixelRatio = devicePixelRatio();
+    size.width = width() * size.pixelRatio;
+    size.height = height() * size.pixelRatio;
+    if (screen() && screen()->refreshRate() > 0.0)
+        size.refreshPeriod = 1e9 / screen()->refreshRate();
+    surfaceSizes_.Publish(size);
 }
 
 /**
@@ -190,11 +725,31 @@ void OpenGLWindow::RenderNow()
 bool OpenGLWindow::event(QEvent *event)
 {
     switch (event->type()) {
+    case QEvent::MouseButtonPress :
+    case QEvent::MouseButtonRelease :
+    case QEvent::MouseMove :
+    case QEvent::Wheel :
+    case QEvent::KeyPress : {
+        // Frames requested by the handlers measure the latency of the input
+        inputTime_ = GetTimestamp();
+        const bool handled = QWindow::event(event);
+        inputTime_ = 0;
+        return handled;
+    }   break;
     case QEvent::UpdateRequest : {
         updatePending_ = false;
         RenderNow();
         return true;
     }   break;
+    case QEvent::PlatformSurface : {
+        // The render thread must not draw into a destroyed surface
+        const QPlatformSurfaceEvent* surfaceEvent =
+                static_cast<QPlatformSurfaceEvent *>(event);
+        if (surfaceEvent->surfaceEventType() ==
+                QPlatformSurfaceEvent::SurfaceAboutToBeDestroyed)
+            StopRenderThread();
+        return QWindow::event(event);
+    }   break;
     default:
         return QWindow::event(event);
         break;
@@ -207,8 +762,12 @@ bool OpenGLWindow::event(QEvent *event)
  */
 void OpenGLWindow::exposeEvent(QExposeEvent *event)
 {
+    exposed_ = isExposed();
+
     // If the window is exposed, then render it.
     if (isExposed()) {
+        PublishSurfaceSize();
+        StartRenderThread();
         RenderNow();
     }
 
@@ -221,15 +780,9 @@ void OpenGLWindow::exposeEvent(QExposeEvent *event)
  */
 void OpenGLWindow::resizeEvent(QResizeEvent *event)
 {
-    // Get the new window width and height
-    const int windowNewWidth = event->size().width();
-    const int windowNewHeight = event->size().height();
-
-    // Aspect ratio
-    const qreal retinaScale = devicePixelRatio();
-
-    // Resize OpenGL window
-    ResizeGLWindow(windowNewWidth*retinaScale, windowNewHeight*retinaScale);
+    // Resize the OpenGL window with the next frame, on the thread that
+    // owns the context
+    PublishSurfaceSize();
 
     // Update frame
     RenderNow();
@@ -261,6 +814,11 @@ void OpenGLWindow::keyPressEvent(QKeyEvent *event)
 
     } break;
 
+    case Qt::Key_H:
+        ToggleFrameStatistics();
+        RenderLater();
+        break;
+
     case Qt::Key_Escape: {
         qApp->exit();
 
@@ -284,7 +842,7 @@ void OpenGLWindow::SetZTranslation(int distance)
     if (distance != zTranslation_) {
         zTranslation_ = distance;
         emit zTranslationChanged(distance);
-        Render();
+        RenderLater();
     }
 }
 
@@ -294,7 +852,7 @@ void OpenGLWindow::SetXRotation(int angle)
     if (angle != xRotation_) {
         xRotation_ = angle;
         emit xRotationChanged(angle);
-        Render();
+        RenderLater();
     }
 }
 
@@ -304,7 +862,7 @@ void OpenGLWindow::SetYRotation(int angle)
     if (angle != yRotation_) {
         yRotation_ = angle;
         emit yRotationChanged(angle);
-        Render();
+        RenderLater();
     }
 }
 
@@ -314,7 +872,7 @@ void OpenGLWindow::SetZRotation(int angle)
     if (angle != zRotation_) {
         zRotation_ = angle;
         emit zRotationChanged(angle);
-        Render();
+        RenderLater();
     }
 }
 
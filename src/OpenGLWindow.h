@@ -28,11 +28,37 @@
 #include <QKeyEvent>
 #include <QMatrix4x4>
 #include <QtGui>
+#include <QOffscreenSurface>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLPaintDevice>
+#include <QElapsedTimer>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include "FrameStatistics.h"
+#include "GpuTimer.h"
+#include "TripleBuffer.h"
 
 class OpenGLWindow : public QWindow, protected QOpenGLFunctions
 {
     Q_OBJECT
 public:
+    /**
+     * @brief The FramePacing enum
+     * When the render thread starts a requested frame.
+     */
+    enum FramePacing {
+        /** As soon as it is requested */
+        FRAME_PACING_IMMEDIATE,
+
+        /** As late before the next refresh as the recent frame times
+         * allow, so that the frame shows the latest input. Needs the render
+         * thread and a swap interval of 1 */
+        FRAME_PACING_LATE
+    };
+
     /**
      * @brief OpenGLWindow
      * @param parent
@@ -46,10 +72,82 @@ public:
 
     /**
      * @brief ToogleAnimation
+     * Renders frames back to back instead of only when the view changed,
+     * for measuring.
      * @param animating
      */
     void ToogleAnimation(bool animating);
 
+    /**
+     * @brief SetRenderThread
+     * Renders on a thread of its own when the platform supports it, so
+     * that a slow frame does not hold up the input. On by default, must be
+     * called before the window is shown.
+     * @param enabled
+     */
+    void SetRenderThread(bool enabled);
+
+    /**
+     * @brief SetFramePacing
+     * @param pacing
+     * @param marginMilliseconds Kept between the predicted end of a late
+     * frame and the refresh, for the frames slower than predicted.
+     */
+    void SetFramePacing(FramePacing pacing, float marginMilliseconds);
+
+    /**
+     * @brief GetFrameStatistics
+     * Only to be read on the thread that renders, or once the render thread
+     * has stopped.
+     * @return Timings and input latencies of the last window frames.
+     */
+    const FrameStatistics& GetFrameStatistics() const;
+
+    /**
+     * @brief CreateOffscreenContext
+     * Initializes the window on an offscreen surface instead of showing
+     * it. The frames are then rendered with RenderOffscreen into a
+     * framebuffer object of a fixed size.
+     * @param size Image size in pixels.
+     * @param samples Multisampling of the framebuffer object, 0 for none.
+     * @return False if no context could be created.
+     */
+    bool CreateOffscreenContext(const QSize& size, int samples);
+
+    /**
+     * @brief RenderOffscreen
+     * Renders one frame into the offscreen framebuffer object.
+     * @return The frame, resolved if multisampled.
+     */
+    QImage RenderOffscreen();
+
+    /**
+     * @brief RenderOffscreenFrame
+     * Renders one frame into the offscreen framebuffer object without
+     * waiting for it, and leaves a single-sampled copy of it bound so that
+     * it can be read asynchronously.
+     */
+    void RenderOffscreenFrame();
+
+    /**
+     * @brief FinishOffscreenFrame
+     * Blocks until the GPU is done with the frames rendered so far.
+     */
+    void FinishOffscreenFrame();
+
+    /**
+     * @brief IsOffscreen
+     * @return True if the frames are rendered with RenderOffscreen, each
+     * of them has to be complete.
+     */
+    bool IsOffscreen() const;
+
+    /**
+     * @brief ToggleFrameStatistics
+     * Shows or hides the frame timings over the rendering.
+     */
+    void ToggleFrameStatistics();
+
 public slots:
     /**
      * @brief RenderLater
@@ -61,6 +159,13 @@ public slots:
      */
     void RenderNow();
 
+    /**
+     * @brief StopRenderThread
+     * Waits for the frame in progress and releases the context. Nothing is
+     * rendered afterwards.
+     */
+    void StopRenderThread();
+
     /**
      * @brief SetXRotation
      * @param angle
@@ -142,6 +247,26 @@ protected:
      */
     virtual void Render();
 
+    /**
+     * @brief PublishState
+     * Called on the UI thread by RenderLater and RenderNow, hands the state
+     * edited by the UI to the renderer.
+     */
+    virtual void PublishState();
+
+    /**
+     * @brief SynchronizeState
+     * Called before every frame on the thread that renders, takes the
+     * latest published state.
+     */
+    virtual void SynchronizeState();
+
+    /**
+     * @brief RequestFrame
+     * Schedules a frame without publishing any state, from any thread.
+     */
+    void RequestFrame();
+
     /**
      * @brief Initialize
      */
@@ -166,6 +291,12 @@ protected:
      */
     void mouseMoveEvent(QMouseEvent *event);
 
+    /**
+     * @brief DrawFrameStatistics
+     * Paints the timing overlay over the frame.
+     */
+    void DrawFrameStatistics();
+
     /** \brief OpenGL projection matrix */
     QMatrix4x4 projectionMatrix;
 
@@ -175,7 +306,8 @@ protected:
     /** \brief Full-screen mode */
     bool fullScreen_;
 
-    /** \brief X-axis rotation */
+    /** \brief X-axis rotation, edited on the UI thread like the other
+     * camera members */
     GLfloat xRotation_;
 
     /** \brief Y-axis rotation */
@@ -196,15 +328,150 @@ protected:
     /** \brief Last position the mouse was clicked */
     QPoint lastPosition_;
 
+private:
+    /**
+     * @brief The SurfaceSize struct
+     * Window size handed to the renderer.
+     */
+    struct SurfaceSize
+    {
+        /** \brief Width in device pixels */
+        int width;
+
+        /** \brief Height in device pixels */
+        int height;
+
+        /** \brief Device pixels per window unit */
+        qreal pixelRatio;
+
+        /** \brief Nanoseconds between two refreshes of the screen, 0 if
+         * unknown */
+        qint64 refreshPeriod;
+
+        SurfaceSize() : width(0), height(0), pixelRatio(1.0),
+            refreshPeriod(0) {}
+    };
+
+    /**
+     * @brief StartRenderThread
+     */
+    void StartRenderThread();
+
+    /**
+     * @brief RenderLoop
+     * Body of the render thread.
+     */
+    void RenderLoop();
+
+    /**
+     * @brief PresentFrame
+     * Renders and swaps one frame of the window.
+     * @param initialize The context was just created.
+     */
+    void PresentFrame(bool initialize);
+
+    /**
+     * @brief PublishSurfaceSize
+     */
+    void PublishSurfaceSize();
+
+    /**
+     * @brief GetFrameStartTime
+     * @return When the next frame has to start with late pacing, 0 to
+     * start it right away.
+     */
+    qint64 GetFrameStartTime();
+
+    /**
+     * @brief GetTimestamp
+     * @return Nanoseconds on a monotonic clock, comparable across threads.
+     */
+    static qint64 GetTimestamp();
+
 private:
     /** \brief Are there any updates pending! */
     bool updatePending_;
 
     /** \brief Is the window animating */
-    bool animating_;
+    std::atomic<bool> animating_;
+
+    /** \brief Render on a thread of its own if possible */
+    bool renderThreadEnabled_;
+
+    /** \brief The render thread was started, set once on the UI thread */
+    bool renderThreadStarted_;
+
+    /** \brief Owns the context and draws the frames */
+    std::thread renderThread_;
+
+    /** \brief Guards _frameRequested_ and _stopRendering_ */
+    std::mutex frameMutex_;
+
+    /** \brief Wakes the render thread */
+    std::condition_variable frameCondition_;
+
+    /** \brief A frame is due */
+    bool frameRequested_;
+
+    /** \brief The render thread has to exit */
+    bool stopRendering_;
+
+    /** \brief The window is visible */
+    std::atomic<bool> exposed_;
+
+    /** \brief Window sizes from the UI thread */
+    TripleBuffer<SurfaceSize> surfaceSizes_;
+
+    /** \brief Size the frames are rendered at */
+    SurfaceSize renderSize_;
+
+    /** \brief Arrival of the input being handled on the UI thread, 0
+     * outside of input handlers */
+    qint64 inputTime_;
+
+    /** \brief Arrival of the oldest input whose state was published but
+     * not rendered yet, 0 if none */
+    std::atomic<qint64> pendingInputTime_;
+
+    /** \brief When the render thread starts the requested frames */
+    FramePacing framePacing_;
+
+    /** \brief Nanoseconds kept before the refresh with late pacing */
+    qint64 pacingMargin_;
+
+    /** \brief Return of the last swap, the phase of the refresh with late
+     * pacing, 0 before the first frame */
+    qint64 lastSwapTime_;
 
     /** \brief OpenGL context */
     QOpenGLContext *context_;
+
+    /** \brief Surface of the context when rendering without a window */
+    QOffscreenSurface *offscreenSurface_;
+
+    /** \brief Render target when rendering without a window */
+    QOpenGLFramebufferObject *offscreenFbo_;
+
+    /** \brief Single-sampled copy of a multisampled _offscreenFbo_ */
+    QOpenGLFramebufferObject *offscreenResolveFbo_;
+
+    /** \brief Rolling timings of the window frames */
+    FrameStatistics frameStatistics_;
+
+    /** \brief GPU time of the window frames */
+    GpuTimer gpuTimer_;
+
+    /** \brief The context supports timer queries */
+    bool gpuTimerAvailable_;
+
+    /** \brief Started at the beginning of each frame */
+    QElapsedTimer frameTimer_;
+
+    /** \brief Show the timing overlay */
+    std::atomic<bool> showFrameStatistics_;
+
+    /** \brief Paint device of the timing overlay */
+    QOpenGLPaintDevice *statisticsDevice_;
 };
 
 #endif // OPENGLWINDOW_H
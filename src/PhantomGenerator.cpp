@@ -0,0 +1,254 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "PhantomGenerator.h"
+#include "VolumeFile.h"
+#include <QFile>
+#include <QVector>
+#include <atomic>
+#include <math.h>
+
+/** \brief Bytes generated and written per task */
+static const qint64 PHANTOM_SLAB_BYTES = 8 * 1024 * 1024;
+
+/**
+ * @brief PhantomGenerator::PhantomGenerator
+ * @param phantom
+ * @param seed
+ */
+PhantomGenerator::PhantomGenerator(Phantom phantom, quint32 seed) :
+    phantom_(phantom),
+    seed_(seed)
+{
+    // Place the spheres from the seed, inside the unit ball
+    for (int i = 0; i < SPHERE_COUNT; i++) {
+        const float radius = 0.08f + 0.2f * Hash(i, 0, 7);
+        for (int axis = 0; axis < 3; axis++) {
+            spheres_[i][axis] =
+                    (2.f * Hash(i, axis + 1, 11) - 1.f) * (0.9f - radius);
+        }
+        spheres_[i][3] = radius;
+        sphereValues_[i] = 64 + (GLubyte) (191 * Hash(i, 4, 13));
+    }
+}
+
+/**
+ * @brief PhantomGenerator::Hash
+ * @param i
+ * @param j
+ * @param k
+ * @return
+ */
+float PhantomGenerator::Hash(int i, int j, int k) const
+{
+    quint32 h = seed_ * 0x9E3779B1u;
+    h ^= (quint32) i * 0x85EBCA77u;
+    h = (h << 13) | (h >> 19);
+    h ^= (quint32) j * 0xC2B2AE3Du;
+    h = (h << 13) | (h >> 19);
+    h ^= (quint32) k * 0x27D4EB2Fu;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    h *= 0x297A2D39u;
+    h ^= h >> 15;
+    return (h >> 8) * (1.f / 16777216.f);
+}
+
+/**
+ * @brief PhantomGenerator::Noise
+ * @param x
+ * @param y
+ * @param z
+ * @return
+ */
+float PhantomGenerator::Noise(float x, float y, float z) const
+{
+    const int i = (int) floorf(x);
+    const int j = (int) floorf(y);
+    const int k = (int) floorf(z);
+    const float fx = x - i;
+    const float fy = y - j;
+    const float fz = z - k;
+
+    // Smoothstep weights hide the lattice
+    const float wx = fx * fx * (3.f - 2.f * fx);
+    const float wy = fy * fy * (3.f - 2.f * fy);
+    const float wz = fz * fz * (3.f - 2.f * fz);
+
+    float value = 0.f;
+    for (int c = 0; c < 8; c++) {
+        const int dx = c & 1;
+        const int dy = (c >> 1) & 1;
+        const int dz = c >> 2;
+        value += Hash(i + dx, j + dy, k + dz) *
+                (dx ? wx : 1.f - wx) *
+                (dy ? wy : 1.f - wy) *
+                (dz ? wz : 1.f - wz);
+    }
+    return value;
+}
+
+/**
+ * @brief PhantomGenerator::Voxel
+ * @param x
+ * @param y
+ * @param z
+ * @return
+ */
+GLubyte PhantomGenerator::Voxel(float x, float y, float z) const
+{
+    switch (phantom_) {
+    case PHANTOM_SPHERES: {
+        GLubyte value = 0;
+        for (int i = 0; i < SPHERE_COUNT; i++) {
+            const float dx = x - spheres_[i][0];
+            const float dy = y - spheres_[i][1];
+            const float dz = z - spheres_[i][2];
+            const float r = spheres_[i][3];
+            if (dx * dx + dy * dy + dz * dz < r * r)
+                value = qMax(value, sphereValues_[i]);
+        }
+        return value;
+    }
+
+    case PHANTOM_NOISE: {
+        // Three octaves, from blobs to fine grain
+        const float noise = 0.57f * Noise(4.f * x, 4.f * y, 4.f * z) +
+                0.29f * Noise(8.f * x, 8.f * y, 8.f * z) +
+                0.14f * Noise(16.f * x, 16.f * y, 16.f * z);
+        return (GLubyte) qBound(0.f, 255.f * noise, 255.f);
+    }
+
+    case PHANTOM_SHELLS:
+    default: {
+        // Normalized radius of the head ellipsoid
+        const float r = sqrtf(x * x / 0.64f + y * y / 0.81f + z * z / 0.72f);
+        const float grain = Noise(24.f * x, 24.f * y, 24.f * z);
+        if (r > 1.f)
+            return (GLubyte) (6.f * grain);      // Air
+        if (r > 0.94f)
+            return 90 + (GLubyte) (10.f * grain);  // Skin
+        if (r > 0.84f)
+            return 220 + (GLubyte) (30.f * grain); // Bone
+
+        // Ventricles, two small ellipsoids either side of the midline
+        const float vx = (fabsf(x) - 0.12f) / 0.08f;
+        const float vy = (y - 0.05f) / 0.25f;
+        const float vz = z / 0.12f;
+        if (vx * vx + vy * vy + vz * vz < 1.f)
+            return 30 + (GLubyte) (10.f * grain);
+
+        return 105 + (GLubyte) (20.f * grain);   // Tissue
+    }
+    }
+}
+
+/**
+ * @brief PhantomGenerator::GenerateSlices
+ * @param data
+ * @param width
+ * @param height
+ * @param depth
+ * @param firstSlice
+ * @param lastSlice
+ */
+void PhantomGenerator::GenerateSlices(GLubyte* data,
+                                      int width, int height, int depth,
+                                      int firstSlice, int lastSlice) const
+{
+    // Voxel centres mapped to [-1, 1] on every axis
+    const float sx = 2.f / width;
+    const float sy = 2.f / height;
+    const float sz = 2.f / depth;
+
+    for (int k = firstSlice; k < lastSlice; k++) {
+        const float z = (k + 0.5f) * sz - 1.f;
+        for (int j = 0; j < height; j++) {
+            const float y = (j + 0.5f) * sy - 1.f;
+            for (int i = 0; i < width; i++) {
+                *data++ = Voxel((i + 0.5f) * sx - 1.f, y, z);
+            }
+        }
+    }
+}
+
+/**
+ * @brief PhantomGenerator::Write
+ * @param prefix
+ * @param width
+ * @param height
+ * @param depth
+ * @param threadPool
+ * @return
+ */
+bool PhantomGenerator::Write(const char* prefix,
+                             int width, int height, int depth,
+                             ThreadPool* threadPool) const
+{
+    const QString imgPath = QString("%1.img").arg(prefix);
+    const QString hdrPath = QString("%1.hdr").arg(prefix);
+    if (!VolumeFile::WriteHeader(hdrPath.toLocal8Bit().constData(),
+                                 width, height, depth))
+        return false;
+
+    // Size the file first, so every slab can be written at its offset
+    const qint64 sliceBytes = (qint64) width * height;
+    {
+        QFile imgFile(imgPath);
+        if (!imgFile.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+                !imgFile.resize(sliceBytes * depth))
+            return false;
+    }
+
+    const qint64 slabSlices = qMax((qint64) 1, PHANTOM_SLAB_BYTES / sliceBytes);
+    std::atomic<bool> failed(false);
+    threadPool->ParallelFor(0, depth, slabSlices,
+                            [&] (qint64 firstSlice, qint64 lastSlice) {
+        QVector<GLubyte> slab(sliceBytes * (lastSlice - firstSlice));
+        GenerateSlices(slab.data(), width, height, depth,
+                       firstSlice, lastSlice);
+
+        // One handle per slab, the writes do not share a file position
+        QFile imgFile(imgPath);
+        if (!imgFile.open(QIODevice::ReadWrite) ||
+                !imgFile.seek(firstSlice * sliceBytes) ||
+                imgFile.write((const char*) slab.constData(), slab.size()) !=
+                slab.size()) {
+            failed = true;
+        }
+    });
+
+    return !failed;
+}
+
+/**
+ * @brief PhantomGenerator::GetPhantomName
+ * @param phantom
+ * @return
+ */
+const char* PhantomGenerator::GetPhantomName(Phantom phantom)
+{
+    switch (phantom) {
+    case PHANTOM_SPHERES: return "spheres";
+    case PHANTOM_NOISE:   return "noise";
+    case PHANTOM_SHELLS:  return "shells";
+    default:              return "";
+    }
+}
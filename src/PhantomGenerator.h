@@ -0,0 +1,140 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef PHANTOMGENERATOR_H
+#define PHANTOMGENERATOR_H
+
+#include <QtGlobal>
+#include <QtGui/qopengl.h>
+#include "ThreadPool.h"
+
+/**
+ * @brief The PhantomGenerator class
+ * Generates procedural 8-bit test volumes of any size and writes them as
+ * <prefix>.hdr/.img pairs. Every voxel is a function of its position and
+ * the seed only, so slabs can be generated and written concurrently and a
+ * volume is the same whatever the number of threads.
+ */
+class PhantomGenerator
+{
+public:
+    /**
+     * @brief The Phantom enum
+     * Kinds of volumes.
+     */
+    enum Phantom {
+        /** Solid spheres of different densities in an empty volume */
+        PHANTOM_SPHERES,
+
+        /** Smooth fractal noise filling the whole volume */
+        PHANTOM_NOISE,
+
+        /** Nested ellipsoidal shells resembling a head CT */
+        PHANTOM_SHELLS
+    };
+
+    /**
+     * @brief PhantomGenerator
+     * @param phantom
+     * @param seed
+     */
+    explicit PhantomGenerator(Phantom phantom = PHANTOM_SHELLS,
+                              quint32 seed = 1);
+
+    /**
+     * @brief GenerateSlices
+     * Fills the slices [firstSlice, lastSlice) of a volume.
+     * @param data First voxel of _firstSlice_.
+     * @param width
+     * @param height
+     * @param depth
+     * @param firstSlice
+     * @param lastSlice
+     */
+    void GenerateSlices(GLubyte* data, int width, int height, int depth,
+                        int firstSlice, int lastSlice) const;
+
+    /**
+     * @brief Write
+     * Generates the volume slab by slab on the thread pool, each slab
+     * written at its offset of <prefix>.img as soon as it is ready.
+     * @param prefix
+     * @param width
+     * @param height
+     * @param depth
+     * @param threadPool
+     * @return False if a file could not be written.
+     */
+    bool Write(const char* prefix, int width, int height, int depth,
+               ThreadPool* threadPool) const;
+
+    /**
+     * @brief GetPhantomName
+     * @param phantom
+     * @return Printable name of the phantom.
+     */
+    static const char* GetPhantomName(Phantom phantom);
+
+    /** \brief Number of spheres of the sphere phantom */
+    static const int SPHERE_COUNT = 12;
+
+private:
+    /**
+     * @brief Voxel
+     * @param x In [-1, 1].
+     * @param y In [-1, 1].
+     * @param z In [-1, 1].
+     * @return Scalar at the position.
+     */
+    GLubyte Voxel(float x, float y, float z) const;
+
+    /**
+     * @brief Noise
+     * Trilinear value noise of the lattice hashed from the seed.
+     * @param x
+     * @param y
+     * @param z
+     * @return In [0, 1].
+     */
+    float Noise(float x, float y, float z) const;
+
+    /**
+     * @brief Hash
+     * @param i
+     * @param j
+     * @param k
+     * @return In [0, 1].
+     */
+    float Hash(int i, int j, int k) const;
+
+private:
+    /** \brief Kind of volume */
+    Phantom phantom_;
+
+    /** \brief Seed of the noise and of the sphere placement */
+    quint32 seed_;
+
+    /** \brief Centre and radius of every sphere */
+    float spheres_[SPHERE_COUNT][4];
+
+    /** \brief Scalar of every sphere */
+    GLubyte sphereValues_[SPHERE_COUNT];
+};
+
+#endif // PHANTOMGENERATOR_H
@@ -0,0 +1,273 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "RayCastRenderer.h"
+#include "ShaderPrelude.h"
+#include <QDebug>
+
+/** \brief Passes the window corner through */
+static const char* RAY_VERTEX_SHADER =
+    "attribute vec2 corner;\n"
+    "varying vec2 windowCoord;\n"
+    "void main()\n"
+    "{\n"
+    "    windowCoord = corner;\n"
+    "    gl_Position = vec4(corner, 0.0, 1.0);\n"
+    "}\n";
+
+/** \brief Clips the ray of the pixel to the unit cube and composites the
+ * samples front to back. The texels are premultiplied, their opacity is
+ * corrected for the ratio between the sampling and the reference step. A
+ * sample in an empty cell moves the ray to the first sample past the block
+ * of empty cells around it. */
+static const char* RAY_FRAGMENT_SHADER =
+    "uniform sampler3D volume;\n"
+    "uniform sampler1D transferFunction;\n"
+    "uniform sampler3D emptySpace;\n"
+    "uniform vec3 cellExtent;\n"
+    "uniform vec3 cellCount;\n"
+    "uniform bool skipEmptySpace;\n"
+    "uniform mat4 clipToVolume;\n"
+    "uniform float samplingStep;\n"
+    "uniform float opacityExponent;\n"
+    "uniform float terminationOpacity;\n"
+    "varying vec2 windowCoord;\n"
+    "vec4 Sample(vec3 position)\n"
+    "{\n"
+    "    vec4 texel = texture3D(volume, position);\n"
+    "#ifdef SCALAR_TEXTURE\n"
+    "    texel = texture1D(transferFunction,\n"
+    "                      texel.r * (255.0 / 256.0) + 0.5 / 256.0);\n"
+    "#endif\n"
+    "    return texel;\n"
+    "}\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 nearPoint = clipToVolume * vec4(windowCoord, -1.0, 1.0);\n"
+    "    vec4 farPoint = clipToVolume * vec4(windowCoord, 1.0, 1.0);\n"
+    "    vec3 origin = nearPoint.xyz / nearPoint.w;\n"
+    "    vec3 direction = farPoint.xyz / farPoint.w - origin;\n"
+    "\n"
+    "    // Entry and exit against the slabs of the cube, axes the ray is\n"
+    "    // parallel to do not constrain it\n"
+    "    vec3 inverse = mix(vec3(1.0e6), 1.0 / direction,\n"
+    "                       step(vec3(1.0e-6), abs(direction)));\n"
+    "    vec3 t0 = -origin * inverse;\n"
+    "    vec3 t1 = (vec3(1.0) - origin) * inverse;\n"
+    "    vec3 tMin = min(t0, t1);\n"
+    "    vec3 tMax = max(t0, t1);\n"
+    "    float tEnter = max(max(tMin.x, tMin.y), max(tMin.z, 0.0));\n"
+    "    float tExit = min(min(tMax.x, tMax.y), min(tMax.z, 1.0));\n"
+    "    if (tEnter >= tExit)\n"
+    "        discard;\n"
+    "\n"
+    "    float rayLength = (tExit - tEnter) * length(direction);\n"
+    "    int steps = int(ceil(rayLength / samplingStep));\n"
+    "    vec3 rayStep = normalize(direction) * samplingStep;\n"
+    "    vec3 position = origin + direction * tEnter + 0.5 * rayStep;\n"
+    "    vec3 stepsPerUnit = 1.0 / max(abs(rayStep), vec3(1.0e-9));\n"
+    "\n"
+    "    vec4 color = vec4(0.0);\n"
+    "    int i = 0;\n"
+    "    while (i < steps) {\n"
+    "        if (skipEmptySpace) {\n"
+    "            vec3 cell = clamp(floor(position / cellExtent), vec3(0.0),\n"
+    "                              cellCount - vec3(1.0));\n"
+    "            float emptyCells = texture3D(emptySpace,\n"
+    "                    (cell + vec3(0.5)) / cellCount).r * 255.0;\n"
+    "\n"
+    "            // The samples before the ray leaves the block are\n"
+    "            // transparent\n"
+    "            if (emptyCells > 0.5) {\n"
+    "                vec3 blockMin = (cell - vec3(emptyCells - 1.0)) *\n"
+    "                                cellExtent;\n"
+    "                vec3 blockMax = (cell + vec3(emptyCells)) * cellExtent;\n"
+    "                vec3 leave = abs(mix(blockMin, blockMax,\n"
+    "                                     step(vec3(0.0), rayStep)) -\n"
+    "                                 position) * stepsPerUnit;\n"
+    "                int skipped = max(int(ceil(min(min(leave.x, leave.y),\n"
+    "                                               leave.z))), 1);\n"
+    "                i += skipped;\n"
+    "                position += float(skipped) * rayStep;\n"
+    "                continue;\n"
+    "            }\n"
+    "        }\n"
+    "\n"
+    "        vec4 texel = Sample(position);\n"
+    "        if (texel.a > 0.0) {\n"
+    "            float alpha = 1.0 - pow(1.0 - texel.a, opacityExponent);\n"
+    "            color += (1.0 - color.a) * texel * (alpha / texel.a);\n"
+    "\n"
+    "            // Early ray termination\n"
+    "            if (color.a >= terminationOpacity)\n"
+    "                break;\n"
+    "        }\n"
+    "        position += rayStep;\n"
+    "        i++;\n"
+    "    }\n"
+    "\n"
+    "    FRAG_COLOR = color;\n"
+    "}\n";
+
+/**
+ * @brief RayCastRenderer::RayCastRenderer
+ */
+RayCastRenderer::RayCastRenderer() :
+    program_(NULL),
+    quadBuffer_(QOpenGLBuffer::VertexBuffer),
+    terminationOpacity_(0.99f) { }
+
+/**
+ * @brief RayCastRenderer::~RayCastRenderer
+ */
+RayCastRenderer::~RayCastRenderer()
+{
+    delete program_;
+}
+
+/**
+ * @brief RayCastRenderer::Initialize
+ * @param coreProfile
+ * @param scalarTexture
+ * @return
+ */
+bool RayCastRenderer::Initialize(bool coreProfile, bool scalarTexture)
+{
+    const QByteArray vertexSource = ShaderPrelude::Prefix(
+                QOpenGLShader::Vertex, coreProfile, RAY_VERTEX_SHADER);
+
+    QByteArray fragmentShader;
+    if (scalarTexture)
+        fragmentShader += "#define SCALAR_TEXTURE\n";
+    fragmentShader += RAY_FRAGMENT_SHADER;
+    const QByteArray fragmentSource = ShaderPrelude::Prefix(
+                QOpenGLShader::Fragment, coreProfile, fragmentShader);
+
+    program_ = new QOpenGLShaderProgram();
+    program_->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexSource);
+    program_->addShaderFromSourceCode(QOpenGLShader::Fragment,
+                                      fragmentSource);
+    program_->bindAttributeLocation("corner", 0);
+    if (!program_->link()) {
+        qDebug() << "Could not link the ray-casting shader "
+                 << program_->log();
+        return false;
+    }
+
+    program_->bind();
+    program_->setUniformValue("volume", 0);
+    program_->setUniformValue("transferFunction", 1);
+    program_->setUniformValue("emptySpace", 2);
+    program_->release();
+
+    // Covers the whole window
+    const GLfloat corners[] = {
+        -1.0, -1.0,
+         1.0, -1.0,
+        -1.0,  1.0,
+         1.0,  1.0
+    };
+
+    // The attribute is set up on every frame, so this also works where
+    // vertex array objects are not available
+    vertexArray_.create();
+    QOpenGLVertexArrayObject::Binder binder(&vertexArray_);
+
+    quadBuffer_.create();
+    quadBuffer_.bind();
+    quadBuffer_.allocate(corners, sizeof(corners));
+    quadBuffer_.release();
+
+    return true;
+}
+
+/**
+ * @brief RayCastRenderer::Release
+ */
+void RayCastRenderer::Release()
+{
+    vertexArray_.destroy();
+    quadBuffer_.destroy();
+    delete program_;
+    program_ = NULL;
+}
+
+/**
+ * @brief RayCastRenderer::SetTerminationOpacity
+ * @param opacity
+ */
+void RayCastRenderer::SetTerminationOpacity(float opacity)
+{
+    terminationOpacity_ = qBound(0.f, opacity, 1.f);
+}
+
+/**
+ * @brief RayCastRenderer::GetTerminationOpacity
+ * @return
+ */
+float RayCastRenderer::GetTerminationOpacity() const
+{
+    return terminationOpacity_;
+}
+
+/**
+ * @brief RayCastRenderer::SetEmptySpace
+ * @param cellExtent
+ * @param cellCount
+ */
+void RayCastRenderer::SetEmptySpace(const QVector3D& cellExtent,
+                                    const QVector3D& cellCount)
+{
+    cellExtent_ = cellExtent;
+    cellCount_ = cellCount;
+}
+
+/**
+ * @brief RayCastRenderer::Render
+ * @param projection
+ * @param modelView
+ * @param samplingStep
+ * @param referenceStep
+ */
+void RayCastRenderer::Render(const QMatrix4x4& projection,
+                             const QMatrix4x4& modelView,
+                             float samplingStep, float referenceStep)
+{
+    program_->bind();
+    program_->setUniformValue("clipToVolume",
+                              (projection * modelView).inverted());
+    program_->setUniformValue("samplingStep", samplingStep);
+    program_->setUniformValue("opacityExponent",
+                              samplingStep / referenceStep);
+    program_->setUniformValue("terminationOpacity", terminationOpacity_);
+    program_->setUniformValue("skipEmptySpace", cellCount_.x() > 0.f);
+    program_->setUniformValue("cellExtent", cellExtent_);
+    program_->setUniformValue("cellCount", cellCount_);
+
+    QOpenGLVertexArrayObject::Binder binder(&vertexArray_);
+    quadBuffer_.bind();
+    program_->enableAttributeArray(0);
+    program_->setAttributeBuffer(0, GL_FLOAT, 0, 2);
+
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    program_->disableAttributeArray(0);
+    quadBuffer_.release();
+    program_->release();
+}
@@ -0,0 +1,119 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef RAYCASTRENDERER_H
+#define RAYCASTRENDERER_H
+
+#include <QMatrix4x4>
+#include <QOpenGLBuffer>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLVertexArrayObject>
+
+/**
+ * @brief The RayCastRenderer class
+ * Single-pass GPU ray caster. A full-window quad starts one ray per pixel,
+ * the ray is clipped to the unit volume cube and sampled front to back
+ * until it leaves the cube or its accumulated opacity passes the
+ * termination threshold. Blocks of empty cells are crossed in one jump.
+ */
+class RayCastRenderer
+{
+public:
+    /**
+     * @brief RayCastRenderer
+     */
+    RayCastRenderer();
+
+    /**
+     * @brief ~RayCastRenderer
+     */
+    ~RayCastRenderer();
+
+    /**
+     * @brief Initialize
+     * Builds the shaders and the quad, needs a current context.
+     * @param coreProfile Build GLSL 3.30 core shaders instead of 1.20.
+     * @param scalarTexture Classify raw scalars through the 1D transfer
+     * function bound to texture unit 1.
+     * @return False if the shaders could not be built.
+     */
+    bool Initialize(bool coreProfile, bool scalarTexture);
+
+    /**
+     * @brief Release
+     * Deletes the GPU objects, needs a current context.
+     */
+    void Release();
+
+    /**
+     * @brief SetTerminationOpacity
+     * @param opacity Accumulated opacity at which a ray stops.
+     */
+    void SetTerminationOpacity(float opacity);
+
+    /**
+     * @brief GetTerminationOpacity
+     * @return
+     */
+    float GetTerminationOpacity() const;
+
+    /**
+     * @brief SetEmptySpace
+     * Lets the rays jump over the empty cells given by the distance field
+     * bound to texture unit 2, see MinMaxGrid::GetDistanceField.
+     * @param cellExtent Edge of a cell in the unit cube along each axis.
+     * @param cellCount Number of cells along each axis, zero to sample
+     * every step.
+     */
+    void SetEmptySpace(const QVector3D& cellExtent,
+                       const QVector3D& cellCount);
+
+    /**
+     * @brief Render
+     * Casts the rays through the volume texture bound to texture unit 0.
+     * @param projection Eye to clip space.
+     * @param modelView Unit volume cube to eye space.
+     * @param samplingStep Distance between two samples in the unit cube.
+     * @param referenceStep Distance the opacities of the transfer function
+     * are defined for, used to correct them for the sampling step.
+     */
+    void Render(const QMatrix4x4& projection, const QMatrix4x4& modelView,
+                float samplingStep, float referenceStep);
+
+private:
+    /** \brief Ray-casting program */
+    QOpenGLShaderProgram* program_;
+
+    /** \brief Vertex array of the quad */
+    QOpenGLVertexArrayObject vertexArray_;
+
+    /** \brief Corners of the quad */
+    QOpenGLBuffer quadBuffer_;
+
+    /** \brief Opacity at which a ray stops */
+    float terminationOpacity_;
+
+    /** \brief Edge of an empty-space cell in the unit cube */
+    QVector3D cellExtent_;
+
+    /** \brief Empty-space cells along each axis, zero if not skipped */
+    QVector3D cellCount_;
+};
+
+#endif // RAYCASTRENDERER_H
@@ -0,0 +1,621 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QDateTime>
+#include <QSysInfo>
+#include <QFile>
+#include <QDir>
+#include <functional>
+#include <algorithm>
+#include <iostream>
+#include <math.h>
+#include <string.h>
+#include "VolumeFile.h"
+#include "VolumeClassifier.h"
+#include "ThreadPool.h"
+#include "MinMaxGrid.h"
+#include "VolumePyramid.h"
+#include "SliceGeometry.h"
+#include "PhantomGenerator.h"
+
+/** \brief Rows classified per task, as in VolumeSlicer::ClassifyVolume */
+static const qint64 CLASSIFICATION_SLAB_BYTES = 256 * 1024;
+
+/** \brief Cell size of the empty-space grid of the slicer */
+static const int EMPTY_SPACE_CELL_SIZE = 32;
+
+/** \brief View rotations per slice-geometry repetition */
+static const int GEOMETRY_ROTATIONS = 32;
+
+/** \brief Longest span and widest volume the kernels are verified on */
+static const int VERIFICATION_MAX_LENGTH = 67;
+
+/** \brief Bytes after every verified output that must stay untouched */
+static const int VERIFICATION_GUARD_BYTES = 64;
+
+/** \brief Guard byte value, not produced by the transfer function */
+static const GLubyte VERIFICATION_GUARD_VALUE = 0xCD;
+
+/**
+ * @brief The StageResult struct
+ * Timings of a benchmarked stage.
+ */
+struct StageResult
+{
+    /** \brief Stage name */
+    QString name;
+
+    /** \brief Bytes processed per repetition, 0 if not meaningful */
+    qint64 bytes;
+
+    /** \brief Items processed per repetition, 0 if not meaningful */
+    qint64 items;
+
+    /** \brief What the items are */
+    QString itemName;
+
+    /** \brief Seconds of every measured repetition, sorted */
+    QVector<double> seconds;
+
+    double Median() const { return seconds[seconds.size() / 2]; }
+
+    double Mean() const
+    {
+        double sum = 0.0;
+        for (int i = 0; i < seconds.size(); i++) {
+            sum += seconds[i];
+        }
+        return sum / seconds.size();
+    }
+};
+
+/**
+ * @brief MeasureStage
+ * Runs _body_ _warmUp_ times untimed, then _repetitions_ times timed.
+ * @param name
+ * @param bytes
+ * @param warmUp
+ * @param repetitions
+ * @param body Returns the number of items processed.
+ * @param itemName
+ * @return
+ */
+static StageResult MeasureStage(const QString& name, qint64 bytes,
+                                int warmUp, int repetitions,
+                                const std::function<qint64 ()>& body,
+                                const QString& itemName = QString())
+{
+    StageResult result;
+    result.name = name;
+    result.bytes = bytes;
+    result.items = 0;
+    result.itemName = itemName;
+
+    for (int i = 0; i < warmUp; i++) {
+        body();
+    }
+
+    QElapsedTimer timer;
+    for (int i = 0; i < repetitions; i++) {
+        timer.start();
+        result.items = body();
+        result.seconds.append(timer.nsecsElapsed() / 1e9);
+    }
+    std::sort(result.seconds.begin(), result.seconds.end());
+
+    // Report as we go, a slow stage should not look like a hang
+    std::cout << qPrintable(name.leftJustified(20))
+              << " median " << result.Median() * 1e3 << " ms";
+    if (bytes > 0)
+        std::cout << ", " << bytes / result.Median() / 1e9 << " GB/s";
+    if (!itemName.isEmpty())
+        std::cout << ", " << result.items / result.Median() << " "
+                  << qPrintable(itemName) << "/s";
+    std::cout << std::endl;
+
+    return result;
+}
+
+/**
+ * @brief ToJson
+ * @param result
+ * @return
+ */
+static QJsonObject ToJson(const StageResult& result)
+{
+    QJsonArray seconds;
+    for (int i = 0; i < result.seconds.size(); i++) {
+        seconds.append(result.seconds[i]);
+    }
+
+    QJsonObject stage;
+    stage["name"] = result.name;
+    stage["repetitions"] = result.seconds.size();
+    stage["seconds"] = seconds;
+    stage["min_seconds"] = result.seconds.first();
+    stage["median_seconds"] = result.Median();
+    stage["mean_seconds"] = result.Mean();
+    if (result.bytes > 0) {
+        stage["bytes"] = (double) result.bytes;
+        stage["gb_per_second"] = result.bytes / result.Median() / 1e9;
+    }
+    if (!result.itemName.isEmpty()) {
+        stage["items"] = (double) result.items;
+        stage["item_name"] = result.itemName;
+        stage["items_per_second"] = result.items / result.Median();
+    }
+    return stage;
+}
+
+/**
+ * @brief MatchesReference
+ * Compares a kernel output with the reference output and checks that the
+ * guard bytes after it were not written.
+ * @param rgba
+ * @param reference
+ * @param bytes
+ * @return
+ */
+static bool MatchesReference(const GLubyte* rgba, const GLubyte* reference,
+                             qint64 bytes)
+{
+    if (memcmp(rgba, reference, bytes) != 0)
+        return false;
+
+    for (int i = 0; i < VERIFICATION_GUARD_BYTES; i++) {
+        if (rgba[bytes + i] != VERIFICATION_GUARD_VALUE)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief VerifyClassifier
+ * Checks the selected kernel of _classifier_ bit for bit against the
+ * voxel-by-voxel reference, for the lookup alone over all 256 values at
+ * every alignment and tail length, and for the outline rows over volumes
+ * of odd and tiny sizes classified in uneven row ranges.
+ * @param classifier
+ * @return False at the first mismatch.
+ */
+static bool VerifyClassifier(const VolumeClassifier& classifier)
+{
+    const int maxVoxels = 256 + VERIFICATION_MAX_LENGTH * 13 * 12;
+    QVector<GLubyte> raw(maxVoxels + 16);
+    QVector<GLubyte> rgba(4 * maxVoxels + VERIFICATION_GUARD_BYTES);
+    QVector<GLubyte> reference(4 * maxVoxels);
+
+    // Every value, in an order that puts unrelated values side by side
+    for (int i = 0; i < raw.size(); i++) {
+        raw[i] = (GLubyte) (i * 167 + 13);
+    }
+
+    // The lookup alone, from every offset into a 16-byte block so that the
+    // vector loads run unaligned, and for every tail length
+    for (int offset = 0; offset < 16; offset++) {
+        for (int count = 0; count <= 256 + VERIFICATION_MAX_LENGTH; count++) {
+            rgba.fill(VERIFICATION_GUARD_VALUE);
+            classifier.Classify(raw.constData() + offset, rgba.data(), count);
+            classifier.ClassifyReference(raw.constData() + offset,
+                                         reference.data(), count);
+            if (!MatchesReference(rgba.constData(), reference.constData(),
+                                  4 * count)) {
+                std::cerr << "Lookup mismatch at offset " << offset
+                          << ", " << count << " voxels" << std::endl;
+                return false;
+            }
+        }
+    }
+
+    // The outline, including volumes thinner than the band, classified in
+    // row ranges that start and end anywhere in a slice
+    const int heights[] = {1, 5, 9, 13};
+    const int depths[] = {1, 9, 12};
+    for (int width = 1; width <= VERIFICATION_MAX_LENGTH; width++)
+    for (int h = 0; h < 4; h++)
+    for (int d = 0; d < 3; d++) {
+        const int height = heights[h];
+        const int depth = depths[d];
+        const qint64 rowCount = (qint64) height * depth;
+        const qint64 voxelCount = rowCount * width;
+
+        rgba.fill(VERIFICATION_GUARD_VALUE);
+        qint64 firstRow = 0;
+        for (int range = 1; firstRow < rowCount; range = range % 7 + 1) {
+            const qint64 lastRow = qMin(rowCount, firstRow + range);
+            classifier.ClassifyRows(raw.constData() + width, rgba.data(),
+                                    width, height, depth, firstRow, lastRow);
+            firstRow = lastRow;
+        }
+        classifier.ClassifyReference(raw.constData() + width,
+                                     reference.data(), width, height, depth);
+        if (!MatchesReference(rgba.constData(), reference.constData(),
+                              4 * voxelCount)) {
+            std::cerr << "Outline mismatch on a " << width << "x" << height
+                      << "x" << depth << " volume" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+            "Benchmarks the CPU stages of the volume load path on a "
+            "procedural phantom or an existing volume.");
+    parser.addHelpOption();
+
+    QCommandLineOption inputOption("input",
+            "Benchmark an existing <prefix>.hdr/.img pair instead of a "
+            "phantom.",
+            "prefix");
+    parser.addOption(inputOption);
+
+    QCommandLineOption phantomOption("phantom",
+            "Phantom to generate, <spheres>, <noise> or <shells>.",
+            "phantom", "shells");
+    parser.addOption(phantomOption);
+
+    QCommandLineOption sizeOption("size",
+            "Phantom size in voxels.",
+            "WxHxD", "256x256x256");
+    parser.addOption(sizeOption);
+
+    QCommandLineOption seedOption("seed",
+            "Phantom seed.",
+            "seed", "1");
+    parser.addOption(seedOption);
+
+    QCommandLineOption prefixOption("prefix",
+            "Where the phantom is written.",
+            "prefix", QDir::temp().filePath("volume-slicer-phantom"));
+    parser.addOption(prefixOption);
+
+    QCommandLineOption keepOption("keep",
+            "Keep the phantom files instead of deleting them at the end.");
+    parser.addOption(keepOption);
+
+    QCommandLineOption generateOnlyOption("generate-only",
+            "Write the phantom and exit, implies --keep.");
+    parser.addOption(generateOnlyOption);
+
+    QCommandLineOption warmUpOption("warm-up",
+            "Untimed runs of each stage.",
+            "count", "2");
+    parser.addOption(warmUpOption);
+
+    QCommandLineOption repetitionsOption("repetitions",
+            "Timed runs of each stage.",
+            "count", "5");
+    parser.addOption(repetitionsOption);
+
+    QCommandLineOption threadsOption("threads",
+            "Number of threads, 0 for one per core.",
+            "count", "0");
+    parser.addOption(threadsOption);
+
+    QCommandLineOption kernelOption("kernel",
+            "Classification kernel, <auto>, <scalar>, <sse2>, <avx2> or <neon>.",
+            "kernel", "auto");
+    parser.addOption(kernelOption);
+
+    QCommandLineOption outputOption("output",
+            "JSON results file.",
+            "file", "benchmark.json");
+    parser.addOption(outputOption);
+    parser.process(application);
+
+    const int warmUp = qMax(0, parser.value(warmUpOption).toInt());
+    const int repetitions = qMax(1, parser.value(repetitionsOption).toInt());
+
+    ThreadPool threadPool(parser.value(threadsOption).toInt());
+
+    VolumeClassifier classifier;
+    const QString kernel = parser.value(kernelOption);
+    if (kernel == "scalar") {
+        classifier.SetKernel(VolumeClassifier::KERNEL_SCALAR);
+    } else if (kernel == "sse2") {
+        classifier.SetKernel(VolumeClassifier::KERNEL_SSE2);
+    } else if (kernel == "avx2") {
+        classifier.SetKernel(VolumeClassifier::KERNEL_AVX2);
+    } else if (kernel == "neon") {
+        classifier.SetKernel(VolumeClassifier::KERNEL_NEON);
+    }
+
+    QJsonObject results;
+    QJsonArray stages;
+
+    // Check every kernel the CPU runs against the reference first, the
+    // timings of a wrong kernel are meaningless
+    const VolumeClassifier::Kernel kernels[] = {
+        VolumeClassifier::KERNEL_SCALAR,
+        VolumeClassifier::KERNEL_SSE2,
+        VolumeClassifier::KERNEL_AVX2,
+        VolumeClassifier::KERNEL_NEON
+    };
+    const int thresholds[] = {0, VolumeClassifier::DEFAULT_THRESHOLD, 255};
+    QJsonObject verification;
+    bool verified = true;
+    for (int k = 0; k < 4; k++) {
+        VolumeClassifier checked;
+        checked.SetKernel(kernels[k]);
+        if (checked.GetKernel() != kernels[k])
+            continue;
+
+        bool passed = true;
+        for (int t = 0; t < 3 && passed; t++) {
+            checked.SetThreshold(thresholds[t]);
+            passed = VerifyClassifier(checked);
+        }
+        std::cout << "verify-" << checked.GetKernelName() << " "
+                  << (passed ? "passed" : "FAILED") << std::endl;
+        verification[checked.GetKernelName()] = passed;
+        verified = verified && passed;
+    }
+    results["verification"] = verification;
+    if (!verified) {
+        std::cerr << "A classification kernel does not match the reference"
+                  << std::endl;
+        return 1;
+    }
+
+    // Generate the phantom, unless a volume was given
+    const bool generate = !parser.isSet(inputOption);
+    const QByteArray prefix = generate ?
+                parser.value(prefixOption).toLocal8Bit() :
+                parser.value(inputOption).toLocal8Bit();
+    const QByteArray hdrPath = prefix + ".hdr";
+    const QByteArray imgPath = prefix + ".img";
+
+    int width = 0;
+    int height = 0;
+    int depth = 0;
+    if (generate) {
+        const QStringList size = parser.value(sizeOption).split('x');
+        width = size.value(0).toInt();
+        height = size.value(1).toInt();
+        depth = size.value(2).toInt();
+        if (width <= 0 || height <= 0 || depth <= 0)
+            parser.showHelp(1);
+
+        PhantomGenerator::Phantom phantom = PhantomGenerator::PHANTOM_SHELLS;
+        if (parser.value(phantomOption) == "spheres") {
+            phantom = PhantomGenerator::PHANTOM_SPHERES;
+        } else if (parser.value(phantomOption) == "noise") {
+            phantom = PhantomGenerator::PHANTOM_NOISE;
+        }
+        const PhantomGenerator generator(phantom,
+                                         parser.value(seedOption).toUInt());
+
+        QElapsedTimer timer;
+        timer.start();
+        if (!generator.Write(prefix.constData(), width, height, depth,
+                             &threadPool)) {
+            std::cerr << "Could not write " << imgPath.constData() << std::endl;
+            return 1;
+        }
+        const double seconds = timer.nsecsElapsed() / 1e9;
+        const qint64 bytes = (qint64) width * height * depth;
+        std::cout << "Generated the " << PhantomGenerator::GetPhantomName(phantom)
+                  << " phantom, " << bytes / 1e9 << " GB in " << seconds
+                  << " s, " << bytes / seconds / 1e9 << " GB/s" << std::endl;
+
+        results["phantom"] = PhantomGenerator::GetPhantomName(phantom);
+        results["generation_seconds"] = seconds;
+
+        if (parser.isSet(generateOnlyOption))
+            return 0;
+    }
+
+    // ReadHeader
+    stages.append(ToJson(MeasureStage("read-header", 0, warmUp, repetitions,
+                                      [&] () -> qint64 {
+        VolumeFile::ReadHeader(hdrPath.constData(), &width, &height, &depth);
+        return 0;
+    })));
+    if (width <= 0 || height <= 0 || depth <= 0) {
+        std::cerr << "Could not read " << hdrPath.constData() << std::endl;
+        return 1;
+    }
+    const qint64 voxelCount = (qint64) width * height * depth;
+
+    // File read, streamed into the heap and mapped then paged in. Both run
+    // from the page cache once warm.
+    stages.append(ToJson(MeasureStage("read-streamed", voxelCount, warmUp,
+                                      repetitions, [&] () -> qint64 {
+        VolumeFile volumeFile;
+        volumeFile.Open(imgPath.constData(), voxelCount,
+                        VolumeFile::LOAD_MODE_STREAMED);
+        volumeFile.Close();
+        return 0;
+    })));
+
+    stages.append(ToJson(MeasureStage("read-mapped", voxelCount, warmUp,
+                                      repetitions, [&] () -> qint64 {
+        VolumeFile volumeFile;
+        volumeFile.Open(imgPath.constData(), voxelCount,
+                        VolumeFile::LOAD_MODE_MAPPED);
+
+        // Touch every page, as the first pass over the volume would
+        const GLubyte* data = volumeFile.GetData();
+        volatile GLubyte sum = 0;
+        for (qint64 i = 0; data && i < voxelCount; i += 4096) {
+            sum += data[i];
+        }
+        volumeFile.Close();
+        return 0;
+    })));
+
+    // The remaining stages work on the volume in memory
+    VolumeFile volumeFile;
+    if (!volumeFile.Open(imgPath.constData(), voxelCount,
+                         VolumeFile::LOAD_MODE_STREAMED)) {
+        std::cerr << "Could not read " << imgPath.constData() << std::endl;
+        return 1;
+    }
+    const GLubyte* rawVolume = volumeFile.GetData();
+
+    MinMaxGrid minMaxGrid;
+    stages.append(ToJson(MeasureStage("min-max-grid", voxelCount, warmUp,
+                                      repetitions, [&] () -> qint64 {
+        minMaxGrid.Build(&volumeFile, width, height, depth,
+                         EMPTY_SPACE_CELL_SIZE, 1, &threadPool);
+        return 0;
+    })));
+    minMaxGrid.Classify(classifier.GetLookupTable());
+
+    // The lookup alone, then the lookup with the bounding-box outline as
+    // the slicer runs it. The difference is the cost of the outline.
+    GLubyte* rgbaVolume = new GLubyte [voxelCount * 4];
+    const qint64 rowCount = (qint64) height * depth;
+    const qint64 slabRows = qMax((qint64) 1,
+            CLASSIFICATION_SLAB_BYTES / (5 * (qint64) width));
+
+    stages.append(ToJson(MeasureStage("classify", voxelCount, warmUp,
+                                      repetitions, [&] () -> qint64 {
+        threadPool.ParallelFor(0, rowCount, slabRows,
+                               [&] (qint64 firstRow, qint64 lastRow) {
+            classifier.Classify(rawVolume + firstRow * width,
+                                rgbaVolume + firstRow * width * 4,
+                                (lastRow - firstRow) * width);
+        });
+        return voxelCount;
+    }, "voxels")));
+
+    stages.append(ToJson(MeasureStage("classify-outline", voxelCount, warmUp,
+                                      repetitions, [&] () -> qint64 {
+        threadPool.ParallelFor(0, rowCount, slabRows,
+                               [&] (qint64 firstRow, qint64 lastRow) {
+            classifier.ClassifyRows(rawVolume, rgbaVolume,
+                                    width, height, depth, firstRow, lastRow);
+        });
+        return voxelCount;
+    }, "voxels")));
+    delete [] rgbaVolume;
+
+    // The level-of-detail chain with both filters
+    VolumePyramid pyramid;
+    for (int gaussian = 0; gaussian < 2; gaussian++) {
+        const QString name = gaussian ? "mip-pyramid-gaussian" :
+                                        "mip-pyramid-box";
+        stages.append(ToJson(MeasureStage(name, voxelCount, warmUp,
+                                          repetitions, [&] () -> qint64 {
+            pyramid.Build(rawVolume, width, height, depth,
+                          gaussian ? VolumePyramid::FILTER_GAUSSIAN :
+                                     VolumePyramid::FILTER_BOX,
+                          &threadPool);
+            return voxelCount;
+        }, "voxels")));
+    }
+    const int mipLevels = pyramid.GetLevelCount();
+    pyramid.Clear();
+
+    // Slice polygons for a sweep of views, for the whole volume and for
+    // every cell of the empty-space grid
+    SliceGeometry sliceGeometry;
+    const float diagonalSizeSquared =
+            (float) width * width + (float) height * height +
+            (float) depth * depth;
+    const int halfSlices = 1.3 * sqrt(diagonalSizeSquared) / 4.0;
+    sliceGeometry.SetSlices(halfSlices, sqrt(3.0) / (2 * halfSlices + 1));
+
+    const QVector3D volumeSize(width, height, depth);
+    const int cells[3] = {(width + EMPTY_SPACE_CELL_SIZE - 1) /
+                          EMPTY_SPACE_CELL_SIZE,
+                          (height + EMPTY_SPACE_CELL_SIZE - 1) /
+                          EMPTY_SPACE_CELL_SIZE,
+                          (depth + EMPTY_SPACE_CELL_SIZE - 1) /
+                          EMPTY_SPACE_CELL_SIZE};
+
+    for (int cellBoxes = 0; cellBoxes < 2; cellBoxes++) {
+        const QString name = cellBoxes ? "slice-geometry-cells" :
+                                         "slice-geometry";
+        stages.append(ToJson(MeasureStage(name, 0, warmUp, repetitions, [&] () -> qint64 {
+            qint64 vertexCount = 0;
+            for (int view = 0; view < GEOMETRY_ROTATIONS; view++) {
+                QMatrix4x4 rotation;
+                rotation.rotate(360.f * view / GEOMETRY_ROTATIONS, 1.f, 1.f, 0.f);
+                sliceGeometry.SetRotation(rotation);
+                sliceGeometry.Clear();
+
+                int first;
+                int count;
+                if (!cellBoxes) {
+                    sliceGeometry.AddBox(QVector3D(0.f, 0.f, 0.f),
+                                         QVector3D(1.f, 1.f, 1.f),
+                                         &first, &count);
+                } else {
+                    for (int k = 0; k < cells[2]; k++)
+                    for (int j = 0; j < cells[1]; j++)
+                    for (int i = 0; i < cells[0]; i++) {
+                        const QVector3D cellMin =
+                                QVector3D(i, j, k) * EMPTY_SPACE_CELL_SIZE;
+                        const QVector3D cellMax =
+                                QVector3D(i + 1, j + 1, k + 1) *
+                                EMPTY_SPACE_CELL_SIZE;
+                        sliceGeometry.AddBox(cellMin / volumeSize,
+                                             cellMax / volumeSize,
+                                             &first, &count);
+                    }
+                }
+                vertexCount += sliceGeometry.GetVertexCount();
+            }
+            return vertexCount;
+        }, "vertices")));
+    }
+    volumeFile.Close();
+
+    // Machine-readable results
+    results["width"] = width;
+    results["height"] = height;
+    results["depth"] = depth;
+    results["mip_levels"] = mipLevels;
+    results["empty_fraction"] = minMaxGrid.GetEmptyFraction();
+    results["threads"] = threadPool.GetThreadCount();
+    results["kernel"] = classifier.GetKernelName();
+    results["warm_up"] = warmUp;
+    results["cpu_architecture"] = QSysInfo::currentCpuArchitecture();
+    results["os"] = QSysInfo::prettyProductName();
+    results["date"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    results["stages"] = stages;
+
+    QFile outputFile(parser.value(outputOption));
+    if (!outputFile.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+            outputFile.write(QJsonDocument(results).toJson()) < 0) {
+        std::cerr << "Could not write " << qPrintable(outputFile.fileName())
+                  << std::endl;
+        return 1;
+    }
+
+    if (generate && !parser.isSet(keepOption)) {
+        QFile::remove(hdrPath);
+        QFile::remove(imgPath);
+    }
+    return 0;
+}
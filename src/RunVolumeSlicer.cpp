@@ -19,12 +19,366 @@
 
 #include <QApplication>
 #include <QSurfaceFormat>
+#include <QCommandLineParser>
 #include <QMessageBox>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QFile>
+#include <QTextStream>
 #include <iostream>
+#include <atomic>
 #include "VolumeSlicer.h"
+#include "FrameReadback.h"
+#include "Trace.h"
+#include "CameraPath.h"
+#include "FrameStatistics.h"
+
+/**
+ * @brief RenderBatch
+ * Renders every view on an offscreen surface and writes one image each.
+ * @param slicer
+ * @param views Camera of each image, "x,y,z[,scale]" in degrees.
+ * @param size
+ * @param samples
+ * @param outputPattern File name, %1 is replaced by the view number.
+ * @return Exit code of the application.
+ */
+static int RenderBatch(VolumeSlicer* slicer, QStringList views,
+                       const QSize& size, int samples,
+                       const QString& outputPattern)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // The volume is loaded once for all the views
+    if (!slicer->CreateOffscreenContext(size, samples)) {
+        std::cerr << "Could not create an offscreen OpenGL context" << std::endl;
+        return 1;
+    }
+    if (slicer->LoadFailed()) {
+        std::cerr << "Could not load the volume" << std::endl;
+        return 1;
+    }
+    std::cout << "Volume loaded in " << timer.restart() << " ms" << std::endl;
+
+    if (views.isEmpty())
+        views << "0,0,0";
+
+    for (int i = 0; i < views.size(); i++) {
+        const QStringList camera = views[i].split(',');
+        if (camera.size() < 3) {
+            std::cerr << "Invalid view " << views[i].toStdString()
+                      << ", expected x,y,z[,scale]" << std::endl;
+            return 1;
+        }
+        slicer->SetCamera(camera[0].toFloat(), camera[1].toFloat(),
+                          camera[2].toFloat(),
+                          camera.size() > 3 ? camera[3].toFloat() : 1.f);
+
+        const QString fileName = outputPattern.arg(i, 4, 10, QChar('0'));
+        if (!slicer->RenderOffscreen().save(fileName)) {
+            std::cerr << "Could not write " << fileName.toStdString()
+                      << std::endl;
+            return 1;
+        }
+    }
+    std::cout << views.size() << " views rendered in " << timer.elapsed()
+              << " ms" << std::endl;
+    return 0;
+}
+
+/**
+ * @brief RenderSweep
+ * Renders a turntable of _frameCount_ views about the Y axis. The frames
+ * are read back through a ring of pixel buffers while the next ones are
+ * rendered, and encoded to image files on a pool of workers.
+ * @param slicer
+ * @param view Starting camera, "x,y,z[,scale]" in degrees.
+ * @param frameCount
+ * @param size
+ * @param samples
+ * @param ringSize Number of frames in flight between render and readback.
+ * @param outputPattern File name, %1 is replaced by the frame number.
+ * @return Exit code of the application.
+ */
+static int RenderSweep(VolumeSlicer* slicer, const QString& view,
+                       int frameCount, const QSize& size, int samples,
+                       int ringSize, const QString& outputPattern)
+{
+    const QStringList camera = view.split(',');
+    if (camera.size() < 3) {
+        std::cerr << "Invalid view " << view.toStdString()
+                  << ", expected x,y,z[,scale]" << std::endl;
+        return 1;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    if (!slicer->CreateOffscreenContext(size, samples)) {
+        std::cerr << "Could not create an offscreen OpenGL context" << std::endl;
+        return 1;
+    }
+    if (slicer->LoadFailed()) {
+        std::cerr << "Could not load the volume" << std::endl;
+        return 1;
+    }
+    std::cout << "Volume loaded in " << timer.restart() << " ms" << std::endl;
+
+    FrameReadback readback;
+    readback.Initialize(size, ringSize);
+
+    // Encoding is the slowest stage, it gets every core
+    ThreadPool encoders;
+    const int maxQueuedFrames = 2 * encoders.GetThreadCount();
+    std::atomic<int> queuedFrames(0);
+    std::atomic<qint64> encodeTime(0);
+    std::atomic<int> failedFrames(0);
+
+    qint64 renderTime = 0;
+    qint64 readbackTime = 0;
+    QElapsedTimer stageTimer;
+
+    int takenFrames = 0;
+    for (int frame = 0; frame < frameCount || !readback.IsEmpty(); ) {
+        // Collect the oldest frame once the ring is full, or at the end
+        if (readback.IsFull() || frame == frameCount) {
+            stageTimer.start();
+            QImage* image = new QImage(readback.Take());
+            readbackTime += stageTimer.nsecsElapsed();
+
+            // Bound the memory held by frames waiting for an encoder
+            if (queuedFrames >= maxQueuedFrames)
+                encoders.Wait();
+
+            const QString fileName =
+                    outputPattern.arg(takenFrames++, 4, 10, QChar('0'));
+            queuedFrames++;
+            encoders.Enqueue([=, &queuedFrames, &encodeTime, &failedFrames] {
+                QElapsedTimer encodeTimer;
+                encodeTimer.start();
+                if (!image->mirrored().save(fileName))
+                    failedFrames++;
+                delete image;
+                encodeTime += encodeTimer.nsecsElapsed();
+                queuedFrames--;
+            });
+            continue;
+        }
+
+        const float angle = 360.f * frame / frameCount;
+        slicer->SetCamera(camera[0].toFloat(), camera[1].toFloat() + angle,
+                          camera[2].toFloat(),
+                          camera.size() > 3 ? camera[3].toFloat() : 1.f);
+
+        stageTimer.start();
+        slicer->RenderOffscreenFrame();
+        readback.Read();
+        renderTime += stageTimer.nsecsElapsed();
+        frame++;
+    }
+    encoders.Wait();
+    readback.Release();
+
+    const qint64 elapsed = qMax(timer.elapsed(), (qint64) 1);
+    std::cout << frameCount << " frames in " << elapsed << " ms, "
+              << 1000.0 * frameCount / elapsed << " frames/s" << std::endl
+              << "  render   " << renderTime / 1e6 / frameCount
+              << " ms/frame" << std::endl
+              << "  readback " << readbackTime / 1e6 / frameCount
+              << " ms/frame" << std::endl
+              << "  encode   " << encodeTime / 1e6 / frameCount
+              << " ms/frame on " << encoders.GetThreadCount() << " threads"
+              << std::endl;
+
+    if (failedFrames > 0) {
+        std::cerr << "Could not write " << failedFrames << " frames"
+                  << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief ReplayCameraPath
+ * Renders the frames of a recorded camera path offscreen, one after the
+ * other and each to completion, and compares the frame times with those
+ * of a baseline run.
+ * @param slicer
+ * @param pathFile
+ * @param size
+ * @param samples
+ * @param frameTimesFile CSV of every frame time, none if empty.
+ * @param summaryFile JSON statistics of the frame times, none if empty.
+ * @param baselineFile JSON statistics of a baseline run, none if empty.
+ * @param tolerance Allowed slowdown over the baseline, 0.1 for 10%.
+ * @return Exit code of the application, 2 on a regression.
+ */
+static int ReplayCameraPath(VolumeSlicer* slicer, const QString& pathFile,
+                            const QSize& size, int samples,
+                            const QString& frameTimesFile,
+                            const QString& summaryFile,
+                            const QString& baselineFile, double tolerance)
+{
+    CameraPath cameraPath;
+    if (!cameraPath.Load(pathFile) || cameraPath.GetKeyframes().isEmpty()) {
+        std::cerr << "Could not read the camera path "
+                  << pathFile.toStdString() << std::endl;
+        return 1;
+    }
+    const QVector<CameraPath::Keyframe>& keyframes = cameraPath.GetKeyframes();
+
+    if (!slicer->CreateOffscreenContext(size, samples)) {
+        std::cerr << "Could not create an offscreen OpenGL context" << std::endl;
+        return 1;
+    }
+    if (slicer->LoadFailed()) {
+        std::cerr << "Could not load the volume" << std::endl;
+        return 1;
+    }
+
+    // Shader compilation and first uploads are not part of the run
+    slicer->SetCameraState(keyframes.first().camera);
+    slicer->RenderOffscreenFrame();
+    slicer->FinishOffscreenFrame();
+
+    FrameStatistics statistics(keyframes.size());
+    QVector<double> frameTimes;
+    QElapsedTimer timer;
+    for (int i = 0; i < keyframes.size(); i++) {
+        slicer->SetCameraState(keyframes[i].camera);
+
+        timer.start();
+        slicer->RenderOffscreenFrame();
+        slicer->FinishOffscreenFrame();
+        frameTimes.append(timer.nsecsElapsed() / 1e6);
+        statistics.Add(FrameStatistics::SERIES_RENDER, frameTimes.last());
+    }
+
+    if (!frameTimesFile.isEmpty()) {
+        QFile file(frameTimesFile);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate |
+                       QIODevice::Text)) {
+            std::cerr << "Could not write " << frameTimesFile.toStdString()
+                      << std::endl;
+            return 1;
+        }
+        QTextStream stream(&file);
+        stream << "frame,path_time_ms,frame_ms\n";
+        for (int i = 0; i < frameTimes.size(); i++) {
+            stream << i << ',' << keyframes[i].time << ','
+                   << frameTimes[i] << '\n';
+        }
+    }
+
+    const FrameStatistics::Summary summary =
+            statistics.Summarize(FrameStatistics::SERIES_RENDER);
+    QJsonObject summaryObject;
+    summaryObject["frames"] = summary.count;
+    summaryObject["width"] = size.width();
+    summaryObject["height"] = size.height();
+    summaryObject["min_ms"] = summary.minimum;
+    summaryObject["average_ms"] = summary.average;
+    summaryObject["p95_ms"] = summary.percentile95;
+    summaryObject["p99_ms"] = summary.percentile99;
+
+    std::cout << summary.count << " frames, min " << summary.minimum
+              << " ms, average " << summary.average << " ms, p95 "
+              << summary.percentile95 << " ms, p99 " << summary.percentile99
+              << " ms" << std::endl;
+
+    if (!summaryFile.isEmpty()) {
+        QFile file(summaryFile);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+                file.write(QJsonDocument(summaryObject).toJson()) < 0) {
+            std::cerr << "Could not write " << summaryFile.toStdString()
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    if (baselineFile.isEmpty())
+        return 0;
+
+    QFile file(baselineFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::cerr << "Could not read " << baselineFile.toStdString()
+                  << std::endl;
+        return 1;
+    }
+    const QJsonObject baseline = QJsonDocument::fromJson(file.readAll()).object();
+
+    // Only slowdowns fail, a faster run is worth a new baseline
+    bool regressed = false;
+    const char* keys[] = {"average_ms", "p95_ms", "p99_ms"};
+    for (int i = 0; i < 3; i++) {
+        const double reference = baseline.value(keys[i]).toDouble();
+        const double current = summaryObject.value(keys[i]).toDouble();
+        if (reference <= 0.0)
+            continue;
+
+        const double change = current / reference - 1.0;
+        const bool failed = change > tolerance;
+        regressed = regressed || failed;
+        std::cout << keys[i] << " " << current << " vs " << reference
+                  << " (" << (change >= 0.0 ? "+" : "") << 100.0 * change
+                  << "%) " << (failed ? "REGRESSION" : "ok") << std::endl;
+    }
+    return regressed ? 2 : 0;
+}
+
+/**
+ * @brief PrintFrameReport
+ * Prints the timings of the last window frames, and the histogram of the
+ * input latencies next to them.
+ * @param statistics
+ */
+static void PrintFrameReport(const FrameStatistics& statistics)
+{
+    for (int i = 0; i < FrameStatistics::SERIES_COUNT; i++) {
+        const FrameStatistics::Series series = (FrameStatistics::Series) i;
+        const FrameStatistics::Summary summary = statistics.Summarize(series);
+        if (summary.count == 0)
+            continue;
+
+        std::cout << FrameStatistics::GetSeriesName(series) << ": "
+                  << summary.count << " samples, min " << summary.minimum
+                  << " ms, average " << summary.average << " ms, p95 "
+                  << summary.percentile95 << " ms, p99 "
+                  << summary.percentile99 << " ms" << std::endl;
+    }
+
+    const float bucket = 5.f;
+    const QVector<int> histogram = statistics.GetHistogram(
+                FrameStatistics::SERIES_INPUT_LATENCY, bucket, 20);
+    for (int i = 0; i < histogram.size(); i++) {
+        if (histogram[i] == 0)
+            continue;
+
+        if (i + 1 < histogram.size()) {
+            std::cout << "  " << i * bucket << "-" << (i + 1) * bucket;
+        } else {
+            std::cout << "  " << i * bucket << "+";
+        }
+        std::cout << " ms: " << histogram[i] << std::endl;
+    }
+}
+
+/**
+ * @brief WriteTrace
+ * Writes the recorded spans, if tracing is enabled.
+ */
+static void WriteTrace()
+{
+    if (!Trace::Write())
+        std::cerr << "Could not write the trace" << std::endl;
+}
 
 int main(int argc, char *argv[])
 {
+    // Trace from the very start if the environment asks for it
+    Trace::EnableFromEnvironment();
+    Trace::SetThreadName("main");
 
     // Make sure that a compatible volume
     if (argc < 2) {
@@ -40,12 +394,357 @@ int main(int argc, char *argv[])
     // If the volume was provided, then create a _VolumeSlicer_ application
     QGuiApplication uiApplication(argc, argv);
 
-    VolumeSlicer* slicer = new VolumeSlicer(0, argv[1]);
+    // Parse the command line options
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addPositionalArgument("prefix", "Volume prefix of the .hdr/.img pair");
+
+    QCommandLineOption loadModeOption("load-mode",
+            "How the .img file is loaded, <mmap> or <stream>.",
+            "mode", "mmap");
+    parser.addOption(loadModeOption);
+
+    QCommandLineOption kernelOption("kernel",
+            "Classification kernel, <auto>, <scalar>, <sse2>, <avx2> or <neon>.",
+            "kernel", "auto");
+    parser.addOption(kernelOption);
+
+    QCommandLineOption threadsOption("threads",
+            "Number of loader threads, 0 for one per core.",
+            "count", "0");
+    parser.addOption(threadsOption);
+
+    QCommandLineOption textureOption("texture",
+            "Volume texture format, <rgba> or <scalar>.",
+            "format", "rgba");
+    parser.addOption(textureOption);
+
+    QCommandLineOption bricksOption("bricks",
+            "Split the volume into bricks, <auto>, <on> or <off>.",
+            "mode", "auto");
+    parser.addOption(bricksOption);
+
+    QCommandLineOption brickSizeOption("brick-size",
+            "Edge of a brick in voxels.",
+            "voxels", "128");
+    parser.addOption(brickSizeOption);
+
+    QCommandLineOption brickMemoryOption("brick-memory",
+            "Texture memory for the resident bricks in MiB.",
+            "MiB", "1024");
+    parser.addOption(brickMemoryOption);
+
+    QCommandLineOption mipFilterOption("mip-filter",
+            "Level-of-detail pyramid filter, <box>, <gaussian> or <none>.",
+            "filter", "box");
+    parser.addOption(mipFilterOption);
+
+    QCommandLineOption mipMemoryOption("mip-memory",
+            "Texture memory for the volume and its levels in MiB, the "
+            "finest levels are dropped to fit. 0 for no limit.",
+            "MiB", "0");
+    parser.addOption(mipMemoryOption);
+
+    QCommandLineOption interactionScaleOption("interaction-scale",
+            "Resolution scale while dragging, 1 to disable.",
+            "scale", "0.5");
+    parser.addOption(interactionScaleOption);
+
+    QCommandLineOption settleDelayOption("settle-delay",
+            "Delay before the full quality frame after dragging.",
+            "ms", "150");
+    parser.addOption(settleDelayOption);
+
+    QCommandLineOption rendererOption("renderer",
+            "Pipeline, <legacy>, <core> for OpenGL 3.3 core profile or "
+            "<software> for CPU ray casting.",
+            "renderer", "legacy");
+    parser.addOption(rendererOption);
+
+    QCommandLineOption modeOption("mode",
+            "Rendering technique, <slice>, <raycast> or <shearwarp>, which "
+            "implies the software renderer. R toggles it.",
+            "mode", "slice");
+    parser.addOption(modeOption);
+
+    QCommandLineOption samplingStepOption("sampling-step",
+            "Distance between two ray-casting samples in voxels.",
+            "voxels", "1.0");
+    parser.addOption(samplingStepOption);
+
+    QCommandLineOption targetFpsOption("target-fps",
+            "Adapt the number of slices to the zoom and to the measured "
+            "frame times to hold this frame rate, 0 for a fixed number.",
+            "fps", "0");
+    parser.addOption(targetFpsOption);
+
+    QCommandLineOption refineFramesOption("refine-frames",
+            "Frames averaged to refine the window once the view stops "
+            "changing, 0 to disable. Offscreen frames are never refined.",
+            "frames", "32");
+    parser.addOption(refineFramesOption);
+
+    QCommandLineOption offscreenOption("offscreen",
+            "Render the views to image files without a window and exit. "
+            "Hosts without a display need QT_QPA_PLATFORM=offscreen or eglfs.");
+    parser.addOption(offscreenOption);
+
+    QCommandLineOption viewOption("view",
+            "Offscreen camera, rotations about X, Y and Z in degrees and an "
+            "optional zoom. Repeat the option for several images.",
+            "x,y,z[,scale]");
+    parser.addOption(viewOption);
+
+    QCommandLineOption sizeOption("size",
+            "Offscreen image size.",
+            "WxH", "800x600");
+    parser.addOption(sizeOption);
+
+    QCommandLineOption samplesOption("samples",
+            "Offscreen multisampling, 0 to disable.",
+            "count", "16");
+    parser.addOption(samplesOption);
+
+    QCommandLineOption outputOption("output",
+            "Offscreen image files, %1 is replaced by the view number and "
+            "the extension selects the format.",
+            "pattern", "view-%1.png");
+    parser.addOption(outputOption);
+
+    QCommandLineOption sweepOption("sweep",
+            "Offscreen turntable of the given number of frames about the Y "
+            "axis, starting at the first --view.",
+            "frames", "0");
+    parser.addOption(sweepOption);
+
+    QCommandLineOption readbackBuffersOption("readback-buffers",
+            "Frames in flight between rendering and readback in a sweep.",
+            "count", "3");
+    parser.addOption(readbackBuffersOption);
+
+    QCommandLineOption traceOption("trace",
+            "Record the load and render spans to a Chrome trace-event JSON "
+            "file, as does the VOLUME_SLICER_TRACE environment variable.",
+            "file");
+    parser.addOption(traceOption);
+
+    QCommandLineOption recordPathOption("record-path",
+            "Record the camera of every frame to a file, written on exit.",
+            "file");
+    parser.addOption(recordPathOption);
+
+    QCommandLineOption replayPathOption("replay-path",
+            "Replay a recorded camera path offscreen, frame by frame, and "
+            "report the frame times. Uses --size and --samples.",
+            "file");
+    parser.addOption(replayPathOption);
+
+    QCommandLineOption frameTimesOption("frame-times",
+            "CSV of the replayed frame times.",
+            "file");
+    parser.addOption(frameTimesOption);
+
+    QCommandLineOption summaryOption("summary",
+            "JSON statistics of the replayed frame times.",
+            "file");
+    parser.addOption(summaryOption);
+
+    QCommandLineOption baselineOption("baseline",
+            "JSON statistics of a baseline replay. The replay fails with "
+            "exit code 2 if it is slower by more than the tolerance.",
+            "file");
+    parser.addOption(baselineOption);
+
+    QCommandLineOption toleranceOption("tolerance",
+            "Allowed slowdown over the baseline, as a fraction.",
+            "fraction", "0.1");
+    parser.addOption(toleranceOption);
+
+    QCommandLineOption continuousOption("continuous",
+            "Render frames back to back, not only when the view changes.");
+    parser.addOption(continuousOption);
+
+    QCommandLineOption renderThreadOption("render-thread",
+            "Render on a thread of its own, <on> or <off> for the UI "
+            "thread.",
+            "mode", "on");
+    parser.addOption(renderThreadOption);
+
+    QCommandLineOption swapIntervalOption("swap-interval",
+            "Refreshes per swap of the window, 0 to swap without waiting "
+            "for the vertical refresh.",
+            "count", "1");
+    parser.addOption(swapIntervalOption);
+
+    QCommandLineOption framePacingOption("frame-pacing",
+            "Start the frames <immediate>ly when requested, or as <late> "
+            "before the next refresh as the frame times allow, for the "
+            "lowest input latency.",
+            "mode", "immediate");
+    parser.addOption(framePacingOption);
+
+    QCommandLineOption pacingMarginOption("pacing-margin",
+            "Milliseconds kept before the refresh with late frame pacing.",
+            "milliseconds", "2");
+    parser.addOption(pacingMarginOption);
+
+    QCommandLineOption frameReportOption("frame-report",
+            "Print the frame times and the input-to-present latencies of "
+            "the last frames on exit.");
+    parser.addOption(frameReportOption);
+    parser.process(uiApplication);
+
+    if (parser.positionalArguments().isEmpty()) {
+        parser.showHelp(1);
+    }
+
+    if (parser.isSet(traceOption) && !Trace::IsEnabled()) {
+        Trace::Enable(parser.value(traceOption).toStdString());
+        Trace::SetThreadName("main");
+    }
+
+    // Keep the prefix alive for the whole session
+    QByteArray volumePrefix = parser.positionalArguments().first().toLocal8Bit();
+
+    VolumeSlicer* slicer = new VolumeSlicer(0, volumePrefix.data());
+
+    if (parser.value(loadModeOption) == "stream") {
+        slicer->SetLoadMode(VolumeFile::LOAD_MODE_STREAMED);
+    }
+
+    const QString kernel = parser.value(kernelOption);
+    if (kernel == "scalar") {
+        slicer->SetClassifierKernel(VolumeClassifier::KERNEL_SCALAR);
+    } else if (kernel == "sse2") {
+        slicer->SetClassifierKernel(VolumeClassifier::KERNEL_SSE2);
+    } else if (kernel == "avx2") {
+        slicer->SetClassifierKernel(VolumeClassifier::KERNEL_AVX2);
+    } else if (kernel == "neon") {
+        slicer->SetClassifierKernel(VolumeClassifier::KERNEL_NEON);
+    }
+
+    slicer->SetThreadCount(parser.value(threadsOption).toInt());
+
+    if (parser.value(textureOption) == "scalar") {
+        slicer->SetTextureMode(VolumeSlicer::TEXTURE_MODE_SCALAR);
+    }
+
+    VolumeSlicer::BrickingMode brickingMode = VolumeSlicer::BRICKING_MODE_AUTO;
+    if (parser.value(bricksOption) == "on") {
+        brickingMode = VolumeSlicer::BRICKING_MODE_ON;
+    } else if (parser.value(bricksOption) == "off") {
+        brickingMode = VolumeSlicer::BRICKING_MODE_OFF;
+    }
+    slicer->SetBricking(brickingMode,
+                        parser.value(brickSizeOption).toInt(),
+                        parser.value(brickMemoryOption).toLongLong() << 20);
+
+    VolumePyramid::Filter mipFilter = VolumePyramid::FILTER_BOX;
+    if (parser.value(mipFilterOption) == "gaussian") {
+        mipFilter = VolumePyramid::FILTER_GAUSSIAN;
+    } else if (parser.value(mipFilterOption) == "none") {
+        mipFilter = VolumePyramid::FILTER_NONE;
+    }
+    slicer->SetMipPyramid(mipFilter,
+                          parser.value(mipMemoryOption).toLongLong() << 20);
+
+    slicer->SetInteractionQuality(parser.value(interactionScaleOption).toFloat(),
+                                  parser.value(settleDelayOption).toInt());
+
+    QString renderer = parser.value(rendererOption);
+    if (parser.value(modeOption) == "raycast") {
+        slicer->SetRenderMode(VolumeSlicer::RENDER_MODE_RAY_CASTING);
+    } else if (parser.value(modeOption) == "shearwarp") {
+        slicer->SetRenderMode(VolumeSlicer::RENDER_MODE_SHEAR_WARP);
+        renderer = "software";
+    }
+    slicer->SetSamplingStep(parser.value(samplingStepOption).toFloat());
+    slicer->SetTargetFrameRate(parser.value(targetFpsOption).toFloat());
+
     QSurfaceFormat format;
-    format.setSamples(16);
+    if (renderer == "core") {
+        slicer->SetRenderer(VolumeSlicer::RENDERER_CORE);
+        format.setVersion(3, 3);
+        format.setProfile(QSurfaceFormat::CoreProfile);
+    } else if (renderer == "software") {
+        slicer->SetRenderer(VolumeSlicer::RENDERER_SOFTWARE);
+    } else {
+        format.setSamples(16);
+    }
+    format.setSwapInterval(parser.value(swapIntervalOption).toInt());
     slicer->setFormat(format);
+
+    // Batch rendering, no window and no event loop
+    if (parser.isSet(offscreenOption) || parser.isSet(replayPathOption)) {
+        const QStringList size = parser.value(sizeOption).split('x');
+        const QSize imageSize(size.value(0).toInt(), size.value(1).toInt());
+        if (imageSize.isEmpty()) {
+            parser.showHelp(1);
+        }
+
+        // Every image shows the full volume
+        slicer->SetAsyncLoading(false);
+
+        // Multisampling only helps the polygon edges of the GPU renderers
+        const int samples = (renderer == "software") ?
+                    0 : parser.value(samplesOption).toInt();
+
+        const int sweepFrames = parser.value(sweepOption).toInt();
+        int exitCode;
+        if (parser.isSet(replayPathOption)) {
+            exitCode = ReplayCameraPath(slicer,
+                                        parser.value(replayPathOption),
+                                        imageSize, samples,
+                                        parser.value(frameTimesOption),
+                                        parser.value(summaryOption),
+                                        parser.value(baselineOption),
+                                        parser.value(toleranceOption).toDouble());
+        } else if (sweepFrames > 0) {
+            const QStringList views = parser.values(viewOption);
+            exitCode = RenderSweep(slicer,
+                                   views.isEmpty() ? "0,0,0" : views.first(),
+                                   sweepFrames, imageSize, samples,
+                                   parser.value(readbackBuffersOption).toInt(),
+                                   parser.value(outputOption));
+        } else {
+            exitCode = RenderBatch(slicer, parser.values(viewOption),
+                                   imageSize, samples,
+                                   parser.value(outputOption));
+        }
+        delete slicer;
+        WriteTrace();
+        return exitCode;
+    }
+
+    // Set up before the render thread starts with the first expose
+    if (parser.value(renderThreadOption) == "off") {
+        slicer->SetRenderThread(false);
+    }
+    slicer->SetRefinement(parser.value(refineFramesOption).toInt());
+    slicer->SetFramePacing(parser.value(framePacingOption) == "late" ?
+                               OpenGLWindow::FRAME_PACING_LATE :
+                               OpenGLWindow::FRAME_PACING_IMMEDIATE,
+                           parser.value(pacingMarginOption).toFloat());
+    if (parser.isSet(recordPathOption)) {
+        slicer->StartCameraRecording();
+    }
+
     slicer->show();
-    slicer->ToogleAnimation(true);
+    if (parser.isSet(continuousOption)) {
+        slicer->ToogleAnimation(true);
+    }
 
-    return uiApplication.exec();
+    const int exitCode = uiApplication.exec();
+    WriteTrace();
+
+    // The render thread stopped with the event loop
+    if (parser.isSet(frameReportOption)) {
+        PrintFrameReport(slicer->GetFrameStatistics());
+    }
+
+    if (parser.isSet(recordPathOption) &&
+            !slicer->GetCameraPath().Save(parser.value(recordPathOption))) {
+        std::cerr << "Could not write the camera path" << std::endl;
+    }
+    return exitCode;
 }
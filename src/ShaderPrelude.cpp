@@ -0,0 +1,63 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "ShaderPrelude.h"
+
+/** \brief Maps the GLSL 1.20 names used by the shaders to GLSL 3.30 */
+static const char* CORE_VERTEX_PRELUDE =
+    "#version 330 core\n"
+    "#define attribute in\n"
+    "#define varying out\n";
+
+static const char* CORE_FRAGMENT_PRELUDE =
+    "#version 330 core\n"
+    "#define varying in\n"
+    "#define texture1D texture\n"
+    "#define texture2D texture\n"
+    "#define texture3D texture\n"
+    "out vec4 fragColor;\n"
+    "#define FRAG_COLOR fragColor\n";
+
+static const char* LEGACY_VERTEX_PRELUDE =
+    "#version 120\n";
+
+static const char* LEGACY_FRAGMENT_PRELUDE =
+    "#version 120\n"
+    "#define FRAG_COLOR gl_FragColor\n";
+
+/**
+ * @brief ShaderPrelude::Prefix
+ * @param type
+ * @param coreProfile
+ * @param source
+ * @return
+ */
+QByteArray ShaderPrelude::Prefix(QOpenGLShader::ShaderType type,
+                                 bool coreProfile, const QByteArray& source)
+{
+    QByteArray prefixed;
+    if (type == QOpenGLShader::Vertex) {
+        prefixed = coreProfile ? CORE_VERTEX_PRELUDE : LEGACY_VERTEX_PRELUDE;
+    } else {
+        prefixed = coreProfile ? CORE_FRAGMENT_PRELUDE
+                               : LEGACY_FRAGMENT_PRELUDE;
+    }
+    prefixed += source;
+    return prefixed;
+}
@@ -0,0 +1,47 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef SHADERPRELUDE_H
+#define SHADERPRELUDE_H
+
+#include <QByteArray>
+#include <QOpenGLShader>
+
+/**
+ * @brief The ShaderPrelude class
+ * The full-screen shaders are written in GLSL 1.20. The prelude puts the
+ * version line in front of them and, for an OpenGL 3.3 core profile, maps
+ * the 1.20 qualifiers, texture lookups and fragment output to GLSL 3.30.
+ */
+class ShaderPrelude
+{
+public:
+    /**
+     * @brief Prefix
+     * @param type Vertex or fragment shader.
+     * @param coreProfile
+     * @param source GLSL 1.20 source, writing FRAG_COLOR for the fragment
+     * output.
+     * @return The source to compile for the profile.
+     */
+    static QByteArray Prefix(QOpenGLShader::ShaderType type,
+                             bool coreProfile, const QByteArray& source);
+};
+
+#endif // SHADERPRELUDE_H
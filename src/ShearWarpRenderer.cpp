@@ -0,0 +1,507 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "ShearWarpRenderer.h"
+#include "Trace.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+/**
+ * @brief Lerp
+ * @param a
+ * @param b
+ * @param fraction
+ * @return
+ */
+static inline float Lerp(float a, float b, float fraction)
+{
+    return a + (b - a) * fraction;
+}
+
+/**
+ * @brief ToByte
+ * @param value
+ * @return
+ */
+static inline GLubyte ToByte(float value)
+{
+    return (GLubyte) qMin(255.f, value * 255.f + 0.5f);
+}
+
+/**
+ * @brief FindUnoccluded
+ * Follows the opaque-pixel links of an intermediate image row, halving the
+ * paths on the way so that runs of opaque pixels are crossed in nearly
+ * constant time.
+ * @param next Index of the next pixel that may not be opaque.
+ * @param pixel
+ * @return
+ */
+static inline int FindUnoccluded(int* next, int pixel)
+{
+    while (next[pixel] != pixel) {
+        next[pixel] = next[next[pixel]];
+        pixel = next[pixel];
+    }
+    return pixel;
+}
+
+/**
+ * @brief ShearWarpRenderer::ShearWarpRenderer
+ */
+ShearWarpRenderer::ShearWarpRenderer() :
+    threadPool_(NULL),
+    intermediateWidth_(0),
+    intermediateHeight_(0),
+    terminationOpacity_(0.99f),
+    correctionExponent_(0.f)
+{
+    volumeSize_[0] = volumeSize_[1] = volumeSize_[2] = 0;
+}
+
+/**
+ * @brief ShearWarpRenderer::Build
+ * @param rgbaVolume
+ * @param width
+ * @param height
+ * @param depth
+ * @param threadPool
+ */
+void ShearWarpRenderer::Build(const GLubyte* rgbaVolume,
+                              int width, int height, int depth,
+                              ThreadPool* threadPool)
+{
+    TRACE_SCOPE("ShearWarpRenderer::Build");
+
+    volumeSize_[0] = width;
+    volumeSize_[1] = height;
+    volumeSize_[2] = depth;
+    threadPool_ = threadPool;
+
+    for (int principal = 0; principal < 3; principal++) {
+        Encoding& encoding = encodings_[principal];
+        encoding.axis[0] = (principal + 1) % 3;
+        encoding.axis[1] = (principal + 2) % 3;
+        encoding.axis[2] = principal;
+        for (int a = 0; a < 3; a++) {
+            encoding.size[a] = volumeSize_[encoding.axis[a]];
+        }
+
+        Encode(&encoding, rgbaVolume, volumeSize_);
+    }
+}
+
+/**
+ * @brief ShearWarpRenderer::Encode
+ * Two parallel passes over the rows, the first one counts the runs and the
+ * voxels of every row so that the second one knows where to write them.
+ * @param encoding
+ * @param rgbaVolume
+ * @param volumeSize
+ */
+void ShearWarpRenderer::Encode(Encoding* encoding, const GLubyte* rgbaVolume,
+                               const int volumeSize[3])
+{
+    const quint32* volume = (const quint32 *) rgbaVolume;
+    const int ni = encoding->size[0];
+    const int nj = encoding->size[1];
+    const qint64 rows = (qint64) nj * encoding->size[2];
+
+    // Step between two voxels along each axis of the encoding
+    const qint64 volumeStride[3] = {
+        1, volumeSize[0], (qint64) volumeSize[0] * volumeSize[1]
+    };
+    const qint64 strideI = volumeStride[encoding->axis[0]];
+    const qint64 strideJ = volumeStride[encoding->axis[1]];
+    const qint64 strideK = volumeStride[encoding->axis[2]];
+
+    encoding->rowRuns.fill(0, rows + 1);
+    encoding->rowVoxels.fill(0, rows + 1);
+
+    threadPool_->ParallelFor(0, rows, 64,
+                             [&] (qint64 firstRow, qint64 lastRow) {
+        for (qint64 row = firstRow; row < lastRow; row++) {
+            const quint32* voxel = volume + (row / nj) * strideK +
+                                   (row % nj) * strideJ;
+            qint64 runs = 0;
+            qint64 voxels = 0;
+            bool inRun = false;
+            for (int i = 0; i < ni; i++, voxel += strideI) {
+                const bool visible = (*voxel != 0);
+                if (visible && !inRun)
+                    runs++;
+                if (visible)
+                    voxels++;
+                inRun = visible;
+            }
+            encoding->rowRuns[row + 1] = runs;
+            encoding->rowVoxels[row + 1] = voxels;
+        }
+    });
+
+    for (qint64 row = 0; row < rows; row++) {
+        encoding->rowRuns[row + 1] += encoding->rowRuns[row];
+        encoding->rowVoxels[row + 1] += encoding->rowVoxels[row];
+    }
+
+    encoding->runs.fill(0, 2 * encoding->rowRuns[rows]);
+    encoding->voxels.fill(0, encoding->rowVoxels[rows]);
+
+    threadPool_->ParallelFor(0, rows, 64,
+                             [&] (qint64 firstRow, qint64 lastRow) {
+        for (qint64 row = firstRow; row < lastRow; row++) {
+            const quint32* voxel = volume + (row / nj) * strideK +
+                                   (row % nj) * strideJ;
+            int* run = encoding->runs.data() + 2 * encoding->rowRuns[row];
+            quint32* packed = encoding->voxels.data() +
+                              encoding->rowVoxels[row];
+            bool inRun = false;
+            for (int i = 0; i < ni; i++, voxel += strideI) {
+                const bool visible = (*voxel != 0);
+                if (visible && !inRun)
+                    *run++ = i;
+                if (!visible && inRun)
+                    *run++ = i;
+                if (visible)
+                    *packed++ = *voxel;
+                inRun = visible;
+            }
+            if (inRun)
+                *run++ = ni;
+        }
+    });
+}
+
+/**
+ * @brief ShearWarpRenderer::GetEncodedVoxelCount
+ * @return
+ */
+qint64 ShearWarpRenderer::GetEncodedVoxelCount() const
+{
+    return encodings_[0].voxels.size();
+}
+
+/**
+ * @brief ShearWarpRenderer::SetTerminationOpacity
+ * @param opacity
+ */
+void ShearWarpRenderer::SetTerminationOpacity(float opacity)
+{
+    terminationOpacity_ = qBound(0.f, opacity, 1.f);
+}
+
+/**
+ * @brief ShearWarpRenderer::Render
+ * @param projection
+ * @param modelView
+ * @param referenceStep
+ * @param image
+ */
+void ShearWarpRenderer::Render(const QMatrix4x4& projection,
+                               const QMatrix4x4& modelView,
+                               float referenceStep, QImage* image)
+{
+    TRACE_SCOPE("ShearWarpRenderer::Render");
+
+    const int width = image->width();
+    const int height = image->height();
+    if (!threadPool_ || width == 0 || height == 0)
+        return;
+
+    // Rays of the frame in the unit cube, as in the software ray caster
+    const QMatrix4x4 clipToVolume = (projection * modelView).inverted();
+    const float x0 = 1.f / width - 1.f;
+    const float y0 = 1.f - 1.f / height;
+    const QVector3D origin = clipToVolume.map(QVector3D(x0, y0, -1.f));
+    const QVector3D pixelX =
+            clipToVolume.map(QVector3D(x0 + 2.f / width, y0, -1.f)) - origin;
+    const QVector3D pixelY =
+            clipToVolume.map(QVector3D(x0, y0 - 2.f / height, -1.f)) - origin;
+    const QVector3D direction =
+            clipToVolume.map(QVector3D(x0, y0, 1.f)) - origin;
+
+    // The principal axis is the one the rays are most aligned with in
+    // voxel space
+    float voxelDirection[3];
+    int principal = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        voxelDirection[axis] = direction[axis] * volumeSize_[axis];
+        if (fabs(voxelDirection[axis]) > fabs(voxelDirection[principal]))
+            principal = axis;
+    }
+
+    const Encoding& encoding = encodings_[principal];
+    const int* axis = encoding.axis;
+    const float directionK = voxelDirection[axis[2]];
+    if (directionK == 0.f)
+        return;
+
+    // Every slice is translated so that the rays become perpendicular to
+    // the intermediate image
+    Shear shear;
+    shear.shearI = voxelDirection[axis[0]] / directionK;
+    shear.shearJ = voxelDirection[axis[1]] / directionK;
+    shear.offsetI = 1.f + qMax(0.f, shear.shearI) * (encoding.size[2] - 1);
+    shear.offsetJ = 1.f + qMax(0.f, shear.shearJ) * (encoding.size[2] - 1);
+    shear.forward = (directionK > 0.f);
+
+    intermediateWidth_ = encoding.size[0] + 3 +
+            (int) ceil(fabs(shear.shearI) * (encoding.size[2] - 1));
+    intermediateHeight_ = encoding.size[1] + 3 +
+            (int) ceil(fabs(shear.shearJ) * (encoding.size[2] - 1));
+    intermediate_.fill(0.f, 4 * intermediateWidth_ * intermediateHeight_);
+
+    // Opacities are defined for the reference step, the samples of a ray
+    // are one slice apart
+    const float sliceDistance = direction.length() / fabs(directionK);
+    const float exponent = sliceDistance / referenceStep;
+    if (exponent != correctionExponent_) {
+        correctionExponent_ = exponent;
+        correctionRatio_.fill(0.f, CORRECTION_ENTRIES);
+        correctionRatio_[0] = exponent;
+        for (int i = 1; i < CORRECTION_ENTRIES; i++) {
+            const float alpha = (float) i / (CORRECTION_ENTRIES - 1);
+            correctionRatio_[i] =
+                    (1.f - pow(1.f - alpha, exponent)) / alpha;
+        }
+    }
+
+    // Rows of the intermediate image are independent
+    threadPool_->ParallelFor(0, intermediateHeight_, COMPOSITE_ROWS,
+                             [&] (qint64 firstRow, qint64 lastRow) {
+        Composite(encoding, shear, firstRow, lastRow);
+    });
+
+    // The warp is affine, a pixel starting at voxel position P lands at
+    // (P_i - P_k * shearI + offsetI, P_j - P_k * shearJ + offsetJ)
+    float pixelStart[3];
+    float pixelStepX[3];
+    float pixelStepY[3];
+    for (int a = 0; a < 3; a++) {
+        const int size = volumeSize_[axis[a]];
+        pixelStart[a] = origin[axis[a]] * size - 0.5f;
+        pixelStepX[a] = pixelX[axis[a]] * size;
+        pixelStepY[a] = pixelY[axis[a]] * size;
+    }
+    const float u0 = pixelStart[0] - pixelStart[2] * shear.shearI +
+                     shear.offsetI;
+    const float v0 = pixelStart[1] - pixelStart[2] * shear.shearJ +
+                     shear.offsetJ;
+    const float uX = pixelStepX[0] - pixelStepX[2] * shear.shearI;
+    const float vX = pixelStepX[1] - pixelStepX[2] * shear.shearJ;
+    const float uY = pixelStepY[0] - pixelStepY[2] * shear.shearI;
+    const float vY = pixelStepY[1] - pixelStepY[2] * shear.shearJ;
+
+    GLubyte* bits = image->bits();
+    const int bytesPerLine = image->bytesPerLine();
+    const float* sheared = intermediate_.constData();
+    const int shearedWidth = intermediateWidth_;
+    const int shearedHeight = intermediateHeight_;
+
+    threadPool_->ParallelFor(0, height, COMPOSITE_ROWS,
+                             [&] (qint64 firstRow, qint64 lastRow) {
+        for (qint64 y = firstRow; y < lastRow; y++) {
+            GLubyte* pixel = bits + y * bytesPerLine;
+            for (int x = 0; x < width; x++, pixel += 4) {
+                const float u = u0 + x * uX + y * uY;
+                const float v = v0 + x * vX + y * vY;
+                const int uLower = (int) floor(u);
+                const int vLower = (int) floor(v);
+                const float fu = u - uLower;
+                const float fv = v - vLower;
+
+                // The border of the intermediate image is always empty
+                if (uLower < 0 || vLower < 0 || uLower + 1 >= shearedWidth ||
+                        vLower + 1 >= shearedHeight) {
+                    memset(pixel, 0, 4);
+                    continue;
+                }
+
+                const float* p00 = sheared +
+                        4 * ((qint64) vLower * shearedWidth + uLower);
+                const float* p10 = p00 + 4;
+                const float* p01 = p00 + 4 * shearedWidth;
+                const float* p11 = p01 + 4;
+                for (int channel = 0; channel < 4; channel++) {
+                    pixel[channel] = ToByte(Lerp(
+                            Lerp(p00[channel], p10[channel], fu),
+                            Lerp(p01[channel], p11[channel], fu), fv));
+                }
+            }
+        }
+    });
+}
+
+/**
+ * @brief ShearWarpRenderer::Composite
+ * @param encoding
+ * @param shear
+ * @param firstRow
+ * @param lastRow
+ */
+void ShearWarpRenderer::Composite(const Encoding& encoding,
+                                  const Shear& shear,
+                                  int firstRow, int lastRow)
+{
+    const int ni = encoding.size[0];
+    const int nj = encoding.size[1];
+    const int nk = encoding.size[2];
+    const int imageWidth = intermediateWidth_;
+    const float* ratio = correctionRatio_.constData();
+
+    // Two decoded voxel rows padded by one transparent voxel on each side
+    std::vector<quint32> upperRow(ni + 2, 0);
+    std::vector<quint32> lowerRow(ni + 2, 0);
+
+    // Opaque-pixel links of every row of the band
+    const int bandRows = lastRow - firstRow;
+    std::vector<int> next((qint64) bandRows * (imageWidth + 1));
+    for (int row = 0; row < bandRows; row++) {
+        for (int u = 0; u <= imageWidth; u++) {
+            next[(qint64) row * (imageWidth + 1) + u] = u;
+        }
+    }
+
+    std::vector<std::pair<int, int> > spans;
+    std::vector<std::pair<int, int> > merged;
+
+    for (int slice = 0; slice < nk; slice++) {
+        const int k = shear.forward ? slice : nk - 1 - slice;
+
+        // Pixel u samples the slice at i = u + di + wx, the same weights
+        // hold for the whole slice
+        const float translationI = shear.offsetI - k * shear.shearI;
+        const float translationJ = shear.offsetJ - k * shear.shearJ;
+        const int di = (int) floor(-translationI);
+        const int dj = (int) floor(-translationJ);
+        const float wx = -translationI - di;
+        const float wy = -translationJ - dj;
+
+        for (int v = firstRow; v < lastRow; v++) {
+            const int j0 = v + dj;
+            if (j0 < -1 || j0 >= nj)
+                continue;
+
+            // Spans of pixels touched by the runs of the two voxel rows
+            spans.clear();
+            std::vector<quint32>* decoded[2] = { &upperRow, &lowerRow };
+            for (int r = 0; r < 2; r++) {
+                const int j = j0 + r;
+                if (j < 0 || j >= nj)
+                    continue;
+
+                const qint64 row = (qint64) k * nj + j;
+                const int* run = encoding.runs.constData() +
+                                 2 * encoding.rowRuns[row];
+                const int* runEnd = encoding.runs.constData() +
+                                    2 * encoding.rowRuns[row + 1];
+                const quint32* packed = encoding.voxels.constData() +
+                                        encoding.rowVoxels[row];
+                for (; run != runEnd; run += 2) {
+                    memcpy(decoded[r]->data() + run[0] + 1, packed,
+                           4 * (run[1] - run[0]));
+                    packed += run[1] - run[0];
+                    spans.push_back(std::make_pair(
+                            qMax(0, run[0] - 1 - di),
+                            qMin(imageWidth, run[1] - di)));
+                }
+            }
+            if (spans.empty())
+                continue;
+
+            // Sort the spans of both rows by start and join the overlaps
+            std::sort(spans.begin(), spans.end());
+            merged.clear();
+            for (size_t s = 0; s < spans.size(); s++) {
+                if (spans[s].first >= spans[s].second)
+                    continue;
+
+                if (!merged.empty() && spans[s].first <= merged.back().second) {
+                    merged.back().second = qMax(merged.back().second,
+                                                spans[s].second);
+                } else {
+                    merged.push_back(spans[s]);
+                }
+            }
+
+            int* links = next.data() + (qint64) (v - firstRow) *
+                                       (imageWidth + 1);
+            float* pixels = intermediate_.data() +
+                            4 * (qint64) v * imageWidth;
+            const quint32* upper = upperRow.data() + di + 1;
+            const quint32* lower = lowerRow.data() + di + 1;
+
+            for (size_t s = 0; s < merged.size(); s++) {
+                const int end = merged[s].second;
+                for (int u = FindUnoccluded(links, merged[s].first); u < end;
+                     u = FindUnoccluded(links, u + 1)) {
+                    const quint32 c00 = upper[u];
+                    const quint32 c10 = upper[u + 1];
+                    const quint32 c01 = lower[u];
+                    const quint32 c11 = lower[u + 1];
+                    if ((c00 | c10 | c01 | c11) == 0)
+                        continue;
+
+                    float sample[4];
+                    for (int channel = 0; channel < 4; channel++) {
+                        const int shift = 8 * channel;
+                        sample[channel] = Lerp(
+                                Lerp((c00 >> shift) & 0xff,
+                                     (c10 >> shift) & 0xff, wx),
+                                Lerp((c01 >> shift) & 0xff,
+                                     (c11 >> shift) & 0xff, wx), wy) *
+                                (1.f / 255.f);
+                    }
+
+                    // Front-to-back compositing of premultiplied samples
+                    float* color = pixels + 4 * u;
+                    const int entry = (int) (sample[3] *
+                                             (CORRECTION_ENTRIES - 1) + 0.5f);
+                    const float weight = (1.f - color[3]) * ratio[entry];
+                    for (int channel = 0; channel < 4; channel++) {
+                        color[channel] += weight * sample[channel];
+                    }
+
+                    // Later slices skip this pixel
+                    if (color[3] >= terminationOpacity_)
+                        links[u] = u + 1;
+                }
+            }
+
+            // Leave the decoded rows transparent for the next image row
+            for (int r = 0; r < 2; r++) {
+                const int j = j0 + r;
+                if (j < 0 || j >= nj)
+                    continue;
+
+                const qint64 row = (qint64) k * nj + j;
+                const int* run = encoding.runs.constData() +
+                                 2 * encoding.rowRuns[row];
+                const int* runEnd = encoding.runs.constData() +
+                                    2 * encoding.rowRuns[row + 1];
+                for (; run != runEnd; run += 2) {
+                    memset(decoded[r]->data() + run[0] + 1, 0,
+                           4 * (run[1] - run[0]));
+                }
+            }
+        }
+    }
+}
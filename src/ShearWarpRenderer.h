@@ -0,0 +1,183 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef SHEARWARPRENDERER_H
+#define SHEARWARPRENDERER_H
+
+#include <QImage>
+#include <QMatrix4x4>
+#include <QVector>
+#include <QtGui/qopengl.h>
+#include "ThreadPool.h"
+
+/**
+ * @brief The ShearWarpRenderer class
+ * Shear-warp renderer after Lacroute and Levoy. The classified volume is
+ * kept as three run-length-encoded copies, one per principal axis, that
+ * store only the runs of non-transparent voxels. A frame composites the
+ * slices of the copy most aligned with the view front to back into a
+ * sheared intermediate image, where every ray is a single pixel, and warps
+ * that image into the final one.
+ */
+class ShearWarpRenderer
+{
+public:
+    /**
+     * @brief ShearWarpRenderer
+     */
+    ShearWarpRenderer();
+
+    /**
+     * @brief Build
+     * Encodes the three copies, must be called again whenever the
+     * classified volume changes.
+     * @param rgbaVolume Classified volume, 4 premultiplied bytes per voxel.
+     * @param width
+     * @param height
+     * @param depth
+     * @param threadPool
+     */
+    void Build(const GLubyte* rgbaVolume, int width, int height, int depth,
+               ThreadPool* threadPool);
+
+    /**
+     * @brief GetEncodedVoxelCount
+     * @return Non-transparent voxels stored in one copy.
+     */
+    qint64 GetEncodedVoxelCount() const;
+
+    /**
+     * @brief SetTerminationOpacity
+     * @param opacity Accumulated opacity at which a pixel is skipped.
+     */
+    void SetTerminationOpacity(float opacity);
+
+    /**
+     * @brief Render
+     * Renders with the same camera as the OpenGL path.
+     * @param projection Eye to clip space.
+     * @param modelView Unit volume cube to eye space.
+     * @param referenceStep Distance the opacities of the volume are
+     * defined for, used to correct them for the slice distance.
+     * @param image Target, premultiplied RGBA8888.
+     */
+    void Render(const QMatrix4x4& projection, const QMatrix4x4& modelView,
+                float referenceStep, QImage* image);
+
+    /** \brief Intermediate image rows composited by one task */
+    static const int COMPOSITE_ROWS = 16;
+
+    /** \brief Entries of the opacity correction table */
+    static const int CORRECTION_ENTRIES = 1024;
+
+private:
+    /**
+     * @brief The Encoding struct
+     * Run-length-encoded copy of the volume sliced along axis[2]. A row
+     * is a line of voxels along axis[0], row r = k * size[1] + j.
+     */
+    struct Encoding
+    {
+        /** \brief Volume axes of i, j and k */
+        int axis[3];
+
+        /** \brief Voxels along i, j and k */
+        int size[3];
+
+        /** \brief First run of every row, one more entry than rows */
+        QVector<qint64> rowRuns;
+
+        /** \brief First voxel of every row, one more entry than rows */
+        QVector<qint64> rowVoxels;
+
+        /** \brief [start, end) of every non-transparent run along i */
+        QVector<int> runs;
+
+        /** \brief Voxels of the runs, row after row */
+        QVector<quint32> voxels;
+    };
+
+    /**
+     * @brief The Shear struct
+     * Factorization of the view for one frame.
+     */
+    struct Shear
+    {
+        /** \brief Intermediate image pixels per slice along i and j */
+        float shearI;
+        float shearJ;
+
+        /** \brief Intermediate image position of voxel (0, 0, 0) */
+        float offsetI;
+        float offsetJ;
+
+        /** \brief Slices are visited from k = 0 */
+        bool forward;
+    };
+
+    /**
+     * @brief Encode
+     * @param encoding
+     * @param rgbaVolume
+     * @param volumeSize
+     */
+    void Encode(Encoding* encoding, const GLubyte* rgbaVolume,
+                const int volumeSize[3]);
+
+    /**
+     * @brief Composite
+     * Composites the slices into the rows [firstRow, lastRow) of the
+     * intermediate image.
+     * @param encoding
+     * @param shear
+     * @param firstRow
+     * @param lastRow
+     */
+    void Composite(const Encoding& encoding, const Shear& shear,
+                   int firstRow, int lastRow);
+
+private:
+    /** \brief Volume dimensions */
+    int volumeSize_[3];
+
+    /** \brief One copy per principal axis */
+    Encoding encodings_[3];
+
+    /** \brief Runs the encoding, compositing and warping tasks */
+    ThreadPool* threadPool_;
+
+    /** \brief Sheared image, premultiplied RGBA */
+    QVector<float> intermediate_;
+
+    /** \brief Intermediate image size */
+    int intermediateWidth_;
+    int intermediateHeight_;
+
+    /** \brief Opacity at which a pixel is skipped */
+    float terminationOpacity_;
+
+    /** \brief Corrected over original opacity, indexed by the original
+     * opacity scaled to CORRECTION_ENTRIES - 1 */
+    QVector<float> correctionRatio_;
+
+    /** \brief Exponent the table was built for */
+    float correctionExponent_;
+};
+
+#endif // SHEARWARPRENDERER_H
@@ -0,0 +1,135 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "SliceCountController.h"
+#include <QtGlobal>
+
+/** \brief Fraction of the budget aimed at, the rest absorbs the noise */
+static const float BUDGET_HEADROOM = 0.85f;
+
+/** \brief Relative change below which the count is left alone */
+static const float DEAD_BAND = 0.1f;
+
+/** \brief Weight of a new frame in the smoothed slice cost */
+static const float COST_SMOOTHING = 0.2f;
+
+/**
+ * @brief SliceCountController::SliceCountController
+ */
+SliceCountController::SliceCountController() :
+    sliceCost_(0.f),
+    targetMilliseconds_(0.f),
+    baseSlices_(1),
+    minSlices_(1),
+    maxSlices_(1),
+    slices_(1),
+    pixelFraction_(1.f),
+    settledFrames_(0) { }
+
+/**
+ * @brief SliceCountController::SetTarget
+ * @param framesPerSecond
+ */
+void SliceCountController::SetTarget(float framesPerSecond)
+{
+    targetMilliseconds_ = (framesPerSecond > 0.f) ?
+                1000.f / framesPerSecond : 0.f;
+}
+
+/**
+ * @brief SliceCountController::IsEnabled
+ * @return
+ */
+bool SliceCountController::IsEnabled() const
+{
+    return targetMilliseconds_ > 0.f;
+}
+
+/**
+ * @brief SliceCountController::SetLimits
+ * @param baseSlices
+ * @param minSlices
+ * @param maxSlices
+ */
+void SliceCountController::SetLimits(int baseSlices, int minSlices,
+                                     int maxSlices)
+{
+    minSlices_ = qMax(minSlices, 1);
+    maxSlices_ = qMax(maxSlices, minSlices_);
+    baseSlices_ = qBound(minSlices_, baseSlices, maxSlices_);
+    slices_ = baseSlices_;
+    sliceCost_ = 0.f;
+    settledFrames_ = 0;
+}
+
+/**
+ * @brief SliceCountController::Update
+ * @param frameMilliseconds
+ * @param voxelPixels
+ * @param pixelFraction
+ * @return
+ */
+int SliceCountController::Update(float frameMilliseconds, float voxelPixels,
+                                 float pixelFraction)
+{
+    // A frame of the current count and resolution, once the frames of the
+    // previous ones are out of the measurements
+    if (settledFrames_ >= SETTLE_FRAMES && frameMilliseconds > 0.f) {
+        const float cost = frameMilliseconds / (slices_ * pixelFraction_);
+        sliceCost_ = (sliceCost_ > 0.f) ?
+                    sliceCost_ + COST_SMOOTHING * (cost - sliceCost_) : cost;
+    }
+    settledFrames_++;
+
+    // Same distance between the slices on the screen at any zoom
+    const float zoomSlices = baseSlices_ * voxelPixels;
+
+    // Most slices the budget allows at the next resolution
+    float budgetSlices = maxSlices_;
+    if (sliceCost_ > 0.f) {
+        budgetSlices = targetMilliseconds_ * BUDGET_HEADROOM /
+                (sliceCost_ * pixelFraction);
+    }
+
+    // Fewer slices as soon as the budget is exceeded or the view zoomed
+    // out, more only once they fit with some headroom
+    const float target = qMin(zoomSlices, budgetSlices);
+    int slices = slices_;
+    if (slices_ > qMin(zoomSlices * (1.f + DEAD_BAND),
+                       budgetSlices / BUDGET_HEADROOM) ||
+            target > slices_ * (1.f + DEAD_BAND)) {
+        slices = qBound(minSlices_, (int) target, maxSlices_);
+    }
+
+    if (slices != slices_ || pixelFraction != pixelFraction_) {
+        slices_ = slices;
+        pixelFraction_ = pixelFraction;
+        settledFrames_ = 0;
+    }
+    return slices_;
+}
+
+/**
+ * @brief SliceCountController::GetSliceCount
+ * @return
+ */
+int SliceCountController::GetSliceCount() const
+{
+    return slices_;
+}
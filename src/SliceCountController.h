@@ -0,0 +1,106 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef SLICECOUNTCONTROLLER_H
+#define SLICECOUNTCONTROLLER_H
+
+/**
+ * @brief The SliceCountController class
+ * Picks the number of slices of the next frame. The count follows the zoom,
+ * so that the slices keep the same distance on the screen, and is capped
+ * by a frame-time budget. The cost of a slice is learned from the measured
+ * frame times, on the assumption that slicing is fill-rate bound. A dead
+ * band and a few settling frames after every change keep the count from
+ * oscillating.
+ */
+class SliceCountController
+{
+public:
+    /**
+     * @brief SliceCountController
+     */
+    SliceCountController();
+
+    /**
+     * @brief SetTarget
+     * @param framesPerSecond Frame rate to hold, 0 to disable the
+     * controller.
+     */
+    void SetTarget(float framesPerSecond);
+
+    /**
+     * @brief IsEnabled
+     * @return
+     */
+    bool IsEnabled() const;
+
+    /**
+     * @brief SetLimits
+     * Also restarts the controller at _baseSlices_.
+     * @param baseSlices Slices at one voxel per pixel.
+     * @param minSlices
+     * @param maxSlices
+     */
+    void SetLimits(int baseSlices, int minSlices, int maxSlices);
+
+    /**
+     * @brief Update
+     * @param frameMilliseconds Cost of the previous frame, 0 if unknown.
+     * @param voxelPixels Pixels per voxel of the next frame.
+     * @param pixelFraction Fraction of the window pixels the next frame is
+     * rendered at.
+     * @return Slices of the next frame.
+     */
+    int Update(float frameMilliseconds, float voxelPixels,
+               float pixelFraction);
+
+    /**
+     * @brief GetSliceCount
+     * @return
+     */
+    int GetSliceCount() const;
+
+private:
+    /** \brief Frames ignored after a change, the GPU times run behind */
+    static const int SETTLE_FRAMES = 6;
+
+    /** \brief Frame time per slice at full resolution, smoothed, in
+     * milliseconds, 0 until measured */
+    float sliceCost_;
+
+    /** \brief Budget of a frame in milliseconds, 0 if disabled */
+    float targetMilliseconds_;
+
+    /** \brief Slices at one voxel per pixel */
+    int baseSlices_;
+
+    int minSlices_;
+    int maxSlices_;
+
+    /** \brief Slices of the current frames */
+    int slices_;
+
+    /** \brief Resolution the current frames are rendered at */
+    float pixelFraction_;
+
+    /** \brief Frames since the count or the resolution changed */
+    int settledFrames_;
+};
+
+#endif // SLICECOUNTCONTROLLER_H
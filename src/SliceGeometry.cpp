@@ -0,0 +1,201 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "SliceGeometry.h"
+#include <algorithm>
+#include <math.h>
+
+/** \brief The twelve edges of a box as pairs of corner indices, bit 0 of a
+ * corner index selects the upper x, bit 1 the upper y and bit 2 the upper z */
+static const int BOX_EDGES[12][2] = {
+    {0, 1}, {2, 3}, {4, 5}, {6, 7},
+    {0, 2}, {1, 3}, {4, 6}, {5, 7},
+    {0, 4}, {1, 5}, {2, 6}, {3, 7}
+};
+
+/**
+ * @brief SliceGeometry::SliceGeometry
+ */
+SliceGeometry::SliceGeometry() :
+    halfSlices_(0),
+    spacing_(1.f),
+    offset_(0.f) { }
+
+/**
+ * @brief SliceGeometry::SetSlices
+ * @param halfSlices
+ * @param spacing
+ */
+void SliceGeometry::SetSlices(int halfSlices, float spacing)
+{
+    halfSlices_ = halfSlices;
+    spacing_ = spacing;
+}
+
+/**
+ * @brief SliceGeometry::GetSliceCount
+ * @return
+ */
+int SliceGeometry::GetSliceCount() const
+{
+    return 2 * halfSlices_ + 1;
+}
+
+/**
+ * @brief SliceGeometry::GetSpacing
+ * @return
+ */
+float SliceGeometry::GetSpacing() const
+{
+    return spacing_;
+}
+
+/**
+ * @brief SliceGeometry::SetOffset
+ * @param offset
+ */
+void SliceGeometry::SetOffset(float offset)
+{
+    offset_ = offset;
+}
+
+/**
+ * @brief SliceGeometry::GetOffset
+ * @return
+ */
+float SliceGeometry::GetOffset() const
+{
+    return offset_;
+}
+
+/**
+ * @brief SliceGeometry::SetRotation
+ * @param rotation
+ */
+void SliceGeometry::SetRotation(const QMatrix4x4& rotation)
+{
+    rotation_ = rotation;
+}
+
+/**
+ * @brief SliceGeometry::Clear
+ */
+void SliceGeometry::Clear()
+{
+    vertices_.clear();
+}
+
+/**
+ * @brief SliceGeometry::AddBox
+ * @param boxMin
+ * @param boxMax
+ * @param first
+ * @param count
+ */
+void SliceGeometry::AddBox(const QVector3D& boxMin, const QVector3D& boxMax,
+                           int* first, int* count)
+{
+    *first = GetVertexCount();
+
+    // Corners of the box in view space
+    QVector3D corners[8];
+    float zMin = HUGE_VALF;
+    float zMax = -HUGE_VALF;
+    for (int c = 0; c < 8; c++) {
+        const QVector3D corner((c & 1) ? boxMax.x() : boxMin.x(),
+                               (c & 2) ? boxMax.y() : boxMin.y(),
+                               (c & 4) ? boxMax.z() : boxMin.z());
+        corners[c] = rotation_.map(corner - QVector3D(0.5, 0.5, 0.5));
+        zMin = qMin(zMin, corners[c].z());
+        zMax = qMax(zMax, corners[c].z());
+    }
+
+    // Only the planes that cross the box, from the farthest one
+    const int iFirst = qMax(-halfSlices_,
+                            (int) ceil(zMin / spacing_ - offset_));
+    const int iLast = qMin(halfSlices_,
+                           (int) floor(zMax / spacing_ - offset_));
+
+    QVector3D polygon[6];
+    float angles[6];
+    int order[6];
+    for (int i = iFirst; i <= iLast; i++) {
+        const float z = (i + offset_) * spacing_;
+
+        // A plane cuts a box in at most six edges
+        int points = 0;
+        for (int e = 0; e < 12 && points < 6; e++) {
+            const QVector3D& a = corners[BOX_EDGES[e][0]];
+            const QVector3D& b = corners[BOX_EDGES[e][1]];
+            if ((a.z() < z) == (b.z() < z) || a.z() == b.z())
+                continue;
+
+            const float t = (z - a.z()) / (b.z() - a.z());
+            polygon[points++] = a + t * (b - a);
+        }
+
+        if (points < 3)
+            continue;
+
+        // Order the points around their centroid
+        QVector3D centroid;
+        for (int p = 0; p < points; p++) {
+            centroid += polygon[p];
+        }
+        centroid /= points;
+
+        for (int p = 0; p < points; p++) {
+            angles[p] = atan2(polygon[p].y() - centroid.y(),
+                              polygon[p].x() - centroid.x());
+            order[p] = p;
+        }
+        std::sort(order, order + points,
+                  [&angles] (int a, int b) { return angles[a] < angles[b]; });
+
+        // Fan of triangles
+        for (int p = 1; p + 1 < points; p++) {
+            const int fan[3] = { order[0], order[p], order[p + 1] };
+            for (int v = 0; v < 3; v++) {
+                vertices_.push_back(polygon[fan[v]].x());
+                vertices_.push_back(polygon[fan[v]].y());
+                vertices_.push_back(z);
+            }
+        }
+    }
+
+    *count = GetVertexCount() - *first;
+}
+
+/**
+ * @brief SliceGeometry::GetVertices
+ * @return
+ */
+const QVector<GLfloat>& SliceGeometry::GetVertices() const
+{
+    return vertices_;
+}
+
+/**
+ * @brief SliceGeometry::GetVertexCount
+ * @return
+ */
+int SliceGeometry::GetVertexCount() const
+{
+    return vertices_.size() / 3;
+}
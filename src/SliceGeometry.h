@@ -0,0 +1,128 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef SLICEGEOMETRY_H
+#define SLICEGEOMETRY_H
+
+#include <QMatrix4x4>
+#include <QVector>
+#include <QVector3D>
+#include <QtGui/qopengl.h>
+
+/**
+ * @brief The SliceGeometry class
+ * Builds the polygons where a stack of view-aligned planes cuts boxes of
+ * the unit volume cube. The planes are z = (i + offset) * spacing in view
+ * space, for i in [-halfSlices, halfSlices], and every polygon is emitted
+ * as a fan of triangles.
+ */
+class SliceGeometry
+{
+public:
+    /**
+     * @brief SliceGeometry
+     */
+    SliceGeometry();
+
+    /**
+     * @brief SetSlices
+     * @param halfSlices Number of planes on each side of the centre plane.
+     * @param spacing Distance between two planes in view space.
+     */
+    void SetSlices(int halfSlices, float spacing);
+
+    /**
+     * @brief GetSliceCount
+     * @return
+     */
+    int GetSliceCount() const;
+
+    /**
+     * @brief GetSpacing
+     * @return
+     */
+    float GetSpacing() const;
+
+    /**
+     * @brief SetOffset
+     * @param offset Shift of all the planes along the view axis, as a
+     * fraction of the spacing.
+     */
+    void SetOffset(float offset);
+
+    /**
+     * @brief GetOffset
+     * @return
+     */
+    float GetOffset() const;
+
+    /**
+     * @brief SetRotation
+     * @param rotation Rotation from the volume, centred on the origin, to
+     * the view.
+     */
+    void SetRotation(const QMatrix4x4& rotation);
+
+    /**
+     * @brief Clear
+     * Drops all vertices.
+     */
+    void Clear();
+
+    /**
+     * @brief AddBox
+     * Appends the slices through a box of the unit cube, farthest first.
+     * @param boxMin
+     * @param boxMax
+     * @param first Index of the first vertex of the box.
+     * @param count Number of vertices of the box.
+     */
+    void AddBox(const QVector3D& boxMin, const QVector3D& boxMax,
+                int* first, int* count);
+
+    /**
+     * @brief GetVertices
+     * @return x, y and z of every vertex, in view space.
+     */
+    const QVector<GLfloat>& GetVertices() const;
+
+    /**
+     * @brief GetVertexCount
+     * @return
+     */
+    int GetVertexCount() const;
+
+private:
+    /** \brief Planes on each side of the centre plane */
+    int halfSlices_;
+
+    /** \brief Distance between two planes */
+    float spacing_;
+
+    /** \brief Shift of the planes in units of _spacing_ */
+    float offset_;
+
+    /** \brief Volume to view rotation */
+    QMatrix4x4 rotation_;
+
+    /** \brief Triangle vertices */
+    QVector<GLfloat> vertices_;
+};
+
+#endif // SLICEGEOMETRY_H
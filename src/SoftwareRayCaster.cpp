@@ -0,0 +1,690 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "SoftwareRayCaster.h"
+#include "Trace.h"
+#include "VolumeClassifier.h"
+#include <climits>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define RAYCASTER_X86_64
+#include <immintrin.h>
+#endif
+
+// Compiled for AVX2 on its own and only called after the runtime check
+#if defined(__GNUC__) || defined(__clang__)
+#define RAYCASTER_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define RAYCASTER_TARGET_AVX2
+#endif
+
+/**
+ * @brief Lerp
+ * @param a
+ * @param b
+ * @param fraction
+ * @return
+ */
+static inline float Lerp(float a, float b, float fraction)
+{
+    return a + (b - a) * fraction;
+}
+
+/**
+ * @brief ToByte
+ * @param value
+ * @return
+ */
+static inline GLubyte ToByte(float value)
+{
+    return (GLubyte) qMin(255.f, value * 255.f + 0.5f);
+}
+
+/**
+ * @brief SoftwareRayCaster::SoftwareRayCaster
+ */
+SoftwareRayCaster::SoftwareRayCaster() :
+    rgbaVolume_(NULL),
+    emptySpace_(NULL),
+    threadPool_(NULL),
+    kernel_(KERNEL_SCALAR),
+    terminationOpacity_(0.99f),
+    correctionExponent_(0.f)
+{
+    volumeSize_[0] = volumeSize_[1] = volumeSize_[2] = 0;
+    SetKernel(KERNEL_AUTO);
+}
+
+/**
+ * @brief SoftwareRayCaster::SetVolume
+ * @param rgbaVolume
+ * @param width
+ * @param height
+ * @param depth
+ */
+void SoftwareRayCaster::SetVolume(const GLubyte* rgbaVolume,
+                                  int width, int height, int depth)
+{
+    rgbaVolume_ = rgbaVolume;
+    volumeSize_[0] = width;
+    volumeSize_[1] = height;
+    volumeSize_[2] = depth;
+
+    // The packets gather with 32-bit voxel indices
+    if ((qint64) width * height * depth > INT_MAX)
+        kernel_ = KERNEL_SCALAR;
+}
+
+/**
+ * @brief SoftwareRayCaster::SetEmptySpace
+ * @param emptySpace
+ */
+void SoftwareRayCaster::SetEmptySpace(const MinMaxGrid* emptySpace)
+{
+    emptySpace_ = emptySpace;
+}
+
+/**
+ * @brief SoftwareRayCaster::SetThreadPool
+ * @param threadPool
+ */
+void SoftwareRayCaster::SetThreadPool(ThreadPool* threadPool)
+{
+    threadPool_ = threadPool;
+}
+
+/**
+ * @brief SoftwareRayCaster::SetKernel
+ * @param kernel
+ */
+void SoftwareRayCaster::SetKernel(Kernel kernel)
+{
+    const bool avx2 = VolumeClassifier::CpuSupportsAVX2();
+    if (kernel == KERNEL_AUTO)
+        kernel = avx2 ? KERNEL_AVX2 : KERNEL_SCALAR;
+
+#ifdef RAYCASTER_X86_64
+    if (kernel == KERNEL_AVX2 && !avx2)
+        kernel = KERNEL_SCALAR;
+#else
+    kernel = KERNEL_SCALAR;
+#endif
+
+    kernel_ = kernel;
+}
+
+/**
+ * @brief SoftwareRayCaster::GetKernel
+ * @return
+ */
+SoftwareRayCaster::Kernel SoftwareRayCaster::GetKernel() const
+{
+    return kernel_;
+}
+
+/**
+ * @brief SoftwareRayCaster::GetKernelName
+ * @return
+ */
+const char* SoftwareRayCaster::GetKernelName() const
+{
+    switch (kernel_) {
+    case KERNEL_AVX2:
+        return "AVX2";
+    default:
+        return "scalar";
+    }
+}
+
+/**
+ * @brief SoftwareRayCaster::SetTerminationOpacity
+ * @param opacity
+ */
+void SoftwareRayCaster::SetTerminationOpacity(float opacity)
+{
+    terminationOpacity_ = qBound(0.f, opacity, 1.f);
+}
+
+/**
+ * @brief SoftwareRayCaster::ClipRay
+ * @param origin
+ * @param direction
+ * @param tEnter
+ * @param tExit
+ * @return
+ */
+bool SoftwareRayCaster::ClipRay(const float origin[3],
+                                const float direction[3],
+                                float* tEnter, float* tExit)
+{
+    *tEnter = 0.f;
+    *tExit = 1.f;
+
+    for (int axis = 0; axis < 3; axis++) {
+        // A ray parallel to the slabs is either always or never between
+        if (fabs(direction[axis]) < 1.0e-6f) {
+            if (origin[axis] < 0.f || origin[axis] > 1.f)
+                return false;
+            continue;
+        }
+
+        const float t0 = -origin[axis] / direction[axis];
+        const float t1 = (1.f - origin[axis]) / direction[axis];
+        *tEnter = qMax(*tEnter, qMin(t0, t1));
+        *tExit = qMin(*tExit, qMax(t0, t1));
+    }
+
+    return *tEnter < *tExit;
+}
+
+/**
+ * @brief SoftwareRayCaster::SkipEmptySpace
+ * The grid cells include the voxels a trilinear sample reads around them,
+ * so every sample inside an empty cell is transparent.
+ * @param origin
+ * @param direction
+ * @param tStep
+ * @param step
+ * @return
+ */
+int SoftwareRayCaster::SkipEmptySpace(const float origin[3],
+                                      const float direction[3],
+                                      float tStep, int step) const
+{
+    const float t = (step + 0.5f) * tStep;
+    const int cellSize = emptySpace_->GetCellSize();
+
+    int cell[3];
+    for (int axis = 0; axis < 3; axis++) {
+        const int size = volumeSize_[axis];
+        const int voxel = qBound(0, (int) floor((origin[axis] + t *
+                                 direction[axis]) * size), size - 1);
+        cell[axis] = voxel / cellSize;
+    }
+
+    if (!emptySpace_->IsEmpty(cell[0], cell[1], cell[2]))
+        return step;
+
+    // Leave the block of empty cells centred on the cell
+    const int emptyCells =
+            emptySpace_->GetSkipDistance(cell[0], cell[1], cell[2]);
+    float tLeave = 1.f;
+    for (int axis = 0; axis < 3; axis++) {
+        if (fabs(direction[axis]) < 1.0e-6f)
+            continue;
+
+        const int boundary = (direction[axis] > 0.f) ?
+                    cell[axis] + emptyCells + 1 : cell[axis] - emptyCells;
+        const float position =
+                (float) boundary * cellSize / volumeSize_[axis];
+        tLeave = qMin(tLeave, (position - origin[axis]) / direction[axis]);
+    }
+
+    return qMax(step + 1, (int) ceil(tLeave / tStep - 0.5f));
+}
+
+/**
+ * @brief SoftwareRayCaster::Render
+ * @param projection
+ * @param modelView
+ * @param samplingStep
+ * @param referenceStep
+ * @param image
+ */
+void SoftwareRayCaster::Render(const QMatrix4x4& projection,
+                               const QMatrix4x4& modelView,
+                               float samplingStep, float referenceStep,
+                               QImage* image)
+{
+    TRACE_SCOPE("SoftwareRayCaster::Render");
+
+    const int width = image->width();
+    const int height = image->height();
+    if (!rgbaVolume_ || width == 0 || height == 0)
+        return;
+
+    // Opacities are defined for the reference step, the table corrects
+    // them for the sampling step
+    const float exponent = samplingStep / referenceStep;
+    if (exponent != correctionExponent_) {
+        correctionExponent_ = exponent;
+        correctionRatio_.fill(0.f, CORRECTION_ENTRIES);
+        correctionRatio_[0] = exponent;
+        for (int i = 1; i < CORRECTION_ENTRIES; i++) {
+            const float alpha = (float) i / (CORRECTION_ENTRIES - 1);
+            correctionRatio_[i] =
+                    (1.f - pow(1.f - alpha, exponent)) / alpha;
+        }
+    }
+
+    // The projection is orthographic, so the rays are parallel and their
+    // origins move linearly with the pixel. Rows run top to bottom.
+    const QMatrix4x4 clipToVolume = (projection * modelView).inverted();
+    const float x0 = 1.f / width - 1.f;
+    const float y0 = 1.f - 1.f / height;
+    const QVector3D origin = clipToVolume.map(QVector3D(x0, y0, -1.f));
+    const QVector3D pixelX =
+            clipToVolume.map(QVector3D(x0 + 2.f / width, y0, -1.f)) - origin;
+    const QVector3D pixelY =
+            clipToVolume.map(QVector3D(x0, y0 - 2.f / height, -1.f)) - origin;
+    const QVector3D direction =
+            clipToVolume.map(QVector3D(x0, y0, 1.f)) - origin;
+
+    Camera camera;
+    for (int axis = 0; axis < 3; axis++) {
+        camera.origin[axis] = origin[axis];
+        camera.pixelX[axis] = pixelX[axis];
+        camera.pixelY[axis] = pixelY[axis];
+        camera.direction[axis] = direction[axis];
+    }
+    camera.tStep = samplingStep / direction.length();
+
+    GLubyte* bits = image->bits();
+    const int bytesPerLine = image->bytesPerLine();
+    const int tiles = ((width + TILE_SIZE - 1) / TILE_SIZE) *
+                      ((height + TILE_SIZE - 1) / TILE_SIZE);
+
+    // Tiles differ a lot in cost, the threads claim them one at a time
+    if (threadPool_) {
+        threadPool_->ParallelFor(0, tiles, 1,
+                                 [&] (qint64 firstTile, qint64 lastTile) {
+            for (qint64 tile = firstTile; tile < lastTile; tile++) {
+                RenderTile(camera, bits, bytesPerLine, width, height, tile);
+            }
+        });
+    } else {
+        for (int tile = 0; tile < tiles; tile++) {
+            RenderTile(camera, bits, bytesPerLine, width, height, tile);
+        }
+    }
+}
+
+/**
+ * @brief SoftwareRayCaster::RenderTile
+ * @param camera
+ * @param bits
+ * @param bytesPerLine
+ * @param width
+ * @param height
+ * @param tile
+ */
+void SoftwareRayCaster::RenderTile(const Camera& camera, GLubyte* bits,
+                                   int bytesPerLine, int width, int height,
+                                   int tile) const
+{
+    const int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    const int xBegin = (tile % tilesX) * TILE_SIZE;
+    const int yBegin = (tile / tilesX) * TILE_SIZE;
+    const int xEnd = qMin(xBegin + TILE_SIZE, width);
+    const int yEnd = qMin(yBegin + TILE_SIZE, height);
+
+    for (int y = yBegin; y < yEnd; y++) {
+        GLubyte* row = bits + (qint64) y * bytesPerLine;
+
+#ifdef RAYCASTER_X86_64
+        if (kernel_ == KERNEL_AVX2) {
+            for (int x = xBegin; x < xEnd; x += PACKET_SIZE) {
+                TracePacketAVX2(camera, x, y, qMin(PACKET_SIZE, xEnd - x),
+                                row + 4 * x);
+            }
+            continue;
+        }
+#endif
+
+        for (int x = xBegin; x < xEnd; x++) {
+            TraceScalar(camera, x, y, row + 4 * x);
+        }
+    }
+}
+
+/**
+ * @brief SoftwareRayCaster::TraceScalar
+ * @param camera
+ * @param x
+ * @param y
+ * @param pixel
+ */
+void SoftwareRayCaster::TraceScalar(const Camera& camera, int x, int y,
+                                    GLubyte* pixel) const
+{
+    float origin[3];
+    for (int axis = 0; axis < 3; axis++) {
+        origin[axis] = camera.origin[axis] + x * camera.pixelX[axis] +
+                       y * camera.pixelY[axis];
+    }
+
+    float color[4] = { 0.f, 0.f, 0.f, 0.f };
+
+    float tEnter, tExit;
+    if (ClipRay(origin, camera.direction, &tEnter, &tExit)) {
+        const quint32* volume = (const quint32 *) rgbaVolume_;
+        const qint64 stride[3] = {
+            1, volumeSize_[0], (qint64) volumeSize_[0] * volumeSize_[1]
+        };
+
+        // Samples sit on a grid shared by all rays, t = (s + 0.5) * tStep
+        for (int s = qMax(0, (int) ceil(tEnter / camera.tStep - 0.5f)); ;
+             s++) {
+            const float t = (s + 0.5f) * camera.tStep;
+            if (t >= tExit)
+                break;
+            if (t < tEnter)
+                continue;
+
+            // Jump over the empty cells, landing on the sample grid
+            if (emptySpace_) {
+                const int next = SkipEmptySpace(origin, camera.direction,
+                                                camera.tStep, s);
+                if (next > s) {
+                    s = next - 1;
+                    continue;
+                }
+            }
+
+            // Trilinear sample, texel centres at half-integer coordinates
+            qint64 base = 0;
+            qint64 offset[3];
+            float fraction[3];
+            for (int axis = 0; axis < 3; axis++) {
+                const int size = volumeSize_[axis];
+                const float position = origin[axis] +
+                                       t * camera.direction[axis];
+                const float coordinate = qBound(0.f, position * size - 0.5f,
+                                                size - 1.f);
+                const int lower = qMin((int) coordinate, qMax(size - 2, 0));
+                fraction[axis] = coordinate - lower;
+                base += lower * stride[axis];
+                offset[axis] = (size > 1) ? stride[axis] : 0;
+            }
+
+            quint32 corners[8];
+            for (int c = 0; c < 8; c++) {
+                corners[c] = volume[base + ((c & 1) ? offset[0] : 0) +
+                                           ((c & 2) ? offset[1] : 0) +
+                                           ((c & 4) ? offset[2] : 0)];
+            }
+
+            float sample[4];
+            for (int channel = 0; channel < 4; channel++) {
+                float value[8];
+                for (int c = 0; c < 8; c++) {
+                    value[c] = (corners[c] >> (8 * channel)) & 0xff;
+                }
+
+                const float v00 = Lerp(value[0], value[1], fraction[0]);
+                const float v10 = Lerp(value[2], value[3], fraction[0]);
+                const float v01 = Lerp(value[4], value[5], fraction[0]);
+                const float v11 = Lerp(value[6], value[7], fraction[0]);
+                const float v0 = Lerp(v00, v10, fraction[1]);
+                const float v1 = Lerp(v01, v11, fraction[1]);
+                sample[channel] = Lerp(v0, v1, fraction[2]) *
+                                  (1.f / 255.f);
+            }
+
+            if (sample[3] <= 0.f)
+                continue;
+
+            // Front-to-back compositing of premultiplied samples
+            const int entry = (int) (sample[3] * (CORRECTION_ENTRIES - 1) +
+                                     0.5f);
+            const float weight = (1.f - color[3]) * correctionRatio_[entry];
+            for (int channel = 0; channel < 4; channel++) {
+                color[channel] += weight * sample[channel];
+            }
+
+            // Early ray termination
+            if (color[3] >= terminationOpacity_)
+                break;
+        }
+    }
+
+    for (int channel = 0; channel < 4; channel++) {
+        pixel[channel] = ToByte(color[channel]);
+    }
+}
+
+#ifdef RAYCASTER_X86_64
+
+/**
+ * @brief SoftwareRayCaster::TracePacketAVX2
+ * Same arithmetic as TraceScalar, one ray per lane. The packet advances
+ * along the shared sample grid until every lane left the cube or became
+ * opaque.
+ * @param camera
+ * @param x
+ * @param y
+ * @param lanes
+ * @param pixels
+ */
+RAYCASTER_TARGET_AVX2
+void SoftwareRayCaster::TracePacketAVX2(const Camera& camera, int x, int y,
+                                        int lanes, GLubyte* pixels) const
+{
+    float origin[3][PACKET_SIZE];
+    float enter[PACKET_SIZE];
+    float exit[PACKET_SIZE];
+    int entryStep[PACKET_SIZE];
+    float lastExit = 0.f;
+    int firstStep = INT_MAX;
+
+    for (int lane = 0; lane < PACKET_SIZE; lane++) {
+        float rayOrigin[3];
+        for (int axis = 0; axis < 3; axis++) {
+            rayOrigin[axis] = camera.origin[axis] +
+                              (x + lane) * camera.pixelX[axis] +
+                              y * camera.pixelY[axis];
+            origin[axis][lane] = rayOrigin[axis];
+        }
+
+        // Lanes past the image or missing the cube are never inside
+        if (lane >= lanes ||
+                !ClipRay(rayOrigin, camera.direction, &enter[lane],
+                         &exit[lane])) {
+            enter[lane] = 1.f;
+            exit[lane] = 0.f;
+            continue;
+        }
+
+        lastExit = qMax(lastExit, exit[lane]);
+        entryStep[lane] = qMax(0, (int) ceil(enter[lane] / camera.tStep -
+                                             0.5f));
+        firstStep = qMin(firstStep, entryStep[lane]);
+    }
+
+    __m256 color[4];
+    for (int channel = 0; channel < 4; channel++) {
+        color[channel] = _mm256_setzero_ps();
+    }
+
+    const __m256 tEnter = _mm256_loadu_ps(enter);
+    const __m256 tExit = _mm256_loadu_ps(exit);
+    const __m256 one = _mm256_set1_ps(1.f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 termination = _mm256_set1_ps(terminationOpacity_);
+    const __m256 byteScale = _mm256_set1_ps(1.f / 255.f);
+    const __m256 entryScale = _mm256_set1_ps(CORRECTION_ENTRIES - 1);
+    const __m256i byteMask = _mm256_set1_epi32(0xff);
+    const int* volume = (const int *) rgbaVolume_;
+    const float* ratio = correctionRatio_.constData();
+    bool transparent = true;
+
+    __m256 rayOrigin[3];
+    __m256 direction[3];
+    __m256 size[3];
+    __m256 sizeMinus1[3];
+    __m256i lowerLimit[3];
+    __m256i stride[3];
+    __m256i offset[3];
+    const int strides[3] = {
+        1, volumeSize_[0], volumeSize_[0] * volumeSize_[1]
+    };
+    for (int axis = 0; axis < 3; axis++) {
+        const int extent = volumeSize_[axis];
+        rayOrigin[axis] = _mm256_loadu_ps(origin[axis]);
+        direction[axis] = _mm256_set1_ps(camera.direction[axis]);
+        size[axis] = _mm256_set1_ps(extent);
+        sizeMinus1[axis] = _mm256_set1_ps(extent - 1.f);
+        lowerLimit[axis] = _mm256_set1_epi32(qMax(extent - 2, 0));
+        stride[axis] = _mm256_set1_epi32(strides[axis]);
+        offset[axis] = _mm256_set1_epi32((extent > 1) ? strides[axis] : 0);
+    }
+
+    for (int s = firstStep; firstStep != INT_MAX; s++) {
+        const float tScalar = (s + 0.5f) * camera.tStep;
+        if (tScalar >= lastExit)
+            break;
+        const __m256 t = _mm256_set1_ps(tScalar);
+
+        // Lanes still in the cube and not opaque yet
+        const __m256 alive = _mm256_and_ps(
+                    _mm256_cmp_ps(t, tExit, _CMP_LT_OQ),
+                    _mm256_cmp_ps(color[3], termination, _CMP_LT_OQ));
+        if (_mm256_movemask_ps(alive) == 0)
+            break;
+
+        const __m256 active = _mm256_and_ps(
+                    alive, _mm256_cmp_ps(t, tEnter, _CMP_GE_OQ));
+        if (_mm256_movemask_ps(active) == 0)
+            continue;
+
+        // A sample with some opacity is never in an empty cell, so the
+        // cells are only looked up after a fully transparent step. The
+        // packet jumps as far as its live lanes all can.
+        if (emptySpace_ && transparent) {
+            const int aliveLanes = _mm256_movemask_ps(alive);
+            int next = INT_MAX;
+            for (int lane = 0; lane < lanes && next > s; lane++) {
+                if (!(aliveLanes & (1 << lane)))
+                    continue;
+
+                if (tScalar < enter[lane]) {
+                    next = qMin(next, entryStep[lane]);
+                    continue;
+                }
+
+                const float laneOrigin[3] = {
+                    origin[0][lane], origin[1][lane], origin[2][lane]
+                };
+                next = qMin(next, SkipEmptySpace(laneOrigin, camera.direction,
+                                                 camera.tStep, s));
+            }
+
+            if (next > s) {
+                s = next - 1;
+                continue;
+            }
+        }
+
+        __m256i base = _mm256_setzero_si256();
+        __m256 fraction[3];
+        for (int axis = 0; axis < 3; axis++) {
+            const __m256 position = _mm256_add_ps(
+                        rayOrigin[axis], _mm256_mul_ps(t, direction[axis]));
+            const __m256 coordinate = _mm256_max_ps(zero, _mm256_min_ps(
+                    _mm256_sub_ps(_mm256_mul_ps(position, size[axis]), half),
+                    sizeMinus1[axis]));
+            const __m256i lower = _mm256_min_epi32(
+                        _mm256_cvttps_epi32(coordinate), lowerLimit[axis]);
+            fraction[axis] = _mm256_sub_ps(coordinate,
+                                           _mm256_cvtepi32_ps(lower));
+            base = _mm256_add_epi32(base,
+                                    _mm256_mullo_epi32(lower, stride[axis]));
+        }
+
+        __m256i corners[8];
+        for (int c = 0; c < 8; c++) {
+            __m256i index = base;
+            if (c & 1) index = _mm256_add_epi32(index, offset[0]);
+            if (c & 2) index = _mm256_add_epi32(index, offset[1]);
+            if (c & 4) index = _mm256_add_epi32(index, offset[2]);
+            corners[c] = _mm256_i32gather_epi32(volume, index, 4);
+        }
+
+        __m256 sample[4];
+        for (int channel = 0; channel < 4; channel++) {
+            __m256 value[8];
+            for (int c = 0; c < 8; c++) {
+                value[c] = _mm256_cvtepi32_ps(_mm256_and_si256(
+                        _mm256_srli_epi32(corners[c], 8 * channel),
+                        byteMask));
+            }
+
+            const __m256 fx = fraction[0];
+            const __m256 v00 = _mm256_add_ps(value[0], _mm256_mul_ps(
+                    _mm256_sub_ps(value[1], value[0]), fx));
+            const __m256 v10 = _mm256_add_ps(value[2], _mm256_mul_ps(
+                    _mm256_sub_ps(value[3], value[2]), fx));
+            const __m256 v01 = _mm256_add_ps(value[4], _mm256_mul_ps(
+                    _mm256_sub_ps(value[5], value[4]), fx));
+            const __m256 v11 = _mm256_add_ps(value[6], _mm256_mul_ps(
+                    _mm256_sub_ps(value[7], value[6]), fx));
+            const __m256 v0 = _mm256_add_ps(v00, _mm256_mul_ps(
+                    _mm256_sub_ps(v10, v00), fraction[1]));
+            const __m256 v1 = _mm256_add_ps(v01, _mm256_mul_ps(
+                    _mm256_sub_ps(v11, v01), fraction[1]));
+            sample[channel] = _mm256_mul_ps(_mm256_add_ps(v0, _mm256_mul_ps(
+                    _mm256_sub_ps(v1, v0), fraction[2])), byteScale);
+        }
+
+        // Front-to-back compositing, lanes out of the cube, opaque or on
+        // a transparent sample get a zero weight
+        const __m256 visible = _mm256_and_ps(
+                    active, _mm256_cmp_ps(sample[3], zero, _CMP_GT_OQ));
+        transparent = (_mm256_movemask_ps(visible) == 0);
+        const __m256i entry = _mm256_cvttps_epi32(_mm256_add_ps(
+                    _mm256_mul_ps(sample[3], entryScale), half));
+        const __m256 correction = _mm256_i32gather_ps(ratio, entry, 4);
+        const __m256 weight = _mm256_and_ps(visible, _mm256_mul_ps(
+                    _mm256_sub_ps(one, color[3]), correction));
+        for (int channel = 0; channel < 4; channel++) {
+            color[channel] = _mm256_add_ps(
+                        color[channel],
+                        _mm256_mul_ps(weight, sample[channel]));
+        }
+    }
+
+    float result[4][PACKET_SIZE];
+    for (int channel = 0; channel < 4; channel++) {
+        _mm256_storeu_ps(result[channel], color[channel]);
+    }
+
+    for (int lane = 0; lane < lanes; lane++) {
+        for (int channel = 0; channel < 4; channel++) {
+            pixels[4 * lane + channel] = ToByte(result[channel][lane]);
+        }
+    }
+}
+
+#else
+
+/**
+ * @brief SoftwareRayCaster::TracePacketAVX2
+ * Never selected without x86-64.
+ */
+void SoftwareRayCaster::TracePacketAVX2(const Camera& camera, int x, int y,
+                                        int lanes, GLubyte* pixels) const
+{
+    for (int lane = 0; lane < lanes; lane++) {
+        TraceScalar(camera, x + lane, y, pixels + 4 * lane);
+    }
+}
+
+#endif // RAYCASTER_X86_64
@@ -0,0 +1,236 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef SOFTWARERAYCASTER_H
+#define SOFTWARERAYCASTER_H
+
+#include <QImage>
+#include <QMatrix4x4>
+#include <QVector>
+#include <QtGui/qopengl.h>
+#include "ThreadPool.h"
+#include "MinMaxGrid.h"
+
+/**
+ * @brief The SoftwareRayCaster class
+ * Ray casts a classified RGBA volume into a QImage on the CPU, for hosts
+ * without a GPU. The image is cut into tiles that the threads of the pool
+ * claim one at a time, and every ray is composited front to back with
+ * trilinear sampling and early termination. Blocks of empty cells are
+ * crossed in one jump. The AVX2 kernel traces packets of eight neighbouring
+ * rays together.
+ */
+class SoftwareRayCaster
+{
+public:
+    /**
+     * @brief The Kernel enum
+     */
+    enum Kernel {
+        /** Picked from the CPU features */
+        KERNEL_AUTO,
+
+        /** One ray at a time */
+        KERNEL_SCALAR,
+
+        /** Packets of eight rays */
+        KERNEL_AVX2
+    };
+
+    /**
+     * @brief SoftwareRayCaster
+     */
+    SoftwareRayCaster();
+
+    /**
+     * @brief SetVolume
+     * @param rgbaVolume Classified volume, 4 premultiplied bytes per voxel,
+     * must stay valid while rendering.
+     * @param width
+     * @param height
+     * @param depth
+     */
+    void SetVolume(const GLubyte* rgbaVolume, int width, int height,
+                   int depth);
+
+    /**
+     * @brief SetEmptySpace
+     * @param emptySpace Grid of the volume whose empty cells the rays jump
+     * over, NULL to sample every step. Must stay valid while rendering.
+     */
+    void SetEmptySpace(const MinMaxGrid* emptySpace);
+
+    /**
+     * @brief SetThreadPool
+     * @param threadPool Runs the tiles, NULL to render on the caller.
+     */
+    void SetThreadPool(ThreadPool* threadPool);
+
+    /**
+     * @brief SetKernel
+     * Falls back to the scalar kernel if the CPU cannot run _kernel_.
+     * @param kernel
+     */
+    void SetKernel(Kernel kernel);
+
+    /**
+     * @brief GetKernel
+     * @return
+     */
+    Kernel GetKernel() const;
+
+    /**
+     * @brief GetKernelName
+     * @return
+     */
+    const char* GetKernelName() const;
+
+    /**
+     * @brief SetTerminationOpacity
+     * @param opacity Accumulated opacity at which a ray stops.
+     */
+    void SetTerminationOpacity(float opacity);
+
+    /**
+     * @brief Render
+     * Renders with the same camera as the OpenGL path, the image covers
+     * the clip space of _projection_.
+     * @param projection Eye to clip space.
+     * @param modelView Unit volume cube to eye space.
+     * @param samplingStep Distance between two samples in the unit cube.
+     * @param referenceStep Distance the opacities of the volume are
+     * defined for, used to correct them for the sampling step.
+     * @param image Target, premultiplied RGBA8888.
+     */
+    void Render(const QMatrix4x4& projection, const QMatrix4x4& modelView,
+                float samplingStep, float referenceStep, QImage* image);
+
+    /** \brief Edge of a tile in pixels, a multiple of the packet width */
+    static const int TILE_SIZE = 32;
+
+    /** \brief Rays in a packet */
+    static const int PACKET_SIZE = 8;
+
+    /** \brief Entries of the opacity correction table */
+    static const int CORRECTION_ENTRIES = 1024;
+
+public:
+    /**
+     * @brief The Camera struct
+     * Rays of a frame in the unit volume cube. The ray of pixel (x, y)
+     * starts at origin + x * pixelX + y * pixelY on the near plane and
+     * reaches the far plane at t = 1.
+     */
+    struct Camera
+    {
+        float origin[3];
+        float pixelX[3];
+        float pixelY[3];
+        float direction[3];
+
+        /** \brief Distance between two samples in t */
+        float tStep;
+    };
+
+private:
+    /**
+     * @brief RenderTile
+     * @param camera
+     * @param bits First scanline of the image.
+     * @param bytesPerLine
+     * @param width
+     * @param height
+     * @param tile Tile index, row by row.
+     */
+    void RenderTile(const Camera& camera, GLubyte* bits, int bytesPerLine,
+                    int width, int height, int tile) const;
+
+    /**
+     * @brief TraceScalar
+     * @param camera
+     * @param x
+     * @param y
+     * @param pixel Premultiplied RGBA8 output.
+     */
+    void TraceScalar(const Camera& camera, int x, int y,
+                     GLubyte* pixel) const;
+
+    /**
+     * @brief TracePacketAVX2
+     * @param camera
+     * @param x First pixel of the packet.
+     * @param y
+     * @param lanes Pixels of the packet inside the image.
+     * @param pixels Premultiplied RGBA8 output.
+     */
+    void TracePacketAVX2(const Camera& camera, int x, int y, int lanes,
+                         GLubyte* pixels) const;
+
+    /**
+     * @brief SkipEmptySpace
+     * @param origin
+     * @param direction
+     * @param tStep
+     * @param step Sample index along the ray.
+     * @return _step_ if the sample lies in a non-empty cell, otherwise the
+     * first sample past the block of empty cells around it.
+     */
+    int SkipEmptySpace(const float origin[3], const float direction[3],
+                       float tStep, int step) const;
+
+    /**
+     * @brief ClipRay
+     * Clips a ray to the unit cube.
+     * @param origin
+     * @param direction
+     * @param tEnter
+     * @param tExit
+     * @return False if the ray misses the cube.
+     */
+    static bool ClipRay(const float origin[3], const float direction[3],
+                        float* tEnter, float* tExit);
+
+private:
+    /** \brief Classified volume */
+    const GLubyte* rgbaVolume_;
+
+    /** \brief Volume dimensions */
+    int volumeSize_[3];
+
+    /** \brief Empty cells of the volume, NULL if not skipped */
+    const MinMaxGrid* emptySpace_;
+
+    /** \brief Tile scheduler */
+    ThreadPool* threadPool_;
+
+    /** \brief Selected kernel */
+    Kernel kernel_;
+
+    /** \brief Opacity at which a ray stops */
+    float terminationOpacity_;
+
+    /** \brief Corrected over original opacity, indexed by the original
+     * opacity scaled to CORRECTION_ENTRIES - 1 */
+    QVector<float> correctionRatio_;
+
+    /** \brief Exponent the table was built for */
+    float correctionExponent_;
+};
+
+#endif // SOFTWARERAYCASTER_H
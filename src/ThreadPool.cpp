@@ -0,0 +1,263 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <atomic>
+#include <memory>
+
+/**
+ * @brief The ParallelForState struct
+ * Shared between the caller of ParallelFor and its helper tasks. Helpers
+ * that start after the loop is over still hold a reference, so the state
+ * outlives the call.
+ */
+struct ParallelForState
+{
+    /** \brief Next chunk to hand out */
+    std::atomic<qint64> nextChunk;
+
+    /** \brief Number of chunks that are finished */
+    std::atomic<qint64> doneChunks;
+
+    /** \brief First index */
+    qint64 begin;
+
+    /** \brief One past the last index */
+    qint64 end;
+
+    /** \brief Chunk size */
+    qint64 grain;
+
+    /** \brief Number of chunks */
+    qint64 chunkCount;
+
+    /** \brief Loop body, only valid while the caller waits */
+    const std::function<void (qint64, qint64)>* body;
+
+    /** \brief Guards the completion signal */
+    std::mutex mutex;
+
+    /** \brief Signalled when the last chunk is finished */
+    std::condition_variable finished;
+
+    /**
+     * @brief RunChunks
+     * Processes chunks until none is left.
+     */
+    void RunChunks()
+    {
+        while (true) {
+            const qint64 chunk = nextChunk.fetch_add(1);
+            if (chunk >= chunkCount)
+                return;
+
+            const qint64 chunkBegin = begin + chunk * grain;
+            const qint64 chunkEnd = qMin(end, chunkBegin + grain);
+            (*body)(chunkBegin, chunkEnd);
+
+            if (doneChunks.fetch_add(1) + 1 == chunkCount) {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished.notify_all();
+            }
+        }
+    }
+};
+
+/**
+ * @brief ThreadPool::ThreadPool
+ * @param threadCount
+ */
+ThreadPool::ThreadPool(int threadCount) :
+    activeTasks_(0),
+    stopping_(false)
+{
+    SetThreadCount(threadCount);
+}
+
+/**
+ * @brief ThreadPool::~ThreadPool
+ */
+ThreadPool::~ThreadPool()
+{
+    Stop();
+}
+
+/**
+ * @brief ThreadPool::SetThreadCount
+ * @param threadCount
+ */
+void ThreadPool::SetThreadCount(int threadCount)
+{
+    if (threadCount <= 0)
+        threadCount = qMax(1u, std::thread::hardware_concurrency());
+
+    Stop();
+
+    // The thread calling ParallelFor is one of the threads
+    Start(threadCount - 1);
+}
+
+/**
+ * @brief ThreadPool::GetThreadCount
+ * @return
+ */
+int ThreadPool::GetThreadCount() const
+{
+    return workers_.size() + 1;
+}
+
+/**
+ * @brief ThreadPool::Start
+ * @param workerCount
+ */
+void ThreadPool::Start(int workerCount)
+{
+    stopping_ = false;
+    for (int i = 0; i < workerCount; i++) {
+        workers_.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+    }
+}
+
+/**
+ * @brief ThreadPool::Stop
+ */
+void ThreadPool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    taskAvailable_.notify_all();
+
+    for (size_t i = 0; i < workers_.size(); i++) {
+        workers_[i].join();
+    }
+    workers_.clear();
+}
+
+/**
+ * @brief ThreadPool::WorkerLoop
+ */
+void ThreadPool::WorkerLoop()
+{
+    Trace::SetThreadName("ThreadPool worker");
+
+    while (true) {
+        std::function<void ()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            taskAvailable_.wait(lock, [this] {
+                return stopping_ || !tasks_.empty();
+            });
+
+            // Drain the queue before leaving
+            if (tasks_.empty())
+                return;
+
+            task = tasks_.front();
+            tasks_.pop_front();
+        }
+
+        {
+            TRACE_SCOPE("ThreadPool task");
+            task();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--activeTasks_ == 0)
+            tasksDone_.notify_all();
+    }
+}
+
+/**
+ * @brief ThreadPool::Enqueue
+ * @param task
+ */
+void ThreadPool::Enqueue(const std::function<void ()>& task)
+{
+    // Without workers the caller runs the task itself
+    if (workers_.empty()) {
+        task();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(task);
+        activeTasks_++;
+    }
+    taskAvailable_.notify_one();
+}
+
+/**
+ * @brief ThreadPool::Wait
+ */
+void ThreadPool::Wait()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    tasksDone_.wait(lock, [this] { return activeTasks_ == 0; });
+}
+
+/**
+ * @brief ThreadPool::ParallelFor
+ * @param begin
+ * @param end
+ * @param grain
+ * @param body
+ */
+void ThreadPool::ParallelFor(qint64 begin, qint64 end, qint64 grain,
+                             const std::function<void (qint64, qint64)>& body)
+{
+    if (end <= begin)
+        return;
+
+    grain = qMax(grain, (qint64) 1);
+    const qint64 chunkCount = (end - begin + grain - 1) / grain;
+
+    // A single chunk is not worth waking anybody up
+    if (chunkCount == 1 || workers_.empty()) {
+        for (qint64 i = begin; i < end; i += grain) {
+            body(i, qMin(end, i + grain));
+        }
+        return;
+    }
+
+    std::shared_ptr<ParallelForState> state(new ParallelForState);
+    state->nextChunk = 0;
+    state->doneChunks = 0;
+    state->begin = begin;
+    state->end = end;
+    state->grain = grain;
+    state->chunkCount = chunkCount;
+    state->body = &body;
+
+    const qint64 helperCount = qMin((qint64) workers_.size(), chunkCount - 1);
+    for (qint64 i = 0; i < helperCount; i++) {
+        Enqueue([state] { state->RunChunks(); });
+    }
+
+    state->RunChunks();
+
+    // Wait for the chunks the helpers picked up, not for the helpers
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&state] {
+        return state->doneChunks == state->chunkCount;
+    });
+}
@@ -0,0 +1,131 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <QtGlobal>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief The ThreadPool class
+ * A fixed set of worker threads that is created once and reused for every
+ * parallel stage of the application.
+ */
+class ThreadPool
+{
+public:
+    /**
+     * @brief ThreadPool
+     * @param threadCount Number of threads, 0 for one per hardware thread.
+     */
+    explicit ThreadPool(int threadCount = 0);
+
+    /**
+     * @brief ~ThreadPool
+     * Finishes the queued tasks and joins the workers.
+     */
+    ~ThreadPool();
+
+    /**
+     * @brief SetThreadCount
+     * Replaces the workers, must not be called while tasks are running.
+     * @param threadCount Number of threads, 0 for one per hardware thread.
+     */
+    void SetThreadCount(int threadCount);
+
+    /**
+     * @brief GetThreadCount
+     * @return Number of threads taking part in ParallelFor, including the
+     * calling thread.
+     */
+    int GetThreadCount() const;
+
+    /**
+     * @brief Enqueue
+     * Runs _task_ on one of the workers.
+     * @param task
+     */
+    void Enqueue(const std::function<void ()>& task);
+
+    /**
+     * @brief Wait
+     * Blocks until every task queued so far has finished.
+     */
+    void Wait();
+
+    /**
+     * @brief ParallelFor
+     * Splits [begin, end) into chunks of _grain_ and calls _body_ with each
+     * chunk. Chunks are handed out dynamically and the calling thread works
+     * on them as well, so this is safe to call from inside a task.
+     * @param begin
+     * @param end
+     * @param grain
+     * @param body Called as body(chunkBegin, chunkEnd).
+     */
+    void ParallelFor(qint64 begin, qint64 end, qint64 grain,
+                     const std::function<void (qint64, qint64)>& body);
+
+private:
+    /**
+     * @brief Start
+     * @param workerCount
+     */
+    void Start(int workerCount);
+
+    /**
+     * @brief Stop
+     */
+    void Stop();
+
+    /**
+     * @brief WorkerLoop
+     */
+    void WorkerLoop();
+
+private:
+    /** \brief Worker threads */
+    std::vector<std::thread> workers_;
+
+    /** \brief Pending tasks */
+    std::deque< std::function<void ()> > tasks_;
+
+    /** \brief Guards _tasks_, _activeTasks_ and _stopping_ */
+    std::mutex mutex_;
+
+    /** \brief Signalled when a task is queued or the pool stops */
+    std::condition_variable taskAvailable_;
+
+    /** \brief Signalled when the pool runs out of work */
+    std::condition_variable tasksDone_;
+
+    /** \brief Number of tasks that are queued or running */
+    int activeTasks_;
+
+    /** \brief Set to make the workers exit */
+    bool stopping_;
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,233 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "Trace.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> Trace::enabled_(false);
+
+/**
+ * @brief The TraceEvent struct
+ * A recorded span.
+ */
+struct TraceEvent
+{
+    const char* name;
+    qint64 begin;
+    qint64 end;
+};
+
+/**
+ * @brief The TraceBlock struct
+ * Fixed-size chunk of the events of a thread. Only the owning thread
+ * writes, and publishes each event by incrementing _count_, so a reader
+ * never sees a half-written event nor a reallocated array.
+ */
+struct TraceBlock
+{
+    static const int CAPACITY = 4096;
+
+    TraceEvent events[CAPACITY];
+    std::atomic<int> count;
+    std::atomic<TraceBlock*> next;
+
+    TraceBlock() : count(0), next(NULL) { }
+};
+
+/**
+ * @brief The TraceThread struct
+ * Events of a thread, registered once per thread and never freed so that
+ * the events of finished threads can still be written.
+ */
+struct TraceThread
+{
+    int id;
+    std::atomic<const char*> name;
+    TraceBlock* first;
+    TraceBlock* last;
+
+    TraceThread(int threadId) :
+        id(threadId), name(NULL), first(new TraceBlock()), last(first) { }
+};
+
+/** \brief Output file */
+static std::string traceFileName;
+
+/** \brief Time origin of the trace */
+static std::chrono::steady_clock::time_point traceStart;
+
+/** \brief Guards _traceThreads_, only taken once per thread */
+static std::mutex traceThreadsMutex;
+
+/** \brief Every thread that recorded something */
+static std::vector<TraceThread*> traceThreads;
+
+/**
+ * @brief CurrentTraceThread
+ * @return Buffer of the calling thread, registered on first use.
+ */
+static TraceThread* CurrentTraceThread()
+{
+    static thread_local TraceThread* thread = NULL;
+    if (!thread) {
+        std::lock_guard<std::mutex> lock(traceThreadsMutex);
+        thread = new TraceThread(traceThreads.size() + 1);
+        traceThreads.push_back(thread);
+    }
+    return thread;
+}
+
+/**
+ * @brief WriteJsonString
+ * @param file
+ * @param text
+ */
+static void WriteJsonString(FILE* file, const char* text)
+{
+    fputc('"', file);
+    for (const char* c = text; *c; c++) {
+        if (*c == '"' || *c == '\\')
+            fputc('\\', file);
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+/**
+ * @brief Trace::Enable
+ * @param fileName
+ */
+void Trace::Enable(const std::string& fileName)
+{
+    traceFileName = fileName;
+    traceStart = std::chrono::steady_clock::now();
+    enabled_.store(true);
+}
+
+/**
+ * @brief Trace::EnableFromEnvironment
+ */
+void Trace::EnableFromEnvironment()
+{
+    const char* fileName = getenv("VOLUME_SLICER_TRACE");
+    if (fileName && *fileName)
+        Enable(fileName);
+}
+
+/**
+ * @brief Trace::Now
+ * @return
+ */
+qint64 Trace::Now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - traceStart).count();
+}
+
+/**
+ * @brief Trace::AddSpan
+ * @param name
+ * @param begin
+ * @param end
+ */
+void Trace::AddSpan(const char* name, qint64 begin, qint64 end)
+{
+    TraceThread* thread = CurrentTraceThread();
+
+    TraceBlock* block = thread->last;
+    int index = block->count.load(std::memory_order_relaxed);
+    if (index == TraceBlock::CAPACITY) {
+        TraceBlock* next = new TraceBlock();
+        block->next.store(next, std::memory_order_release);
+        thread->last = block = next;
+        index = 0;
+    }
+
+    TraceEvent& event = block->events[index];
+    event.name = name;
+    event.begin = begin;
+    event.end = end;
+    block->count.store(index + 1, std::memory_order_release);
+}
+
+/**
+ * @brief Trace::SetThreadName
+ * @param name
+ */
+void Trace::SetThreadName(const char* name)
+{
+    if (IsEnabled())
+        CurrentTraceThread()->name.store(name, std::memory_order_release);
+}
+
+/**
+ * @brief Trace::Write
+ * @return
+ */
+bool Trace::Write()
+{
+    if (!IsEnabled())
+        return true;
+
+    FILE* file = fopen(traceFileName.c_str(), "w");
+    if (!file)
+        return false;
+
+    std::lock_guard<std::mutex> lock(traceThreadsMutex);
+
+    // Complete events, one per span, and the thread names as metadata
+    fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+    for (size_t t = 0; t < traceThreads.size(); t++) {
+        const TraceThread* thread = traceThreads[t];
+
+        const char* name = thread->name.load(std::memory_order_acquire);
+        if (name) {
+            fprintf(file, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                    "\"name\":\"thread_name\",\"args\":{\"name\":",
+                    first ? "" : ",\n", thread->id);
+            WriteJsonString(file, name);
+            fprintf(file, "}}");
+            first = false;
+        }
+
+        for (const TraceBlock* block = thread->first; block;
+             block = block->next.load(std::memory_order_acquire)) {
+            const int count = block->count.load(std::memory_order_acquire);
+            for (int i = 0; i < count; i++) {
+                const TraceEvent& event = block->events[i];
+                fprintf(file, "%s{\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                        "\"ts\":%lld,\"dur\":%lld,\"name\":",
+                        first ? "" : ",\n", thread->id,
+                        (long long) event.begin,
+                        (long long) (event.end - event.begin));
+                WriteJsonString(file, event.name);
+                fprintf(file, "}");
+                first = false;
+            }
+        }
+    }
+    fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+    return fclose(file) == 0;
+}
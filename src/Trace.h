@@ -0,0 +1,135 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <string>
+
+/**
+ * @brief The Trace class
+ * Records scoped spans into per-thread buffers and writes them as Chrome
+ * trace-event JSON, which chrome://tracing and Perfetto display. A thread
+ * appends to its own buffer without locking, and a span costs a single
+ * relaxed load when tracing is disabled.
+ */
+class Trace
+{
+public:
+    /**
+     * @brief Enable
+     * Starts recording, the spans are written to _fileName_ by Write.
+     * @param fileName
+     */
+    static void Enable(const std::string& fileName);
+
+    /**
+     * @brief EnableFromEnvironment
+     * Enables tracing if VOLUME_SLICER_TRACE names an output file.
+     */
+    static void EnableFromEnvironment();
+
+    /**
+     * @brief IsEnabled
+     * @return
+     */
+    static bool IsEnabled()
+    {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Now
+     * @return Microseconds since tracing was enabled.
+     */
+    static qint64 Now();
+
+    /**
+     * @brief AddSpan
+     * Records a span of the calling thread.
+     * @param name Must outlive the trace, typically a string literal.
+     * @param begin Microseconds, from Now.
+     * @param end Microseconds, from Now.
+     */
+    static void AddSpan(const char* name, qint64 begin, qint64 end);
+
+    /**
+     * @brief SetThreadName
+     * Names the calling thread in the trace.
+     * @param name Must outlive the trace, typically a string literal.
+     */
+    static void SetThreadName(const char* name);
+
+    /**
+     * @brief Write
+     * Writes the spans recorded so far, must not race with the threads that
+     * are still recording.
+     * @return False if the file could not be written.
+     */
+    static bool Write();
+
+private:
+    /** \brief Spans are recorded */
+    static std::atomic<bool> enabled_;
+};
+
+/**
+ * @brief The TraceScope class
+ * Records a span from its construction to its destruction.
+ */
+class TraceScope
+{
+public:
+    /**
+     * @brief TraceScope
+     * @param name Must outlive the trace, typically a string literal.
+     */
+    explicit TraceScope(const char* name) :
+        name_(name),
+        begin_(Trace::IsEnabled() ? Trace::Now() : -1)
+    {
+    }
+
+    /**
+     * @brief ~TraceScope
+     */
+    ~TraceScope()
+    {
+        if (begin_ >= 0)
+            Trace::AddSpan(name_, begin_, Trace::Now());
+    }
+
+private:
+    /** \brief Span name */
+    const char* name_;
+
+    /** \brief Start in microseconds, -1 when not tracing */
+    qint64 begin_;
+};
+
+#define TRACE_CONCATENATE_(a, b) a ## b
+#define TRACE_CONCATENATE(a, b) TRACE_CONCATENATE_(a, b)
+
+/** \brief Records a span until the end of the enclosing block */
+#define TRACE_SCOPE(name) \
+    TraceScope TRACE_CONCATENATE(traceScope, __LINE__)(name)
+
+#endif // TRACE_H
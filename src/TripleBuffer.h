@@ -0,0 +1,109 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+/**
+ * @brief The TripleBuffer class
+ * Hands values from one writer thread to one reader thread without locks.
+ * The writer fills a slot of its own and swaps it with the shared slot,
+ * the reader swaps its slot with the shared one when it holds a newer
+ * value. Neither side ever waits, and the reader always gets the latest
+ * complete value; values published in between are dropped.
+ */
+template <typename T>
+class TripleBuffer
+{
+public:
+    /**
+     * @brief TripleBuffer
+     */
+    TripleBuffer() :
+        shared_(1),
+        back_(0),
+        front_(2)
+    {
+    }
+
+    /**
+     * @brief Publish
+     * Writer side.
+     * @param value
+     */
+    void Publish(const T& value)
+    {
+        slots_[back_] = value;
+
+        // Hand the slot over flagged as new and take back the one that was
+        // shared
+        back_ = shared_.exchange(back_ | NEW_VALUE,
+                                 std::memory_order_acq_rel) & SLOT_MASK;
+    }
+
+    /**
+     * @brief Update
+     * Reader side, takes the latest value if one was published since the
+     * last call.
+     * @return True if Read returns a new value.
+     */
+    bool Update()
+    {
+        if (!(shared_.load(std::memory_order_relaxed) & NEW_VALUE))
+            return false;
+
+        front_ = shared_.exchange(front_, std::memory_order_acq_rel) &
+                SLOT_MASK;
+        return true;
+    }
+
+    /**
+     * @brief Read
+     * Reader side.
+     * @return The value taken by the last Update, a default-constructed
+     * one before.
+     */
+    const T& Read() const
+    {
+        return slots_[front_];
+    }
+
+private:
+    /** \brief Index bits of _shared_ */
+    static const int SLOT_MASK = 3;
+
+    /** \brief Set in _shared_ while the reader has not taken the value */
+    static const int NEW_VALUE = 4;
+
+    /** \brief Writer, shared and reader slots, in changing order */
+    T slots_[3];
+
+    /** \brief Index of the shared slot and the new-value flag */
+    std::atomic<int> shared_;
+
+    /** \brief Slot written by the writer */
+    int back_;
+
+    /** \brief Slot read by the reader */
+    int front_;
+};
+
+#endif // TRIPLEBUFFER_H
@@ -0,0 +1,496 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "VolumeClassifier.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CLASSIFIER_X86_64
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define CLASSIFIER_NEON
+#include <arm_neon.h>
+#endif
+
+// The AVX2 kernel is compiled for AVX2 on its own and only ever called
+// after the runtime check, so the rest of the binary stays at the baseline
+// instruction set.
+#if defined(__GNUC__) || defined(__clang__)
+#define CLASSIFIER_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CLASSIFIER_TARGET_AVX2
+#endif
+
+/**
+ * @brief LookupScalar
+ * @param table
+ * @param raw
+ * @param rgba
+ * @param count
+ */
+static void LookupScalar(const quint32* table,
+                         const GLubyte* raw, GLubyte* rgba, qint64 count)
+{
+    for (qint64 i = 0; i < count; i++) {
+        memcpy(rgba + 4 * i, &table[raw[i]], 4);
+    }
+}
+
+#ifdef CLASSIFIER_X86_64
+
+/**
+ * @brief LookupSSE2
+ * @param table
+ * @param raw
+ * @param rgba
+ * @param count
+ */
+static void LookupSSE2(const quint32* table,
+                       const GLubyte* raw, GLubyte* rgba, qint64 count)
+{
+    qint64 i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i texels = _mm_set_epi32(table[raw[i + 3]],
+                                             table[raw[i + 2]],
+                                             table[raw[i + 1]],
+                                             table[raw[i]]);
+        _mm_storeu_si128((__m128i *) (rgba + 4 * i), texels);
+    }
+
+    LookupScalar(table, raw + i, rgba + 4 * i, count - i);
+}
+
+/**
+ * @brief LookupAVX2
+ * @param table
+ * @param raw
+ * @param rgba
+ * @param count
+ */
+CLASSIFIER_TARGET_AVX2
+static void LookupAVX2(const quint32* table,
+                       const GLubyte* raw, GLubyte* rgba, qint64 count)
+{
+    const int* base = (const int *) table;
+
+    qint64 i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i bytes = _mm_loadu_si128((const __m128i *) (raw + i));
+
+        const __m256i lo = _mm256_cvtepu8_epi32(bytes);
+        const __m256i hi = _mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8));
+
+        _mm256_storeu_si256((__m256i *) (rgba + 4 * i),
+                            _mm256_i32gather_epi32(base, lo, 4));
+        _mm256_storeu_si256((__m256i *) (rgba + 4 * i + 32),
+                            _mm256_i32gather_epi32(base, hi, 4));
+    }
+
+    LookupScalar(table, raw + i, rgba + 4 * i, count - i);
+}
+
+#endif // CLASSIFIER_X86_64
+
+#ifdef CLASSIFIER_NEON
+
+/**
+ * @brief LookupNEON
+ * Each channel is looked up with four 64-byte table shuffles. Indices that
+ * fall outside a quarter of the table read back zero, so the four partial
+ * results can simply be OR-ed together.
+ * @param planarTable
+ * @param table
+ * @param raw
+ * @param rgba
+ * @param count
+ */
+static void LookupNEON(const GLubyte planarTable[4][256], const quint32* table,
+                       const GLubyte* raw, GLubyte* rgba, qint64 count)
+{
+    uint8x16x4_t quarters[4][4];
+    for (int c = 0; c < 4; c++) {
+        for (int q = 0; q < 4; q++) {
+            quarters[c][q] = vld1q_u8_x4(planarTable[c] + 64 * q);
+        }
+    }
+
+    const uint8x16_t offset = vdupq_n_u8(64);
+
+    qint64 i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const uint8x16_t index0 = vld1q_u8(raw + i);
+        const uint8x16_t index1 = vsubq_u8(index0, offset);
+        const uint8x16_t index2 = vsubq_u8(index1, offset);
+        const uint8x16_t index3 = vsubq_u8(index2, offset);
+
+        uint8x16x4_t texels;
+        for (int c = 0; c < 4; c++) {
+            texels.val[c] = vorrq_u8(
+                        vorrq_u8(vqtbl4q_u8(quarters[c][0], index0),
+                                 vqtbl4q_u8(quarters[c][1], index1)),
+                        vorrq_u8(vqtbl4q_u8(quarters[c][2], index2),
+                                 vqtbl4q_u8(quarters[c][3], index3)));
+        }
+
+        vst4q_u8(rgba + 4 * i, texels);
+    }
+
+    LookupScalar(table, raw + i, rgba + 4 * i, count - i);
+}
+
+#endif // CLASSIFIER_NEON
+
+/**
+ * @brief ClassifyVoxel
+ * The original per-voxel transfer function.
+ * @param v
+ * @param threshold
+ * @param rgba
+ */
+static inline void ClassifyVoxel(GLubyte v, GLubyte threshold, GLubyte* rgba)
+{
+    GLubyte val = (v < threshold) ? 0 : v - threshold;
+    val = val >> 1;
+    rgba[0] = val;
+    rgba[1] = ((float)val) * 0.93;
+    rgba[2] = ((float)val) * 0.78;
+    rgba[3] = val;
+}
+
+/**
+ * @brief VolumeClassifier::VolumeClassifier
+ */
+VolumeClassifier::VolumeClassifier() :
+    kernel_(KERNEL_SCALAR),
+    threshold_(DEFAULT_THRESHOLD)
+{
+    BuildLookupTable();
+    SetKernel(KERNEL_AUTO);
+}
+
+/**
+ * @brief VolumeClassifier::BuildLookupTable
+ */
+void VolumeClassifier::BuildLookupTable()
+{
+    for (int v = 0; v < 256; v++) {
+        GLubyte rgba[4];
+        ClassifyVoxel(v, threshold_, rgba);
+
+        memcpy(&lookupTable_[v], rgba, 4);
+        for (int c = 0; c < 4; c++) {
+            planarTable_[c][v] = rgba[c];
+        }
+    }
+}
+
+/**
+ * @brief VolumeClassifier::SetThreshold
+ * @param threshold
+ */
+void VolumeClassifier::SetThreshold(int threshold)
+{
+    threshold_ = qBound(0, threshold, 255);
+    BuildLookupTable();
+}
+
+/**
+ * @brief VolumeClassifier::GetThreshold
+ * @return
+ */
+int VolumeClassifier::GetThreshold() const
+{
+    return threshold_;
+}
+
+/**
+ * @brief VolumeClassifier::CpuSupportsAVX2
+ * @return
+ */
+bool VolumeClassifier::CpuSupportsAVX2()
+{
+#if !defined(CLASSIFIER_X86_64)
+    return false;
+#elif defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    // The OS has to save the YMM registers as well
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!osxsave || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief VolumeClassifier::SetKernel
+ * @param kernel
+ */
+void VolumeClassifier::SetKernel(Kernel kernel)
+{
+    if (kernel == KERNEL_AUTO) {
+#if defined(CLASSIFIER_NEON)
+        kernel = KERNEL_NEON;
+#elif defined(CLASSIFIER_X86_64)
+        kernel = CpuSupportsAVX2() ? KERNEL_AVX2 : KERNEL_SSE2;
+#else
+        kernel = KERNEL_SCALAR;
+#endif
+    }
+
+    switch (kernel) {
+#ifdef CLASSIFIER_X86_64
+    case KERNEL_SSE2:
+        break;
+    case KERNEL_AVX2:
+        if (!CpuSupportsAVX2())
+            kernel = KERNEL_SCALAR;
+        break;
+#endif
+#ifdef CLASSIFIER_NEON
+    case KERNEL_NEON:
+        break;
+#endif
+    default:
+        kernel = KERNEL_SCALAR;
+        break;
+    }
+
+    kernel_ = kernel;
+}
+
+/**
+ * @brief VolumeClassifier::GetKernel
+ * @return
+ */
+VolumeClassifier::Kernel VolumeClassifier::GetKernel() const
+{
+    return kernel_;
+}
+
+/**
+ * @brief VolumeClassifier::GetKernelName
+ * @return
+ */
+const char* VolumeClassifier::GetKernelName() const
+{
+    switch (kernel_) {
+    case KERNEL_SSE2:
+        return "SSE2";
+    case KERNEL_AVX2:
+        return "AVX2";
+    case KERNEL_NEON:
+        return "NEON";
+    default:
+        return "scalar";
+    }
+}
+
+/**
+ * @brief VolumeClassifier::GetLookupTable
+ * @return
+ */
+const GLubyte* VolumeClassifier::GetLookupTable() const
+{
+    return (const GLubyte *) lookupTable_;
+}
+
+/**
+ * @brief VolumeClassifier::LookupSpan
+ * @param raw
+ * @param rgba
+ * @param count
+ */
+void VolumeClassifier::LookupSpan(const GLubyte* raw, GLubyte* rgba,
+                                  qint64 count) const
+{
+    switch (kernel_) {
+#ifdef CLASSIFIER_X86_64
+    case KERNEL_SSE2:
+        LookupSSE2(lookupTable_, raw, rgba, count);
+        break;
+    case KERNEL_AVX2:
+        LookupAVX2(lookupTable_, raw, rgba, count);
+        break;
+#endif
+#ifdef CLASSIFIER_NEON
+    case KERNEL_NEON:
+        LookupNEON(planarTable_, lookupTable_, raw, rgba, count);
+        break;
+#endif
+    default:
+        LookupScalar(lookupTable_, raw, rgba, count);
+        break;
+    }
+}
+
+/**
+ * @brief VolumeClassifier::Classify
+ * @param raw
+ * @param rgba
+ * @param count
+ */
+void VolumeClassifier::Classify(const GLubyte* raw, GLubyte* rgba,
+                                qint64 count) const
+{
+    LookupSpan(raw, rgba, count);
+}
+
+/**
+ * @brief VolumeClassifier::FillSpan
+ * @param rgba
+ * @param count
+ */
+void VolumeClassifier::FillSpan(GLubyte* rgba, qint64 count) const
+{
+    const quint32 texel = lookupTable_[OUTLINE_VALUE];
+    for (qint64 i = 0; i < count; i++) {
+        memcpy(rgba + 4 * i, &texel, 4);
+    }
+}
+
+/**
+ * @brief VolumeClassifier::ClassifyRows
+ * A voxel is on the outline when at least two of its coordinates are in
+ * the outline band, so a row is either fully on it (both y and z in the
+ * band), has only its first and last four voxels on it (one of them), or
+ * does not touch it at all.
+ * @param rawVolume
+ * @param rgbaVolume
+ * @param width
+ * @param height
+ * @param depth
+ * @param firstRow
+ * @param lastRow
+ */
+void VolumeClassifier::ClassifyRows(const GLubyte* rawVolume,
+                                    GLubyte* rgbaVolume,
+                                    int width, int height, int depth,
+                                    qint64 firstRow, qint64 lastRow) const
+{
+    const int band = qMin(OUTLINE_WIDTH, width);
+
+    qint64 row = firstRow;
+    while (row < lastRow) {
+        const qint64 z = row / height;
+        const bool zInBand = InOutlineBand(z, depth);
+
+        // Process the rows of this slice that are in the range
+        const qint64 sliceEnd = qMin(lastRow, (z + 1) * height);
+
+        // Look up the runs of rows between the rows fully on the outline
+        qint64 runBegin = row;
+        for (qint64 r = row; r < sliceEnd && zInBand; r++) {
+            if (!InOutlineBand(r - z * height, height))
+                continue;
+
+            LookupSpan(rawVolume + runBegin * width,
+                       rgbaVolume + 4 * runBegin * width,
+                       (r - runBegin) * width);
+            FillSpan(rgbaVolume + 4 * r * width, width);
+            runBegin = r + 1;
+        }
+        LookupSpan(rawVolume + runBegin * width,
+                   rgbaVolume + 4 * runBegin * width,
+                   (sliceEnd - runBegin) * width);
+
+        // Paint the first and last voxels of the rows that have exactly one
+        // coordinate in the band
+        for (qint64 r = row; r < sliceEnd; r++) {
+            if (zInBand == InOutlineBand(r - z * height, height))
+                continue;
+
+            GLubyte* rgbaRow = rgbaVolume + 4 * r * width;
+            FillSpan(rgbaRow, band);
+            FillSpan(rgbaRow + 4 * (width - band), band);
+        }
+
+        row = sliceEnd;
+    }
+}
+
+/**
+ * @brief VolumeClassifier::ClassifyReference
+ * @param rawVolume
+ * @param rgbaVolume
+ * @param width
+ * @param height
+ * @param depth
+ */
+void VolumeClassifier::ClassifyReference(const GLubyte* rawVolume,
+                                         GLubyte* rgbaVolume,
+                                         int width, int height,
+                                         int depth) const
+{
+    const GLubyte *ptr = rawVolume;
+    GLubyte *qtr = rgbaVolume;
+    for (int i = 0; i < depth; i++) {
+        for (int j = 0; j < height; j++) {
+            for (int k = 0; k < width; k++) {
+                GLubyte v = *(ptr++);
+                if (((i < 4) && (j < 4)) ||
+                        ((j < 4) && (k < 4)) ||
+                        ((k < 4) && (i < 4)) ||
+                        ((i < 4) && (j >  height-5)) ||
+                        ((j < 4) && (k > width-5)) ||
+                        ((k < 4) && (i > depth-5)) ||
+                        ((i > depth-5) && (j >  height-5)) ||
+                        ((j >  height-5) && (k > width-5)) ||
+                        ((k > width-5) && (i > depth-5)) ||
+                        ((i > depth-5) && (j < 4)) ||
+                        ((j >  height-5) && (k < 4)) ||
+                        ((k > width-5) && (i < 4))) {
+                    v = OUTLINE_VALUE;
+                }
+                ClassifyVoxel(v, threshold_, qtr);
+                qtr += 4;
+            }
+        }
+    }
+}
+
+/**
+ * @brief VolumeClassifier::ClassifyReference
+ * @param raw
+ * @param rgba
+ * @param count
+ */
+void VolumeClassifier::ClassifyReference(const GLubyte* raw, GLubyte* rgba,
+                                         qint64 count) const
+{
+    for (qint64 i = 0; i < count; i++) {
+        ClassifyVoxel(raw[i], threshold_, rgba + 4 * i);
+    }
+}
@@ -0,0 +1,213 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef VOLUMECLASSIFIER_H
+#define VOLUMECLASSIFIER_H
+
+#include <QtGlobal>
+#include <QtGui/qopengl.h>
+
+/**
+ * @brief The VolumeClassifier class
+ * Expands an 8-bit scalar volume into an RGBA volume through a 256-entry
+ * lookup table and paints the 4-voxel bounding-box outline on the fly.
+ */
+class VolumeClassifier
+{
+public:
+    /**
+     * @brief The Kernel enum
+     * Implementation used for the table lookup.
+     */
+    enum Kernel {
+        /** Pick the fastest kernel the CPU supports */
+        KERNEL_AUTO,
+
+        /** Plain C++ table lookup */
+        KERNEL_SCALAR,
+
+        /** x86-64 SSE2, four voxels per store */
+        KERNEL_SSE2,
+
+        /** x86-64 AVX2, eight voxels per gather */
+        KERNEL_AVX2,
+
+        /** AArch64 NEON, sixteen voxels per table shuffle */
+        KERNEL_NEON
+    };
+
+    /**
+     * @brief VolumeClassifier
+     */
+    VolumeClassifier();
+
+    /**
+     * @brief SetThreshold
+     * Scalars below the threshold are transparent, the ones above it ramp
+     * up from there. Rebuilds the lookup table.
+     * @param threshold
+     */
+    void SetThreshold(int threshold);
+
+    /**
+     * @brief GetThreshold
+     * @return
+     */
+    int GetThreshold() const;
+
+    /**
+     * @brief SetKernel
+     * Selects the lookup kernel. Kernels that are not supported by the CPU
+     * or the build fall back to the scalar one.
+     * @param kernel
+     */
+    void SetKernel(Kernel kernel);
+
+    /**
+     * @brief GetKernel
+     * @return The kernel in use, never KERNEL_AUTO.
+     */
+    Kernel GetKernel() const;
+
+    /**
+     * @brief GetKernelName
+     * @return Printable name of the kernel in use.
+     */
+    const char* GetKernelName() const;
+
+    /**
+     * @brief GetLookupTable
+     * @return 256 RGBA entries, 4 bytes each.
+     */
+    const GLubyte* GetLookupTable() const;
+
+    /**
+     * @brief CpuSupportsAVX2
+     * @return True if AVX2 code can run on this CPU and operating system.
+     */
+    static bool CpuSupportsAVX2();
+
+    /**
+     * @brief ClassifyRows
+     * Classifies the rows [firstRow, lastRow) of the volume, a row being
+     * _width_ voxels at a fixed (y, z). Both pointers address the whole
+     * volume, so disjoint row ranges can be classified concurrently.
+     * @param rawVolume
+     * @param rgbaVolume
+     * @param width
+     * @param height
+     * @param depth
+     * @param firstRow
+     * @param lastRow
+     */
+    void ClassifyRows(const GLubyte* rawVolume, GLubyte* rgbaVolume,
+                      int width, int height, int depth,
+                      qint64 firstRow, qint64 lastRow) const;
+
+    /**
+     * @brief Classify
+     * Runs the lookup over _count_ contiguous voxels, without the outline.
+     * @param raw
+     * @param rgba
+     * @param count
+     */
+    void Classify(const GLubyte* raw, GLubyte* rgba, qint64 count) const;
+
+    /**
+     * @brief InOutlineBand
+     * @param index
+     * @param size
+     * @return True if _index_ lies in the first or last four voxels of an
+     * axis of _size_ voxels.
+     */
+    static bool InOutlineBand(qint64 index, int size)
+    {
+        return (index < OUTLINE_WIDTH) || (index > size - OUTLINE_WIDTH - 1);
+    }
+
+    /**
+     * @brief ClassifyReference
+     * Voxel-by-voxel reference of ClassifyRows over the whole volume, kept
+     * to check the vectorized kernels bit for bit.
+     * @param rawVolume
+     * @param rgbaVolume
+     * @param width
+     * @param height
+     * @param depth
+     */
+    void ClassifyReference(const GLubyte* rawVolume, GLubyte* rgbaVolume,
+                           int width, int height, int depth) const;
+
+    /**
+     * @brief ClassifyReference
+     * Voxel-by-voxel reference of Classify, without the outline.
+     * @param raw
+     * @param rgba
+     * @param count
+     */
+    void ClassifyReference(const GLubyte* raw, GLubyte* rgba,
+                           qint64 count) const;
+
+    /** \brief Scalar value painted on the bounding-box outline */
+    static const GLubyte OUTLINE_VALUE = 110;
+
+    /** \brief Thickness of the bounding-box outline in voxels */
+    static const int OUTLINE_WIDTH = 4;
+
+    /** \brief Transparency threshold of the original transfer function */
+    static const int DEFAULT_THRESHOLD = 64;
+
+private:
+    /**
+     * @brief BuildLookupTable
+     */
+    void BuildLookupTable();
+
+    /**
+     * @brief LookupSpan
+     * Runs the selected kernel over _count_ contiguous voxels.
+     * @param raw
+     * @param rgba
+     * @param count
+     */
+    void LookupSpan(const GLubyte* raw, GLubyte* rgba, qint64 count) const;
+
+    /**
+     * @brief FillSpan
+     * Writes the classified outline value over _count_ voxels.
+     * @param rgba
+     * @param count
+     */
+    void FillSpan(GLubyte* rgba, qint64 count) const;
+
+private:
+    /** \brief Interleaved RGBA table, 4-byte aligned for 32-bit loads */
+    quint32 lookupTable_[256];
+
+    /** \brief One table per channel for the byte-shuffle kernel */
+    GLubyte planarTable_[4][256];
+
+    /** \brief Kernel in use */
+    Kernel kernel_;
+
+    /** \brief Transparency threshold */
+    GLubyte threshold_;
+};
+
+#endif // VOLUMECLASSIFIER_H
@@ -0,0 +1,258 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "VolumeFile.h"
+#include "Trace.h"
+#include <fstream>
+#include <string.h>
+#include <QDebug>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#endif
+
+/**
+ * @brief VolumeFile::VolumeFile
+ */
+VolumeFile::VolumeFile() :
+    mappedData_(NULL),
+    streamedData_(NULL),
+    size_(0) { }
+
+/**
+ * @brief VolumeFile::~VolumeFile
+ */
+VolumeFile::~VolumeFile()
+{
+    Close();
+}
+
+/**
+ * @brief VolumeFile::Open
+ * @param filePath
+ * @param size
+ * @param loadMode
+ * @param accessPattern
+ * @return
+ */
+bool VolumeFile::Open(const char* filePath, qint64 size, LoadMode loadMode,
+                      AccessPattern accessPattern)
+{
+    // Release anything that was opened before
+    Close();
+
+    file_.setFileName(QString::fromLocal8Bit(filePath));
+    if (!file_.open(QIODevice::ReadOnly)) {
+        qDebug() << "Could not open the volume file " << filePath;
+        return false;
+    }
+
+    if (file_.size() < size) {
+        qDebug() << "The volume file " << filePath << " is too short, "
+                 << file_.size() << " bytes instead of " << size;
+        file_.close();
+        return false;
+    }
+
+    size_ = size;
+
+    // Regions are read from the open file when they are needed
+    if (loadMode == LOAD_MODE_ON_DEMAND)
+        return true;
+
+    // Try the mapping first and fall back to the copying path
+    if (loadMode == LOAD_MODE_MAPPED) {
+        if (Map(accessPattern))
+            return true;
+
+        qDebug() << "Could not map the volume file, streaming it instead";
+    }
+
+    return Stream();
+}
+
+/**
+ * @brief VolumeFile::Map
+ * @param accessPattern
+ * @return
+ */
+bool VolumeFile::Map(AccessPattern accessPattern)
+{
+    TRACE_SCOPE("VolumeFile::Map");
+
+    // Zero-sized mappings are not allowed
+    if (size_ == 0)
+        return false;
+
+    mappedData_ = file_.map(0, size_);
+    if (!mappedData_)
+        return false;
+
+#ifdef Q_OS_UNIX
+    if (accessPattern == ACCESS_PATTERN_SEQUENTIAL) {
+        // The volume is consumed front to back right after the mapping, so
+        // ask the kernel for an aggressive read-ahead and to start paging it
+        // in now.
+        posix_madvise(mappedData_, size_, POSIX_MADV_SEQUENTIAL);
+        posix_madvise(mappedData_, size_, POSIX_MADV_WILLNEED);
+    } else {
+        // Bricks touch a few rows per page scattered over the whole file,
+        // read-ahead would only pull in pages that are dropped unused.
+        posix_madvise(mappedData_, size_, POSIX_MADV_RANDOM);
+    }
+#endif
+
+    return true;
+}
+
+/**
+ * @brief VolumeFile::Stream
+ * @return
+ */
+bool VolumeFile::Stream()
+{
+    TRACE_SCOPE("VolumeFile::Stream");
+
+    // The stream reopens the file by itself
+    file_.close();
+
+    std::ifstream imgStream;
+    imgStream.open(file_.fileName().toLocal8Bit().constData(),
+                   std::ios::in | std::ios::binary);
+    if (imgStream.fail()) {
+        qDebug() << "Could not open the volume file " << file_.fileName();
+        return false;
+    }
+
+    streamedData_ = new GLubyte [size_];
+    imgStream.read((char *)streamedData_, size_);
+
+    // Close the stream
+    imgStream.close();
+
+    return true;
+}
+
+/**
+ * @brief VolumeFile::Read
+ * @param offset
+ * @param size
+ * @param data
+ * @return
+ */
+bool VolumeFile::Read(qint64 offset, qint64 size, GLubyte* data)
+{
+    if (offset < 0 || offset + size > size_)
+        return false;
+
+    const GLubyte* volumeData = GetData();
+    if (volumeData) {
+        memcpy(data, volumeData + offset, size);
+        return true;
+    }
+
+    if (!file_.isOpen() || !file_.seek(offset))
+        return false;
+
+    return file_.read((char *) data, size) == size;
+}
+
+/**
+ * @brief VolumeFile::Close
+ */
+void VolumeFile::Close()
+{
+    if (mappedData_) {
+        file_.unmap(mappedData_);
+        mappedData_ = NULL;
+    }
+
+    if (file_.isOpen())
+        file_.close();
+
+    delete [] streamedData_;
+    streamedData_ = NULL;
+
+    size_ = 0;
+}
+
+/**
+ * @brief VolumeFile::GetData
+ * @return
+ */
+const GLubyte* VolumeFile::GetData() const
+{
+    if (mappedData_)
+        return mappedData_;
+
+    return streamedData_;
+}
+
+/**
+ * @brief VolumeFile::GetSize
+ * @return
+ */
+qint64 VolumeFile::GetSize() const
+{
+    return size_;
+}
+
+/**
+ * @brief VolumeFile::IsMapped
+ * @return
+ */
+bool VolumeFile::IsMapped() const
+{
+    return mappedData_ != NULL;
+}
+
+/**
+ * @brief VolumeFile::ReadHeader
+ * @param filePath
+ * @param width
+ * @param height
+ * @param depth
+ * @return
+ */
+bool VolumeFile::ReadHeader(const char* filePath,
+                            int* width, int* height, int* depth)
+{
+    std::ifstream hdrStream(filePath, std::ios::in);
+    if (hdrStream.fail())
+        return false;
+
+    hdrStream >> *width >> *height >> *depth;
+    return !hdrStream.fail();
+}
+
+/**
+ * @brief VolumeFile::WriteHeader
+ * @param filePath
+ * @param width
+ * @param height
+ * @param depth
+ * @return
+ */
+bool VolumeFile::WriteHeader(const char* filePath,
+                             int width, int height, int depth)
+{
+    std::ofstream hdrStream(filePath, std::ios::out);
+    hdrStream << width << " " << height << " " << depth << std::endl;
+    return !hdrStream.fail();
+}
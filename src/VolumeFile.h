@@ -0,0 +1,172 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef VOLUMEFILE_H
+#define VOLUMEFILE_H
+
+#include <QFile>
+#include <QtGui/qopengl.h>
+
+/**
+ * @brief The VolumeFile class
+ * Gives read-only access to the raw bytes of a <prefix>.img volume, either
+ * through a memory mapping of the file, through a heap copy read with a
+ * std::ifstream, or region by region straight from the file.
+ */
+class VolumeFile
+{
+public:
+    /**
+     * @brief The LoadMode enum
+     * How the volume file is brought into memory.
+     */
+    enum LoadMode {
+        /** Map the file read-only and page it in on demand */
+        LOAD_MODE_MAPPED,
+
+        /** Copy the whole file into a heap buffer */
+        LOAD_MODE_STREAMED,
+
+        /** Keep the file open and only read the regions asked for */
+        LOAD_MODE_ON_DEMAND
+    };
+
+    /**
+     * @brief The AccessPattern enum
+     * How the volume bytes are going to be read once the file is open.
+     */
+    enum AccessPattern {
+        /** Read once, front to back, right after opening */
+        ACCESS_PATTERN_SEQUENTIAL,
+
+        /** Read region by region in no particular order, e.g. bricks */
+        ACCESS_PATTERN_RANDOM
+    };
+
+    /**
+     * @brief VolumeFile
+     */
+    VolumeFile();
+
+    /**
+     * @brief ~VolumeFile
+     */
+    ~VolumeFile();
+
+    /**
+     * @brief Open
+     * Opens the volume file and makes its first _size_ bytes accessible.
+     * If the mapping fails, the file is streamed into memory instead.
+     * @param filePath
+     * @param size
+     * @param loadMode
+     * @param accessPattern Paging hint given to the kernel for a mapping.
+     * @return False if the file could not be opened or is too short.
+     */
+    bool Open(const char* filePath, qint64 size, LoadMode loadMode,
+              AccessPattern accessPattern = ACCESS_PATTERN_SEQUENTIAL);
+
+    /**
+     * @brief Close
+     * Unmaps or frees the volume data.
+     */
+    void Close();
+
+    /**
+     * @brief Read
+     * Copies _size_ bytes starting at _offset_ into _data_, in any mode.
+     * @param offset
+     * @param size
+     * @param data
+     * @return False if the bytes could not be read.
+     */
+    bool Read(qint64 offset, qint64 size, GLubyte* data);
+
+    /**
+     * @brief GetData
+     * @return Pointer to the raw volume bytes, NULL if nothing is open or
+     * the file is read on demand.
+     */
+    const GLubyte* GetData() const;
+
+    /**
+     * @brief GetSize
+     * @return Number of accessible bytes.
+     */
+    qint64 GetSize() const;
+
+    /**
+     * @brief IsMapped
+     * @return True if the data is served from a memory mapping.
+     */
+    bool IsMapped() const;
+
+    /**
+     * @brief ReadHeader
+     * Reads the dimensions from a <prefix>.hdr file.
+     * @param filePath
+     * @param width
+     * @param height
+     * @param depth
+     * @return False if the file could not be read.
+     */
+    static bool ReadHeader(const char* filePath,
+                           int* width, int* height, int* depth);
+
+    /**
+     * @brief WriteHeader
+     * Writes the dimensions to a <prefix>.hdr file.
+     * @param filePath
+     * @param width
+     * @param height
+     * @param depth
+     * @return False if the file could not be written.
+     */
+    static bool WriteHeader(const char* filePath,
+                            int width, int height, int depth);
+
+private:
+    /**
+     * @brief Map
+     * @param accessPattern
+     * @return False if the file could not be mapped.
+     */
+    bool Map(AccessPattern accessPattern);
+
+    /**
+     * @brief Stream
+     * @return False if the file could not be read.
+     */
+    bool Stream();
+
+private:
+    /** \brief Volume file */
+    QFile file_;
+
+    /** \brief Mapped file region, NULL in streamed mode */
+    uchar* mappedData_;
+
+    /** \brief Heap copy of the file, NULL in mapped mode */
+    GLubyte* streamedData_;
+
+    /** \brief Number of accessible bytes */
+    qint64 size_;
+};
+
+#endif // VOLUMEFILE_H
@@ -0,0 +1,393 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "VolumePyramid.h"
+#include "VolumeClassifier.h"
+#include "Trace.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define PYRAMID_SSE2
+#include <emmintrin.h>
+#endif
+
+/** \brief Accumulator entries in front of and behind a row, filled with
+ * the edge voxels so the filter taps never need clamping along X */
+static const int ROW_PADDING = 4;
+
+/**
+ * @brief The FilterTaps struct
+ * One-dimensional reduction kernel, applied along every axis. Output voxel
+ * i reads the input voxels 2i + offset to 2i + offset + count - 1.
+ */
+struct FilterTaps
+{
+    /** \brief Number of taps, even */
+    int count;
+
+    /** \brief First tap relative to 2i */
+    int offset;
+
+    /** \brief Integer weights */
+    int weights[4];
+
+    /** \brief log2 of the sum of the weights */
+    int shift;
+};
+
+/** \brief Box taps */
+static const FilterTaps BOX_TAPS = { 2, 0, { 1, 1, 0, 0 }, 1 };
+
+/** \brief Binomial taps */
+static const FilterTaps GAUSSIAN_TAPS = { 4, -1, { 1, 3, 3, 1 }, 3 };
+
+/**
+ * @brief AddWeightedRow
+ * Adds _weight_ times a row of voxels to a row of 16-bit sums. The Y and Z
+ * weights of both filters sum to at most 64, so the sums stay below 2^14.
+ * @param row
+ * @param weight
+ * @param sums
+ * @param count
+ */
+static void AddWeightedRow(const GLubyte* row, int weight, quint16* sums,
+                           int count)
+{
+    int i = 0;
+
+#ifdef PYRAMID_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i factor = _mm_set1_epi16(weight);
+    for (; i + 16 <= count; i += 16) {
+        const __m128i bytes = _mm_loadu_si128((const __m128i *) (row + i));
+        const __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(bytes, zero),
+                                           factor);
+        const __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(bytes, zero),
+                                           factor);
+
+        __m128i* sum = (__m128i *) (sums + i);
+        _mm_storeu_si128(sum, _mm_add_epi16(_mm_loadu_si128(sum), lo));
+        _mm_storeu_si128(sum + 1, _mm_add_epi16(_mm_loadu_si128(sum + 1), hi));
+    }
+#endif
+
+    for (; i < count; i++) {
+        sums[i] += weight * row[i];
+    }
+}
+
+/**
+ * @brief ReduceRow
+ * Applies the taps along X to a row of sums and normalizes the result.
+ * @param sums First sum read by output voxel 0.
+ * @param taps
+ * @param shift Normalization of all three axes.
+ * @param row
+ * @param count Number of output voxels.
+ */
+static void ReduceRow(const quint16* sums, const FilterTaps& taps, int shift,
+                      GLubyte* row, int count)
+{
+    const int rounding = 1 << (shift - 1);
+    int i = 0;
+
+#ifdef PYRAMID_SSE2
+    // Every 32-bit lane of a multiply-add holds one output voxel, fed by
+    // a pair of neighbouring sums
+    const __m128i round = _mm_set1_epi32(rounding);
+    for (; i + 8 <= count; i += 8) {
+        __m128i lo = round;
+        __m128i hi = round;
+        for (int tap = 0; tap < taps.count; tap += 2) {
+            const __m128i weights =
+                    _mm_set1_epi32((taps.weights[tap + 1] << 16) |
+                                   taps.weights[tap]);
+            const quint16* pair = sums + 2 * i + tap;
+            lo = _mm_add_epi32(lo, _mm_madd_epi16(
+                    _mm_loadu_si128((const __m128i *) pair), weights));
+            hi = _mm_add_epi32(hi, _mm_madd_epi16(
+                    _mm_loadu_si128((const __m128i *) (pair + 8)), weights));
+        }
+
+        const __m128i words = _mm_packs_epi32(_mm_srai_epi32(lo, shift),
+                                              _mm_srai_epi32(hi, shift));
+        _mm_storel_epi64((__m128i *) (row + i),
+                         _mm_packus_epi16(words, words));
+    }
+#endif
+
+    for (; i < count; i++) {
+        int sum = rounding;
+        for (int tap = 0; tap < taps.count; tap++) {
+            sum += taps.weights[tap] * sums[2 * i + tap];
+        }
+        row[i] = (GLubyte) (sum >> shift);
+    }
+}
+
+/**
+ * @brief VolumePyramid::VolumePyramid
+ */
+VolumePyramid::VolumePyramid() :
+    filter_(FILTER_NONE)
+{
+}
+
+/**
+ * @brief VolumePyramid::Build
+ * @param volume
+ * @param width
+ * @param height
+ * @param depth
+ * @param filter
+ * @param threadPool
+ */
+void VolumePyramid::Build(const GLubyte* volume,
+                          int width, int height, int depth,
+                          Filter filter, ThreadPool* threadPool)
+{
+    TRACE_SCOPE("VolumePyramid::Build");
+
+    filter_ = filter;
+    sizes_.clear();
+    levels_.clear();
+
+    sizes_.append(width);
+    sizes_.append(height);
+    sizes_.append(depth);
+    levels_.append(QVector<GLubyte>());
+
+    if (filter_ == FILTER_NONE)
+        return;
+
+    // Halve down to the coarsest level, the smaller sides stop at 1 voxel
+    int level = 0;
+    while (qMax(sizes_[3 * level], qMax(sizes_[3 * level + 1],
+                                        sizes_[3 * level + 2])) >
+           MIN_LEVEL_SIZE) {
+        for (int axis = 0; axis < 3; axis++) {
+            sizes_.append(qMax(1, sizes_[3 * level + axis] / 2));
+        }
+        levels_.append(QVector<GLubyte>());
+        level++;
+
+        const GLubyte* source = (level == 1) ?
+                    volume : levels_[level - 1].constData();
+        ReduceLevel(source, level, threadPool);
+        PaintOutline(level);
+    }
+}
+
+/**
+ * @brief VolumePyramid::ReduceLevel
+ * The Y and Z taps of an output row are summed into a padded row of 16-bit
+ * sums, which the X taps then reduce, so every input row is read straight
+ * from memory and only one row of sums is kept per task.
+ * @param source
+ * @param level
+ * @param threadPool
+ */
+void VolumePyramid::ReduceLevel(const GLubyte* source, int level,
+                                ThreadPool* threadPool)
+{
+    TRACE_SCOPE("VolumePyramid::ReduceLevel");
+
+    const FilterTaps& taps =
+            (filter_ == FILTER_GAUSSIAN) ? GAUSSIAN_TAPS : BOX_TAPS;
+    const int shift = 3 * taps.shift;
+
+    const int inWidth = sizes_[3 * (level - 1)];
+    const int inHeight = sizes_[3 * (level - 1) + 1];
+    const int inDepth = sizes_[3 * (level - 1) + 2];
+    const int outWidth = sizes_[3 * level];
+    const int outHeight = sizes_[3 * level + 1];
+    const int outDepth = sizes_[3 * level + 2];
+
+    levels_[level].resize(GetLevelVoxelCount(level));
+    GLubyte* target = levels_[level].data();
+
+    // A slab of slices per task keeps the tasks few on the fine levels
+    const qint64 slabSlices = qMax((qint64) 1,
+            (qint64) (1 << 20) / ((qint64) outWidth * outHeight));
+    threadPool->ParallelFor(0, outDepth, slabSlices,
+                            [&] (qint64 firstSlice, qint64 lastSlice) {
+        QVector<quint16> sumRow(inWidth + 2 * ROW_PADDING);
+        quint16* sums = sumRow.data() + ROW_PADDING;
+
+        for (int k = firstSlice; k < lastSlice; k++) {
+            for (int j = 0; j < outHeight; j++) {
+                memset(sums, 0, inWidth * sizeof(quint16));
+
+                for (int tz = 0; tz < taps.count; tz++) {
+                    const int z = qBound(0, 2 * k + taps.offset + tz,
+                                         inDepth - 1);
+                    for (int ty = 0; ty < taps.count; ty++) {
+                        const int y = qBound(0, 2 * j + taps.offset + ty,
+                                             inHeight - 1);
+                        AddWeightedRow(source +
+                                       ((qint64) z * inHeight + y) * inWidth,
+                                       taps.weights[tz] * taps.weights[ty],
+                                       sums, inWidth);
+                    }
+                }
+
+                // Clamp to the edge along X
+                for (int p = 1; p <= ROW_PADDING; p++) {
+                    sums[-p] = sums[0];
+                    sums[inWidth - 1 + p] = sums[inWidth - 1];
+                }
+
+                ReduceRow(sums + taps.offset, taps, shift,
+                          target + ((qint64) k * outHeight + j) * outWidth,
+                          outWidth);
+            }
+        }
+    });
+}
+
+/**
+ * @brief VolumePyramid::PaintOutline
+ * @param level
+ */
+void VolumePyramid::PaintOutline(int level)
+{
+    const int band = qMax(1, VolumeClassifier::OUTLINE_WIDTH >> level);
+    const int width = sizes_[3 * level];
+    const int height = sizes_[3 * level + 1];
+    const int depth = sizes_[3 * level + 2];
+    GLubyte* voxels = levels_[level].data();
+
+    // A voxel belongs to the outline when it lies in the band of two axes
+    for (int k = 0; k < depth; k++) {
+        const bool zBand = (k < band) || (k >= depth - band);
+        for (int j = 0; j < height; j++) {
+            const bool yBand = (j < band) || (j >= height - band);
+            GLubyte* row = voxels + ((qint64) k * height + j) * width;
+
+            if (yBand && zBand) {
+                memset(row, VolumeClassifier::OUTLINE_VALUE, width);
+            } else if (yBand || zBand) {
+                const int edge = qMin(band, width);
+                memset(row, VolumeClassifier::OUTLINE_VALUE, edge);
+                memset(row + width - edge, VolumeClassifier::OUTLINE_VALUE,
+                       edge);
+            }
+        }
+    }
+}
+
+/**
+ * @brief VolumePyramid::Clear
+ */
+void VolumePyramid::Clear()
+{
+    for (int level = 0; level < levels_.size(); level++) {
+        levels_[level] = QVector<GLubyte>();
+    }
+}
+
+/**
+ * @brief VolumePyramid::GetLevelCount
+ * @return
+ */
+int VolumePyramid::GetLevelCount() const
+{
+    return sizes_.size() / 3;
+}
+
+/**
+ * @brief VolumePyramid::GetLevelSize
+ * @param level
+ * @param axis
+ * @return
+ */
+int VolumePyramid::GetLevelSize(int level, int axis) const
+{
+    return sizes_[3 * level + axis];
+}
+
+/**
+ * @brief VolumePyramid::GetLevelVoxelCount
+ * @param level
+ * @return
+ */
+qint64 VolumePyramid::GetLevelVoxelCount(int level) const
+{
+    return (qint64) sizes_[3 * level] * sizes_[3 * level + 1] *
+            sizes_[3 * level + 2];
+}
+
+/**
+ * @brief VolumePyramid::GetLevelData
+ * @param level
+ * @return
+ */
+const GLubyte* VolumePyramid::GetLevelData(int level) const
+{
+    if (level == 0 || levels_[level].isEmpty())
+        return NULL;
+
+    return levels_[level].constData();
+}
+
+/**
+ * @brief VolumePyramid::GetFinestLevel
+ * @param memory
+ * @param bytesPerVoxel
+ * @return
+ */
+int VolumePyramid::GetFinestLevel(qint64 memory, int bytesPerVoxel) const
+{
+    const int coarsest = GetLevelCount() - 1;
+    if (memory <= 0)
+        return 0;
+
+    // Add finer levels as long as they fit
+    qint64 bytes = GetLevelVoxelCount(coarsest) * bytesPerVoxel;
+    int level = coarsest;
+    while (level > 0) {
+        bytes += GetLevelVoxelCount(level - 1) * bytesPerVoxel;
+        if (bytes > memory)
+            break;
+        level--;
+    }
+
+    return level;
+}
+
+/**
+ * @brief VolumePyramid::GetSampleReach
+ * A sample reads the texels less than one texel spacing away. A texel of
+ * a reduced level averages the voxels under it, and the Gaussian taps add
+ * one texel of every finer level on each side.
+ * @param level
+ * @return
+ */
+int VolumePyramid::GetSampleReach(int level) const
+{
+    if (level == 0)
+        return 1;
+
+    const int spacing = 1 << level;
+    int reach = spacing + spacing / 2 - 1;
+    if (filter_ == FILTER_GAUSSIAN)
+        reach += spacing - 1;
+
+    return reach;
+}
@@ -0,0 +1,160 @@
+/*******************************************************************************
+ *
+ * Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef VOLUMEPYRAMID_H
+#define VOLUMEPYRAMID_H
+
+#include <QVector>
+#include <QtGui/qopengl.h>
+#include "ThreadPool.h"
+
+/**
+ * @brief The VolumePyramid class
+ * Chain of 8-bit scalar volumes, each half the size of the previous one
+ * along every axis, for level-of-detail rendering. Level 0 is the source
+ * volume and is not copied. The level sizes follow the OpenGL mipmap rule,
+ * so the levels can be uploaded as the mipmaps of one 3D texture, and the
+ * bounding-box outline is painted into every level.
+ */
+class VolumePyramid
+{
+public:
+    /**
+     * @brief The Filter enum
+     * Reduction from one level to the next.
+     */
+    enum Filter {
+        /** No pyramid, the source volume only */
+        FILTER_NONE,
+
+        /** Mean of the 2x2x2 voxels under a coarse voxel */
+        FILTER_BOX,
+
+        /** Separable 1 3 3 1 binomial over 4x4x4 voxels, less aliasing at
+         * eight times the reads */
+        FILTER_GAUSSIAN
+    };
+
+    /**
+     * @brief VolumePyramid
+     */
+    VolumePyramid();
+
+    /**
+     * @brief Build
+     * Reduces the volume level by level down to MIN_LEVEL_SIZE voxels on
+     * the longest side. Every level is split into slabs of slices reduced
+     * in parallel. _volume_ has to outlive the reduction only.
+     * @param volume
+     * @param width
+     * @param height
+     * @param depth
+     * @param filter
+     * @param threadPool
+     */
+    void Build(const GLubyte* volume, int width, int height, int depth,
+               Filter filter, ThreadPool* threadPool);
+
+    /**
+     * @brief Clear
+     * Frees the levels, level 0 stays described.
+     */
+    void Clear();
+
+    /**
+     * @brief GetLevelCount
+     * @return Number of levels including the source volume.
+     */
+    int GetLevelCount() const;
+
+    /**
+     * @brief GetLevelSize
+     * @param level
+     * @param axis
+     * @return Size of _level_ along _axis_ in voxels.
+     */
+    int GetLevelSize(int level, int axis) const;
+
+    /**
+     * @brief GetLevelVoxelCount
+     * @param level
+     * @return
+     */
+    qint64 GetLevelVoxelCount(int level) const;
+
+    /**
+     * @brief GetLevelData
+     * @param level
+     * @return The voxels of a reduced level, NULL for level 0 or once the
+     * pyramid was cleared.
+     */
+    const GLubyte* GetLevelData(int level) const;
+
+    /**
+     * @brief GetFinestLevel
+     * @param memory Bytes available for the resident levels, 0 for no
+     * limit.
+     * @param bytesPerVoxel
+     * @return The finest level such that it and all coarser levels fit in
+     * _memory_, the coarsest level if none does.
+     */
+    int GetFinestLevel(qint64 memory, int bytesPerVoxel) const;
+
+    /**
+     * @brief GetSampleReach
+     * @param level
+     * @return Distance in voxels of the source volume, on either side of a
+     * trilinear sample of _level_, of the farthest voxel that contributes
+     * to the sample.
+     */
+    int GetSampleReach(int level) const;
+
+    /** \brief Longest side of the coarsest level in voxels */
+    static const int MIN_LEVEL_SIZE = 16;
+
+private:
+    /**
+     * @brief ReduceLevel
+     * @param source
+     * @param level Level to compute from the previous one.
+     * @param threadPool
+     */
+    void ReduceLevel(const GLubyte* source, int level,
+                     ThreadPool* threadPool);
+
+    /**
+     * @brief PaintOutline
+     * Writes the outline value over the edges of a reduced level. The band
+     * narrows with the level so that it keeps its width on screen.
+     * @param level
+     */
+    void PaintOutline(int level);
+
+private:
+    /** \brief Reduction filter */
+    Filter filter_;
+
+    /** \brief Width, height and depth of every level */
+    QVector<int> sizes_;
+
+    /** \brief Voxels of the levels, the first one is empty */
+    QVector< QVector<GLubyte> > levels_;
+};
+
+#endif // VOLUMEPYRAMID_H
@@ -18,10 +18,32 @@
  ******************************************************************************/
 
 #include "VolumeSlicer.h"
-#include <fstream>
+#include "Trace.h"
 #include <iostream>
+#include <cmath>
 #include <QDebug>
 
+/** \brief Raw plus RGBA bytes of a classification slab, sized to stay in
+ * the per-core L2 cache */
+static const qint64 CLASSIFICATION_SLAB_BYTES = 256 * 1024;
+
+/** \brief Edge of an empty-space cell in voxels when the volume is not
+ * bricked */
+static const int EMPTY_SPACE_CELL_SIZE = 32;
+
+/** \brief Coarsest pyramid level sampled while empty space is skipped, the
+ * apron of the cells grows with the level */
+static const int EMPTY_SPACE_MIP_LEVEL = 2;
+
+/** \brief Largest side of the preview shown while the volume loads */
+static const int PREVIEW_SIZE = 128;
+
+/** \brief Load progress in per mille once the file is open, the preview is
+ * built and the empty-space pass is done, classification fills the rest */
+static const int LOAD_PROGRESS_OPEN = 50;
+static const int LOAD_PROGRESS_PREVIEW = 150;
+static const int LOAD_PROGRESS_CLASSIFY = 450;
+
 /**
  * @brief VolumeSlicer::VolumeSlicer
  * @param parent
@@ -30,265 +52,1460 @@
 VolumeSlicer::VolumeSlicer(QWindow *parent, char *volumePrefix) :
     OpenGLWindow(parent),
     volumePrefix_(volumePrefix),
-    volumeScale_(1.0) { }
+    volumeScale_(1.0),
+    rawVolume_(NULL),
+    rgbaVolume_(NULL),
+    samplingStep_(1.f),
+    loadMode_(VolumeFile::LOAD_MODE_MAPPED),
+    textureMode_(TEXTURE_MODE_RGBA),
+    transferFunctionTextureId_(0),
+    sliceProgram_(NULL),
+    brickingMode_(BRICKING_MODE_AUTO),
+    brickSize_(128),
+    brickMemory_((qint64) 1024 * 1024 * 1024),
+    bricked_(false),
+    mipFilter_(VolumePyramid::FILTER_BOX),
+    mipMemory_(0),
+    mipFinestLevel_(0),
+    mipLevel_(0),
+    emptySpaceMipLevel_(0),
+    skipEmptySpace_(true),
+    referenceSpacing_(1.f),
+    refinementFrames_(0),
+    sliceGeometryChanged_(true),
+    windowWidth_(1),
+    windowHeight_(1),
+    interactionScale_(0.5),
+    interacting_(false),
+    interactionFbo_(NULL),
+    renderer_(RENDERER_LEGACY),
+    renderMode_(RENDER_MODE_SLICING),
+    samplingVoxels_(1.f),
+    emptySpaceTextureId_(0),
+    softwareTextureId_(0),
+    recordingCamera_(false),
+    asyncLoading_(true),
+    loading_(false),
+    previewLoaded_(false),
+    loadProgress_(0),
+    previewReady_(false),
+    volumeLoaded_(false),
+    loadFailed_(false),
+    previewWidth_(0),
+    previewHeight_(0),
+    previewDepth_(0),
+    threshold_(VolumeClassifier::DEFAULT_THRESHOLD)
+{
+    // Full quality again once the mouse was released for a while
+    settleTimer_.setSingleShot(true);
+    settleTimer_.setInterval(150);
+    connect(&settleTimer_, SIGNAL(timeout()), this, SLOT(SettleInteraction()));
+
+    // Until the first state is published
+    view_ = GetViewState();
+}
 
 /**
  * @brief VolumeSlicer::~VolumeSlicer
  */
 VolumeSlicer::~VolumeSlicer()
 {
+    // The render thread works on the members
+    StopRenderThread();
+
+    // The loader works on the members
+    if (loaderThread_.joinable())
+        loaderThread_.join();
+
     delete [] rgbaVolume_;
+    delete sliceProgram_;
+    delete interactionFbo_;
+}
+
+/**
+ * @brief VolumeSlicer::SetLoadMode
+ * @param loadMode
+ */
+void VolumeSlicer::SetLoadMode(VolumeFile::LoadMode loadMode)
+{
+    loadMode_ = loadMode;
+}
+
+/**
+ * @brief VolumeSlicer::SetClassifierKernel
+ * @param kernel
+ */
+void VolumeSlicer::SetClassifierKernel(VolumeClassifier::Kernel kernel)
+{
+    classifier_.SetKernel(kernel);
+}
+
+/**
+ * @brief VolumeSlicer::SetThreadCount
+ * @param threadCount
+ */
+void VolumeSlicer::SetThreadCount(int threadCount)
+{
+    threadPool_.SetThreadCount(threadCount);
+}
+
+/**
+ * @brief VolumeSlicer::SetTextureMode
+ * @param textureMode
+ */
+void VolumeSlicer::SetTextureMode(TextureMode textureMode)
+{
+    textureMode_ = textureMode;
+}
+
+/**
+ * @brief VolumeSlicer::SetBricking
+ * @param brickingMode
+ * @param brickSize
+ * @param brickMemory
+ */
+void VolumeSlicer::SetBricking(BrickingMode brickingMode, int brickSize,
+                               qint64 brickMemory)
+{
+    brickingMode_ = brickingMode;
+    brickSize_ = qMax(brickSize, 8);
+    brickMemory_ = brickMemory;
+}
+
+/**
+ * @brief VolumeSlicer::SetMipPyramid
+ * @param filter
+ * @param textureMemory
+ */
+void VolumeSlicer::SetMipPyramid(VolumePyramid::Filter filter,
+                                 qint64 textureMemory)
+{
+    mipFilter_ = filter;
+    mipMemory_ = textureMemory;
+}
+
+/**
+ * @brief VolumeSlicer::SetInteractionQuality
+ * @param scale
+ * @param settleDelay
+ */
+void VolumeSlicer::SetInteractionQuality(float scale, int settleDelay)
+{
+    interactionScale_ = qBound(0.05f, scale, 1.f);
+    settleTimer_.setInterval(qMax(settleDelay, 0));
+}
+
+/**
+ * @brief VolumeSlicer::SetRenderer
+ * @param renderer
+ */
+void VolumeSlicer::SetRenderer(Renderer renderer)
+{
+    renderer_ = renderer;
+}
+
+/**
+ * @brief VolumeSlicer::SetRenderMode
+ * @param renderMode
+ */
+void VolumeSlicer::SetRenderMode(RenderMode renderMode)
+{
+    renderMode_ = renderMode;
+}
+
+/**
+ * @brief VolumeSlicer::SetSamplingStep
+ * @param voxels
+ */
+void VolumeSlicer::SetSamplingStep(float voxels)
+{
+    samplingVoxels_ = qMax(voxels, 0.01f);
+}
+
+/**
+ * @brief VolumeSlicer::SetTargetFrameRate
+ * @param framesPerSecond
+ */
+void VolumeSlicer::SetTargetFrameRate(float framesPerSecond)
+{
+    sliceController_.SetTarget(framesPerSecond);
+}
+
+/**
+ * @brief VolumeSlicer::SetRefinement
+ * @param frames
+ */
+void VolumeSlicer::SetRefinement(int frames)
+{
+    refinementFrames_ = qMax(frames, 0);
+}
+
+/**
+ * @brief VolumeSlicer::SetAsyncLoading
+ * @param asyncLoading
+ */
+void VolumeSlicer::SetAsyncLoading(bool asyncLoading)
+{
+    asyncLoading_ = asyncLoading;
+}
+
+/**
+ * @brief VolumeSlicer::LoadFailed
+ * @return
+ */
+bool VolumeSlicer::LoadFailed() const
+{
+    return loadFailed_.load(std::memory_order_acquire);
+}
+
+/**
+ * @brief VolumeSlicer::SetCamera
+ * @param xRotation
+ * @param yRotation
+ * @param zRotation
+ * @param scale
+ */
+void VolumeSlicer::SetCamera(float xRotation, float yRotation,
+                             float zRotation, float scale)
+{
+    // The slice geometry follows the rotation on the next frame
+    xRotation_ = xRotation;
+    yRotation_ = yRotation;
+    zRotation_ = zRotation;
+    volumeScale_ = scale;
+    PublishState();
+}
+
+/**
+ * @brief VolumeSlicer::GetCameraState
+ * @return
+ */
+CameraState VolumeSlicer::GetCameraState() const
+{
+    CameraState camera;
+    camera.xRotation = xRotation_;
+    camera.yRotation = yRotation_;
+    camera.zRotation = zRotation_;
+    camera.zTranslation = zTranslation_;
+    camera.scale = volumeScale_;
+    return camera;
+}
+
+/**
+ * @brief VolumeSlicer::SetCameraState
+ * @param camera
+ */
+void VolumeSlicer::SetCameraState(const CameraState& camera)
+{
+    zTranslation_ = camera.zTranslation;
+    SetCamera(camera.xRotation, camera.yRotation, camera.zRotation,
+              camera.scale);
+}
+
+/**
+ * @brief VolumeSlicer::GetViewState
+ * @return The state edited on the UI thread.
+ */
+VolumeSlicer::ViewState VolumeSlicer::GetViewState() const
+{
+    ViewState state;
+    state.camera = GetCameraState();
+    state.renderMode = renderMode_;
+    state.skipEmptySpace = skipEmptySpace_;
+    state.threshold = threshold_;
+    state.interacting = interacting_;
+    return state;
+}
+
+/**
+ * @brief VolumeSlicer::PublishState
+ */
+void VolumeSlicer::PublishState()
+{
+    viewStates_.Publish(GetViewState());
+}
+
+/**
+ * @brief VolumeSlicer::SynchronizeState
+ */
+void VolumeSlicer::SynchronizeState()
+{
+    if (!viewStates_.Update())
+        return;
+
+    const ViewState& state = viewStates_.Read();
+    if (state.skipEmptySpace != view_.skipEmptySpace)
+        sliceGeometryChanged_ = true;
+    view_ = state;
+
+    // Whatever changed, the refined frames show something else
+    accumulator_.Reset();
+}
+
+/**
+ * @brief VolumeSlicer::StartCameraRecording
+ */
+void VolumeSlicer::StartCameraRecording()
+{
+    cameraPath_.Clear();
+    recordingTimer_.start();
+    recordingCamera_ = true;
+}
+
+/**
+ * @brief VolumeSlicer::GetCameraPath
+ * @return
+ */
+const CameraPath& VolumeSlicer::GetCameraPath() const
+{
+    return cameraPath_;
 }
 
 /**
  * @brief VolumeSlicer::ReadHeader
+ * @return
  */
-void VolumeSlicer::ReadHeader()
+bool VolumeSlicer::ReadHeader()
 {
+    TRACE_SCOPE("VolumeSlicer::ReadHeader");
+
     // Format the file header
     char hdrFile[300];
     sprintf(hdrFile, "%s.hdr", volumePrefix_);
 
-    // Open the file
-    std::ifstream hdrStream;
-    hdrStream.open(hdrFile, std::ios::in);
-
-    if (hdrStream.fail()) {
-        // qDebug << "Could not open the header file " << hdrFile << endl;
-        exit(0);
-    }
-
     // Read the volume header
-    hdrStream >> volumeWidth_;
-    hdrStream >> volumeHeight_;
-    hdrStream >> volumeDepth_;
-
-    // Close the stream
-    hdrStream.close();
+    if (!VolumeFile::ReadHeader(hdrFile, &volumeWidth_, &volumeHeight_,
+                                &volumeDepth_)) {
+        qDebug() << "Could not open the header file" << hdrFile;
+        return false;
+    }
+    return true;
 }
 
 /**
- * @brief VolumeSlicer::ReadVolume
+ * @brief VolumeSlicer::OpenVolumeFile
+ * @return
  */
-void VolumeSlicer::ReadVolume()
+bool VolumeSlicer::OpenVolumeFile()
 {
-    // Read the header file to extract the volume dimensions
-    ReadHeader();
+    TRACE_SCOPE("VolumeSlicer::OpenVolumeFile");
 
     // Form the volume file path string
     char imgFile[100];
     sprintf(imgFile, "%s.img", volumePrefix_);
 
     // Volume 3D size
-    int volume3dSize = volumeWidth_*volumeHeight_*volumeDepth_;
+    const qint64 volume3dSize =
+            (qint64) volumeWidth_ * volumeHeight_ * volumeDepth_;
+
+    // Bricks are read region by region, never stream the whole file for them
+    VolumeFile::LoadMode loadMode = loadMode_;
+    if (bricked_ && loadMode == VolumeFile::LOAD_MODE_STREAMED)
+        loadMode = VolumeFile::LOAD_MODE_ON_DEMAND;
+
+    // Map or read the volume file, the raw volume is read-only from here on
+    const VolumeFile::AccessPattern accessPattern = bricked_ ?
+                VolumeFile::ACCESS_PATTERN_RANDOM :
+                VolumeFile::ACCESS_PATTERN_SEQUENTIAL;
+    if (!volumeFile_.Open(imgFile, volume3dSize, loadMode, accessPattern)) {
+        qDebug() << "Could not read the volume file" << imgFile;
+        return false;
+    }
+    rawVolume_ = volumeFile_.GetData();
+    return true;
+}
 
-    // Allocate the raw volume and RGBA volumes
-    rawVolume_  = new GLubyte [volume3dSize];
+/**
+ * @brief VolumeSlicer::CloseVolumeFile
+ */
+void VolumeSlicer::CloseVolumeFile()
+{
+    // Unmap or free the raw volume
+    volumeFile_.Close();
+    rawVolume_ = NULL;
+}
+
+/**
+ * @brief VolumeSlicer::ClassifyVolume
+ */
+void VolumeSlicer::ClassifyVolume()
+{
+    TRACE_SCOPE("VolumeSlicer::ClassifyVolume");
+
+    // Classify the volume and put a box around it so that we can see the
+    // outline of the data. The raw volume may be a read-only mapping, so the
+    // outline is written straight into the RGBA volume.
+    // The volume is cut along z into slabs of whole rows that are handed
+    // out to the thread pool.
+    const qint64 rowCount = (qint64) volumeHeight_ * volumeDepth_;
+    const qint64 slabRows = qMax((qint64) 1,
+            CLASSIFICATION_SLAB_BYTES / (5 * (qint64) volumeWidth_));
+    std::atomic<qint64> classifiedRows(0);
+    threadPool_.ParallelFor(0, rowCount, slabRows,
+                            [&] (qint64 firstRow, qint64 lastRow) {
+        classifier_.ClassifyRows(rawVolume_, rgbaVolume_,
+                                 volumeWidth_, volumeHeight_, volumeDepth_,
+                                 firstRow, lastRow);
+
+        // The last part of the loading progress
+        const qint64 rows = classifiedRows += lastRow - firstRow;
+        loadProgress_ = LOAD_PROGRESS_CLASSIFY +
+                (1000 - LOAD_PROGRESS_CLASSIFY) * rows / rowCount;
+    });
+}
+
+/**
+ * @brief VolumeSlicer::UseBricks
+ * @return True if the volume has to be split into bricks.
+ */
+bool VolumeSlicer::UseBricks()
+{
+    // The software renderer samples the whole volume in memory
+    if (renderer_ == RENDERER_SOFTWARE)
+        return false;
+
+    if (brickingMode_ != BRICKING_MODE_AUTO)
+        return brickingMode_ == BRICKING_MODE_ON;
+
+    GLint max3dTextureSize = 0;
+    glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &max3dTextureSize);
+    if (volumeWidth_ > max3dTextureSize ||
+            volumeHeight_ > max3dTextureSize ||
+            volumeDepth_ > max3dTextureSize) {
+        return true;
+    }
+
+    const qint64 texelBytes = (textureMode_ == TEXTURE_MODE_SCALAR) ? 1 : 4;
+    const qint64 textureBytes = texelBytes *
+            volumeWidth_ * volumeHeight_ * (qint64) volumeDepth_;
+    return textureBytes > brickMemory_;
+}
+
+/**
+ * @brief VolumeSlicer::ReadVolume
+ * @return
+ */
+bool VolumeSlicer::ReadVolume()
+{
+    TRACE_SCOPE("VolumeSlicer::ReadVolume");
+
+    // Map or read the volume file
+    if (!OpenVolumeFile())
+        return false;
+    loadProgress_ = LOAD_PROGRESS_OPEN;
+
+    // Something to look at while the rest is loading
+    if (asyncLoading_)
+        BuildPreview();
+    loadProgress_ = LOAD_PROGRESS_PREVIEW;
+
+    // Coarser copies for the zoomed-out views, the CPU renderers and the
+    // bricks sample the full resolution
+    emptySpaceMipLevel_ = 0;
+    if (!bricked_ && renderer_ != RENDERER_SOFTWARE) {
+        pyramid_.Build(rawVolume_, volumeWidth_, volumeHeight_, volumeDepth_,
+                       mipFilter_, &threadPool_);
+
+        // Levels finer than the resident ones are never sampled
+        const int bytesPerVoxel =
+                (textureMode_ == TEXTURE_MODE_SCALAR) ? 1 : 4;
+        emptySpaceMipLevel_ = qMin(
+                qMax(EMPTY_SPACE_MIP_LEVEL,
+                     pyramid_.GetFinestLevel(mipMemory_, bytesPerVoxel)),
+                pyramid_.GetLevelCount() - 1);
+    }
+
+    // Record the scalar range of every cell to skip the empty ones, bricks
+    // are skipped as a whole. The cells cover the voxels read by a sample
+    // of the coarsest level used with them.
+    minMaxGrid_.Build(&volumeFile_, volumeWidth_, volumeHeight_, volumeDepth_,
+                      bricked_ ? brickSize_ : EMPTY_SPACE_CELL_SIZE,
+                      pyramid_.GetSampleReach(emptySpaceMipLevel_),
+                      &threadPool_);
+    minMaxGrid_.Classify(classifier_.GetLookupTable());
+    loadProgress_ = LOAD_PROGRESS_CLASSIFY;
+
+    // The bricks and the scalar texture are uploaded straight from the raw
+    // volume, which stays open until LoadVolumeTextures is done with it.
+    if (bricked_ || textureMode_ == TEXTURE_MODE_SCALAR) {
+        loadProgress_ = 1000;
+        return true;
+    }
+
+    // Allocate the RGBA volume
+    const qint64 volume3dSize =
+            (qint64) volumeWidth_ * volumeHeight_ * volumeDepth_;
     rgbaVolume_ = new GLubyte [volume3dSize * 4];
 
-    // Read the volume file from the input stream
-    std::ifstream imgStream;
-    imgStream.open(imgFile, std::ios::in | std::ios::binary);
-    if (imgStream.fail()) {
-        qDebug() << "Could not open the volume file " << imgFile;
-        exit(0);
+    // Classify the volume
+    ClassifyVolume();
+
+    // The raw volume is not needed anymore
+    CloseVolumeFile();
+    return true;
+}
+
+/**
+ * @brief VolumeSlicer::LoadVolumeAsync
+ * Body of the loader thread.
+ */
+void VolumeSlicer::LoadVolumeAsync()
+{
+    Trace::SetThreadName("Volume loader");
+
+    // Never exit from here, the window and the render thread are running
+    if (!ReadVolume()) {
+        loadFailed_.store(true, std::memory_order_release);
+        return;
     }
-    imgStream.read((char *)rawVolume_, volume3dSize);
-
-    // Close the stream
-    imgStream.close();
-
-    // Put a box around the volume so that we can see the outline
-    // of the data.
-    GLubyte *ptr = rawVolume_;
-    int i, j, k;
-    for (i = 0; i < volumeDepth_; i++) {
-        for (j = 0; j < volumeHeight_; j++) {
-            for (k = 0; k < volumeWidth_; k++) {
-                if (((i < 4) && (j < 4)) ||
-                        ((j < 4) && (k < 4)) ||
-                        ((k < 4) && (i < 4)) ||
-                        ((i < 4) && (j >  volumeHeight_-5)) ||
-                        ((j < 4) && (k > volumeWidth_-5)) ||
-                        ((k < 4) && (i > volumeDepth_-5)) ||
-                        ((i > volumeDepth_-5) && (j >  volumeHeight_-5)) ||
-                        ((j >  volumeHeight_-5) && (k > volumeWidth_-5)) ||
-                        ((k > volumeWidth_-5) && (i > volumeDepth_-5)) ||
-                        ((i > volumeDepth_-5) && (j < 4)) ||
-                        ((j >  volumeHeight_-5) && (k < 4)) ||
-                        ((k > volumeWidth_-5) && (i < 4))) {
-                    *ptr = 110;
+    volumeLoaded_.store(true, std::memory_order_release);
+}
+
+/**
+ * @brief VolumeSlicer::BuildPreview
+ * Point-samples the raw volume down to at most PREVIEW_SIZE voxels per
+ * side. Only one row in _factor_ squared is read, so the preview is ready
+ * long before the whole file went through the page cache.
+ */
+void VolumeSlicer::BuildPreview()
+{
+    TRACE_SCOPE("VolumeSlicer::BuildPreview");
+
+    const int largestSide = qMax(volumeWidth_, qMax(volumeHeight_,
+                                                    volumeDepth_));
+    const int factor = (largestSide + PREVIEW_SIZE - 1) / PREVIEW_SIZE;
+
+    // Small volumes load in full quickly enough
+    if (factor <= 1)
+        return;
+
+    previewWidth_ = (volumeWidth_ + factor - 1) / factor;
+    previewHeight_ = (volumeHeight_ + factor - 1) / factor;
+    previewDepth_ = (volumeDepth_ + factor - 1) / factor;
+    const qint64 previewSize =
+            (qint64) previewWidth_ * previewHeight_ * previewDepth_;
+    previewRawVolume_.resize(previewSize);
+    GLubyte* previewVolume = previewRawVolume_.data();
+
+    // A file read on demand has a single position, read it in order
+    const qint64 grain = volumeFile_.GetData() ? 1 : previewDepth_;
+    threadPool_.ParallelFor(0, previewDepth_, grain,
+                            [&] (qint64 firstSlice, qint64 lastSlice) {
+        QVector<GLubyte> row(volumeWidth_);
+        for (int k = firstSlice; k < lastSlice; k++) {
+            const int z = qMin(k * factor + factor / 2, volumeDepth_ - 1);
+            for (int j = 0; j < previewHeight_; j++) {
+                const int y = qMin(j * factor + factor / 2, volumeHeight_ - 1);
+                volumeFile_.Read(((qint64) z * volumeHeight_ + y) *
+                                 volumeWidth_, volumeWidth_, row.data());
+
+                GLubyte* preview = previewVolume +
+                        ((qint64) k * previewHeight_ + j) * previewWidth_;
+                for (int i = 0; i < previewWidth_; i++) {
+                    preview[i] = row[qMin(i * factor + factor / 2,
+                                          volumeWidth_ - 1)];
                 }
-                ptr++;
             }
         }
+    });
+
+    if (textureMode_ == TEXTURE_MODE_RGBA) {
+        previewRgbaVolume_.resize(previewSize * 4);
+        classifier_.Classify(previewRawVolume_.constData(),
+                             previewRgbaVolume_.data(), previewSize);
+    }
+
+    previewReady_.store(true, std::memory_order_release);
+}
+
+/**
+ * @brief VolumeSlicer::LoadPreviewTexture
+ * Shows the preview until the volume is loaded.
+ */
+void VolumeSlicer::LoadPreviewTexture()
+{
+    previewLoaded_ = true;
+
+    if (renderer_ == RENDERER_SOFTWARE) {
+        softwareRayCaster_.SetVolume(previewRgbaVolume_.constData(),
+                                     previewWidth_, previewHeight_,
+                                     previewDepth_);
+        shearWarpRenderer_.Build(previewRgbaVolume_.constData(),
+                                 previewWidth_, previewHeight_,
+                                 previewDepth_, &threadPool_);
+        return;
+    }
+
+    // The texture coordinates span the unit cube whatever the resolution
+    glBindTexture(GL_TEXTURE_3D, volumeTextureId_);
+    if (textureMode_ == TEXTURE_MODE_SCALAR) {
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_R8,
+                     previewWidth_, previewHeight_, previewDepth_,
+                     0, GL_RED, GL_UNSIGNED_BYTE,
+                     previewRawVolume_.constData());
+    } else {
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA,
+                     previewWidth_, previewHeight_, previewDepth_,
+                     0, GL_RGBA, GL_UNSIGNED_BYTE,
+                     previewRgbaVolume_.constData());
+    }
+}
+
+/**
+ * @brief VolumeSlicer::UpdateLoading
+ * Picks up what the loader thread has finished.
+ */
+void VolumeSlicer::UpdateLoading()
+{
+    if (loadFailed_.load(std::memory_order_acquire)) {
+        if (loaderThread_.joinable())
+            loaderThread_.join();
+        qDebug() << "Could not load the volume" << volumePrefix_;
+        qApp->exit(1);
+        return;
+    }
+
+    if (volumeLoaded_.load(std::memory_order_acquire)) {
+        loaderThread_.join();
+        LoadVolumeTextures();
+
+        // Full quality from now on
+        loading_ = false;
+        previewRawVolume_.clear();
+        previewRgbaVolume_.clear();
+        sliceGeometryChanged_ = true;
+        accumulator_.Reset();
+        return;
+    }
+
+    if (!previewLoaded_ && previewReady_.load(std::memory_order_acquire))
+        LoadPreviewTexture();
+}
+
+/**
+ * @brief VolumeSlicer::DrawLoadProgress
+ * Draws a progress bar near the bottom of the window.
+ */
+void VolumeSlicer::DrawLoadProgress()
+{
+    const int barWidth = windowWidth_ / 2;
+    const int barHeight = qMax(4, windowHeight_ / 60);
+    const int x = (windowWidth_ - barWidth) / 2;
+    const int y = windowHeight_ / 10;
+    const int filled = barWidth * loadProgress_.load() / 1000;
+
+    // Scissored clears need no geometry and work in every profile
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(x - 2, y - 2, barWidth + 4, barHeight + 4);
+    glClearColor(0.3, 0.3, 0.3, 1.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glScissor(x, y, filled, barHeight);
+    glClearColor(1.0, 1.0, 1.0, 1.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+}
+
+/**
+ * @brief VolumeSlicer::SetSliceStack
+ */
+void VolumeSlicer::SetSliceStack()
+{
+    TRACE_SCOPE("VolumeSlicer::SetSliceStack");
+
+    // Diagonal size of the slice
+    const float diagonalSizeSquared = volumeWidth_*volumeWidth_ +
+            volumeHeight_*volumeHeight_ + volumeDepth_*volumeDepth_;
+    // Number of slices
+    const int halfSlicesMinus1  = 1.3 * sqrt(diagonalSizeSquared) / 4.0;
+    const int numSlices         = 2 * halfSlicesMinus1 + 1;
+
+    // Distance between the slices
+    const float sliceArm        = sqrt(3.0) / numSlices;
+
+    sliceGeometry_.SetSlices(halfSlicesMinus1, sliceArm);
+
+    // The opacities are the ones of this stack, a controlled stack is
+    // corrected for its own distance
+    referenceSpacing_ = sliceArm;
+    sliceController_.SetLimits(numSlices, qMax(16, numSlices / 8),
+                               4 * numSlices);
+
+    // Ray-casting step in the unit cube
+    const int largestSide = qMax(volumeWidth_, qMax(volumeHeight_,
+                                                    volumeDepth_));
+    samplingStep_ = samplingVoxels_ / largestSide;
+
+    // Vertex buffer, refilled whenever the view changes
+    if (!sliceBuffer_.isCreated()) {
+        sliceBuffer_.setUsagePattern(QOpenGLBuffer::StreamDraw);
+        sliceBuffer_.create();
+    }
+    sliceGeometryChanged_ = true;
+}
+
+/**
+ * @brief VolumeSlicer::Initialize
+ */
+void VolumeSlicer::Initialize()
+{
+    // Read the header file to extract the volume dimensions, a failure is
+    // reported by the first frame
+    if (!ReadHeader()) {
+        loadFailed_.store(true, std::memory_order_release);
+        loading_ = true;
+        return;
+    }
+
+    // The software renderer ray casts the classified volume
+    if (renderer_ == RENDERER_SOFTWARE)
+        textureMode_ = TEXTURE_MODE_RGBA;
+
+    // Split the volume into bricks if it does not fit in one texture
+    bricked_ = UseBricks();
+
+    // Shaders and textures that do not depend on the data
+    InitializePipeline();
+
+    // Set up the slices
+    SetSliceStack();
+
+    // Render the preview and a progress bar until the loader is done
+    if (asyncLoading_) {
+        loading_ = true;
+        loaderThread_ = std::thread(&VolumeSlicer::LoadVolumeAsync, this);
+        return;
+    }
+
+    // Read the input volume
+    if (!ReadVolume()) {
+        loadFailed_.store(true, std::memory_order_release);
+        loading_ = true;
+        return;
+    }
+
+    // Upload the volume texture to the GPU
+    LoadVolumeTextures();
+}
+
+/**
+ * @brief VolumeSlicer::LoadVolumeTransform
+ * Multiplies the current matrix with the transformation from the unit
+ * volume cube to the view.
+ */
+void VolumeSlicer::LoadVolumeTransform()
+{
+    // Transform the viewing direction
+    glRotatef(-view_.camera.zRotation, 0.0, 0.0, 1.0);
+    glRotatef(-view_.camera.yRotation, 0.0, 1.0, 0.0);
+    glRotatef(-view_.camera.xRotation, 1.0, 0.0, 0.0);
+    glTranslatef(-0.5, -0.5, -0.5);
+}
+
+/**
+ * @brief VolumeSlicer::LoadTextureGen
+ * Loads the texture coordinate generation planes. Must be called with the
+ * volume transform on the model-view stack.
+ * @param textureScale Texture coordinate per unit of the cube.
+ * @param textureOffset Texture coordinate at the cube origin.
+ */
+void VolumeSlicer::LoadTextureGen(const QVector3D& textureScale,
+                                  const QVector3D& textureOffset)
+{
+    // Define equations for automatic texture coordinate generation
+    const GLfloat x[] = {textureScale.x(), 0.0, 0.0, textureOffset.x()};
+    const GLfloat y[] = {0.0, textureScale.y(), 0.0, textureOffset.y()};
+    const GLfloat z[] = {0.0, 0.0, textureScale.z(), textureOffset.z()};
+
+    // Take a copy of the model view matrix now shove it in to the GPU
+    // buffer for later use in automatic texture coord generation.
+    glTexGenfv(GL_S, GL_EYE_PLANE, x);
+    glTexGenfv(GL_T, GL_EYE_PLANE, y);
+    glTexGenfv(GL_R, GL_EYE_PLANE, z);
+}
+
+/**
+ * @brief VolumeSlicer::GetVolumeRotation
+ * @return Rotation from the unit volume cube, centred on the origin, to the
+ * view.
+ */
+QMatrix4x4 VolumeSlicer::GetVolumeRotation() const
+{
+    QMatrix4x4 rotation;
+    rotation.rotate(-view_.camera.zRotation, 0.0, 0.0, 1.0);
+    rotation.rotate(-view_.camera.yRotation, 0.0, 1.0, 0.0);
+    rotation.rotate(-view_.camera.xRotation, 1.0, 0.0, 0.0);
+    return rotation;
+}
+
+/**
+ * @brief VolumeSlicer::GetViewDirection
+ * @return Direction the camera looks at in the unit volume cube.
+ */
+QVector3D VolumeSlicer::GetViewDirection() const
+{
+    return GetVolumeRotation().inverted().mapVector(
+                QVector3D(0.0, 0.0, -1.0));
+}
+
+/**
+ * @brief VolumeSlicer::AddSliceBox
+ * @param boxMin Lower corner in voxels.
+ * @param boxMax Upper corner in voxels.
+ * @param brick Brick index, -1 for the single volume texture.
+ */
+void VolumeSlicer::AddSliceBox(const QVector3D& boxMin,
+                               const QVector3D& boxMax, int brick)
+{
+    const QVector3D volumeSize(volumeWidth_, volumeHeight_, volumeDepth_);
+
+    SliceBox box;
+    box.boxMin = boxMin / volumeSize;
+    box.boxMax = boxMax / volumeSize;
+    box.brick = brick;
+
+    // The core pipeline slices the box on the GPU
+    if (renderer_ == RENDERER_CORE) {
+        box.first = box.count = 0;
+        sliceBoxes_.push_back(box);
+        return;
+    }
+
+    sliceGeometry_.AddBox(box.boxMin, box.boxMax, &box.first, &box.count);
+
+    // Boxes that no slice crosses are not drawn at all
+    if (box.count > 0)
+        sliceBoxes_.push_back(box);
+}
+
+/**
+ * @brief VolumeSlicer::CollectBricks
+ * Adds the non-empty bricks from the farthest to the nearest one.
+ */
+void VolumeSlicer::CollectBricks()
+{
+    const QVector3D volumeSize(volumeWidth_, volumeHeight_, volumeDepth_);
+    const QVector<int> order =
+            brickCache_.GetVisibilityOrder(GetViewDirection() / volumeSize);
+
+    for (int i = 0; i < order.size(); i++) {
+        const BrickCache::Brick& brick = brickCache_.GetBrick(order[i]);
+        const QVector3D origin(brick.origin[0], brick.origin[1],
+                               brick.origin[2]);
+        const QVector3D size(brick.size[0], brick.size[1], brick.size[2]);
+
+        // Fully transparent bricks are neither paged in nor drawn
+        if (view_.skipEmptySpace &&
+                minMaxGrid_.IsEmpty(brick.origin[0] / brickSize_,
+                                    brick.origin[1] / brickSize_,
+                                    brick.origin[2] / brickSize_))
+            continue;
+
+        AddSliceBox(origin, origin + size, order[i]);
+    }
+}
+
+/**
+ * @brief VolumeSlicer::CollectCells
+ * Adds the runs of non-empty cells along x. The cells are walked back to
+ * front along every axis, which is a valid visibility order for a grid
+ * under an orthographic view, and a run is a contiguous piece of that
+ * order.
+ */
+void VolumeSlicer::CollectCells()
+{
+    const QVector3D viewDirection = GetViewDirection();
+    const int cellSize = minMaxGrid_.GetCellSize();
+    const int ni = minMaxGrid_.GetCellCount(0);
+    const int nj = minMaxGrid_.GetCellCount(1);
+    const int nk = minMaxGrid_.GetCellCount(2);
+
+    // The far end of an axis is the end the camera looks toward
+    const bool iBackward = viewDirection.x() > 0;
+    const bool jBackward = viewDirection.y() > 0;
+    const bool kBackward = viewDirection.z() > 0;
+
+    for (int kk = 0; kk < nk; kk++) {
+        const int k = kBackward ? nk - 1 - kk : kk;
+
+        for (int jj = 0; jj < nj; jj++) {
+            const int j = jBackward ? nj - 1 - jj : jj;
+
+            int runFirst = -1;
+            int runLast = -1;
+            for (int ii = 0; ii <= ni; ii++) {
+                const int i = iBackward ? ni - 1 - ii : ii;
+                const bool visible =
+                        (ii < ni) && !minMaxGrid_.IsEmpty(i, j, k);
+
+                if (visible) {
+                    if (runFirst < 0)
+                        runFirst = i;
+                    runLast = i;
+                    continue;
+                }
+
+                if (runFirst < 0)
+                    continue;
+
+                const QVector3D boxMin(qMin(runFirst, runLast) * cellSize,
+                                       j * cellSize, k * cellSize);
+                const QVector3D boxMax(
+                        qMin((qMax(runFirst, runLast) + 1) * cellSize,
+                             volumeWidth_),
+                        qMin((j + 1) * cellSize, volumeHeight_),
+                        qMin((k + 1) * cellSize, volumeDepth_));
+                AddSliceBox(boxMin, boxMax, -1);
+
+                runFirst = -1;
+            }
+        }
+    }
+}
+
+/**
+ * @brief VolumeSlicer::UpdateSliceGeometry
+ * Recomputes the slice polygons of all the boxes to draw and streams them
+ * into the vertex buffer, only when the view or the boxes changed.
+ */
+void VolumeSlicer::UpdateSliceGeometry()
+{
+    TRACE_SCOPE("VolumeSlicer::UpdateSliceGeometry");
+
+    const QMatrix4x4 rotation = GetVolumeRotation();
+    if (!sliceGeometryChanged_ && rotation == sliceRotation_)
+        return;
+
+    sliceRotation_ = rotation;
+    sliceGeometryChanged_ = false;
+
+    sliceGeometry_.SetRotation(rotation);
+    sliceGeometry_.Clear();
+    sliceBoxes_.clear();
+
+    if (UsingBricks()) {
+        CollectBricks();
+    } else if (view_.skipEmptySpace && !loading_) {
+        CollectCells();
+    } else {
+        AddSliceBox(QVector3D(0.0, 0.0, 0.0),
+                    QVector3D(volumeWidth_, volumeHeight_, volumeDepth_), -1);
+    }
+
+    if (renderer_ == RENDERER_CORE)
+        return;
+
+    const QVector<GLfloat>& vertices = sliceGeometry_.GetVertices();
+    sliceBuffer_.bind();
+    sliceBuffer_.allocate(vertices.constData(),
+                          vertices.size() * sizeof(GLfloat));
+    sliceBuffer_.release();
+}
+
+/**
+ * @brief VolumeSlicer::RenderFrame
+ */
+void VolumeSlicer::RenderFrame()
+{
+    // An offscreen frame is saved as it is, it cannot wait for bricks
+    if (UsingBricks())
+        brickCache_.BeginFrame(IsOffscreen() ? -1 : BrickCache::PAGE_IN_BUDGET);
+
+    if (renderer_ == RENDERER_SOFTWARE) {
+        RenderSoftwareFrame();
+        return;
+    }
+
+    // Bricks are only sliced, a ray would have to cross brick textures
+    if (view_.renderMode == RENDER_MODE_RAY_CASTING && !UsingBricks()) {
+        RenderRayCastFrame();
+        return;
+    }
+
+    if (renderer_ == RENDERER_CORE) {
+        RenderCoreFrame();
+        return;
+    }
+
+    glEnable(GL_TEXTURE_3D);
+    glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+    if (!UsingBricks()) {
+        glBindTexture(GL_TEXTURE_3D, volumeTextureId_);
+        SelectMipLevel();
+    }
+
+    // The scalar texture is classified in the fragment shader, which also
+    // corrects the opacities of an adapted slice distance
+    const float opacityExponent = GetOpacityExponent();
+    const bool sliceShader = (textureMode_ == TEXTURE_MODE_SCALAR ||
+                              opacityExponent != 1.f);
+    if (textureMode_ == TEXTURE_MODE_SCALAR) {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_1D, transferFunctionTextureId_);
+        glActiveTexture(GL_TEXTURE0);
+    }
+    if (sliceShader) {
+        sliceProgram_->bind();
+        sliceProgram_->setUniformValue("opacityExponent", opacityExponent);
+    }
+
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // Refresh the slice polygons if the view changed
+    UpdateSliceGeometry();
+
+    glPushMatrix ();
+    glScalef(view_.camera.scale, view_.camera.scale, view_.camera.scale);
+
+    // The whole volume shares one set of texture coordinates
+    if (!UsingBricks()) {
+        glPushMatrix ();
+        LoadVolumeTransform();
+        LoadTextureGen(QVector3D(1.0, 1.0, 1.0), QVector3D(0.0, 0.0, 0.0));
+        glPopMatrix ();
+    }
+
+    // Vertex array
+    sliceBuffer_.bind();
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, 0);
+
+    for (int i = 0; i < sliceBoxes_.size(); i++) {
+        const SliceBox& box = sliceBoxes_[i];
+
+        if (box.brick >= 0) {
+            QVector3D textureScale;
+            QVector3D textureOffset;
+            if (!BindBrick(box.brick, &textureScale, &textureOffset))
+                continue;
+
+            glPushMatrix ();
+            LoadVolumeTransform();
+            LoadTextureGen(textureScale, textureOffset);
+            glPopMatrix ();
+        }
+
+        // Render the slice polygons of the box
+        glDrawArrays(GL_TRIANGLES, box.first, box.count);
+    }
+
+    glDisableClientState(GL_VERTEX_ARRAY);
+    sliceBuffer_.release();
+
+    glPopMatrix ();
+
+    if (sliceShader)
+        sliceProgram_->release();
+
+    glDisable(GL_TEXTURE_3D);
+}
+
+/**
+ * @brief VolumeSlicer::BindBrick
+ * Makes a brick resident and binds its texture.
+ * @param brick
+ * @param textureScale Texture coordinate per unit of the volume cube.
+ * @param textureOffset Texture coordinate at the cube origin.
+ * @return
+ */
+bool VolumeSlicer::BindBrick(int brick, QVector3D* textureScale,
+                             QVector3D* textureOffset)
+{
+    const QVector3D volumeSize(volumeWidth_, volumeHeight_, volumeDepth_);
+    const float slotSize = brickCache_.GetSlotSize();
+    const BrickCache::Brick& bounds = brickCache_.GetBrick(brick);
+
+    // Page the brick in if needed and the frame has budget left
+    if (!brickCache_.Bind(brick))
+        return false;
+
+    // Texel t of the brick holds voxel origin - ghost + t
+    const QVector3D textureOrigin =
+            QVector3D(bounds.origin[0], bounds.origin[1], bounds.origin[2]) -
+            QVector3D(1.0, 1.0, 1.0) * BrickCache::GHOST_VOXELS;
+
+    *textureScale = volumeSize / slotSize;
+    *textureOffset = -textureOrigin / slotSize;
+    return true;
+}
+
+/**
+ * @brief VolumeSlicer::LoadModelViewMatrix
+ * Sets _modelViewMatrix_ to the transformation from the unit volume cube
+ * to the eye space.
+ */
+void VolumeSlicer::LoadModelViewMatrix()
+{
+    modelViewMatrix.setToIdentity();
+    modelViewMatrix.scale(view_.camera.scale);
+    modelViewMatrix *= GetVolumeRotation();
+    modelViewMatrix.translate(-0.5, -0.5, -0.5);
+}
+
+/**
+ * @brief VolumeSlicer::RenderRayCastFrame
+ */
+void VolumeSlicer::RenderRayCastFrame()
+{
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    LoadModelViewMatrix();
+
+    glBindTexture(GL_TEXTURE_3D, volumeTextureId_);
+    SelectMipLevel();
+    if (textureMode_ == TEXTURE_MODE_SCALAR) {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_1D, transferFunctionTextureId_);
+        glActiveTexture(GL_TEXTURE0);
     }
 
-    // Classification
-    ptr = rawVolume_;
-    GLubyte *qtr = rgbaVolume_;
-    GLubyte v, val;
-    for (i = 0; i < volume3dSize; i++) {
-        v = *(ptr++);
-        val = (v < 64) ? 0 : v - 64;
-        val = val >> 1;
-        *(qtr++) = val;
-        *(qtr++) = ((float)val) * 0.93;
-        *(qtr++) = ((float)val) * 0.78;
-        *(qtr++) = val;
+    // The rays jump over the empty cells once the volume is loaded
+    if (view_.skipEmptySpace && emptySpaceTextureId_ && !loading_) {
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_3D, emptySpaceTextureId_);
+        glActiveTexture(GL_TEXTURE0);
+
+        const float cellSize = minMaxGrid_.GetCellSize();
+        rayCaster_.SetEmptySpace(
+                    QVector3D(cellSize / volumeWidth_,
+                              cellSize / volumeHeight_,
+                              cellSize / volumeDepth_),
+                    QVector3D(minMaxGrid_.GetCellCount(0),
+                              minMaxGrid_.GetCellCount(1),
+                              minMaxGrid_.GetCellCount(2)));
+    } else {
+        rayCaster_.SetEmptySpace(QVector3D(), QVector3D());
     }
 
-    // Free the raw volume
-    delete [] rawVolume_;
+    // The transfer function opacities are the ones of a slice
+    rayCaster_.Render(projectionMatrix, modelViewMatrix, samplingStep_,
+                      referenceSpacing_);
 }
 
 /**
- * @brief VolumeSlicer::SetDisplayList
+ * @brief VolumeSlicer::RenderSoftwareFrame
+ * Ray casts the frame on the CPU and shows it through a window-sized
+ * texture.
  */
-void VolumeSlicer::SetDisplayList()
+void VolumeSlicer::RenderSoftwareFrame()
 {
-    // Size of the slice
-    float zSlice;
+    const float scale = view_.interacting ? interactionScale_ : 1.f;
+    const int imageWidth = qMax(1, (int) (windowWidth_ * scale));
+    const int imageHeight = qMax(1, (int) (windowHeight_ * scale));
+
+    const bool resized = (softwareImage_.width() != imageWidth ||
+                          softwareImage_.height() != imageHeight);
+    if (resized) {
+        softwareImage_ = QImage(imageWidth, imageHeight,
+                                QImage::Format_RGBA8888_Premultiplied);
+    }
 
-    // Diagonal size of the slice
-    const float diagonalSizeSquared = volumeWidth_*volumeWidth_ +
-            volumeHeight_*volumeHeight_ + volumeDepth_*volumeDepth_;
-    // Number of slices
-    const int halfSlicesMinus1  = 1.3 * sqrt(diagonalSizeSquared) / 4.0;
-    const int numSlices         = 2 * halfSlicesMinus1 + 1;
+    LoadModelViewMatrix();
+    if (view_.renderMode == RENDER_MODE_SHEAR_WARP) {
+        shearWarpRenderer_.Render(projectionMatrix, modelViewMatrix,
+                                  referenceSpacing_, &softwareImage_);
+    } else {
+        softwareRayCaster_.SetEmptySpace(
+                    (view_.skipEmptySpace && !loading_) ? &minMaxGrid_ : NULL);
+        softwareRayCaster_.Render(projectionMatrix, modelViewMatrix,
+                                  samplingStep_, referenceSpacing_,
+                                  &softwareImage_);
+    }
 
-    // Number of vertecies
-    const int numVertecies      = numSlices * 4;
+    // Upload the image
+    if (!softwareTextureId_) {
+        glGenTextures(1, &softwareTextureId_);
+        glBindTexture(GL_TEXTURE_2D, softwareTextureId_);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
 
-    // Slices
-    GLfloat *vPoints            = new GLfloat [3 * numVertecies];
-    GLfloat *ptr                = vPoints;
-    const float sliceArm        = sqrt(3.0) / numSlices;
-    const float sliceDistance   = 1;
+    glBindTexture(GL_TEXTURE_2D, softwareTextureId_);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, softwareImage_.bytesPerLine() / 4);
+    if (resized) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, imageWidth, imageHeight, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, softwareImage_.constBits());
+    } else {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, imageWidth, imageHeight,
+                        GL_RGBA, GL_UNSIGNED_BYTE, softwareImage_.constBits());
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 
-    for (int i = -halfSlicesMinus1; i <= halfSlicesMinus1; i++) {
+    DrawWindowTexture(softwareTextureId_, true);
+}
 
-        zSlice     = i * sliceArm;
+/**
+ * @brief VolumeSlicer::RenderCoreFrame
+ * Same frame as RenderFrame through the core-profile pipeline.
+ */
+void VolumeSlicer::RenderCoreFrame()
+{
+    glClear(GL_COLOR_BUFFER_BIT);
 
-        *(ptr++) = -sliceDistance;
-        *(ptr++) = -sliceDistance;
-        *(ptr++) =  zSlice;
+    // Refresh the boxes if the view changed
+    UpdateSliceGeometry();
 
-        *(ptr++) =  sliceDistance;
-        *(ptr++) = -sliceDistance;
-        *(ptr++) =  zSlice;
+    LoadModelViewMatrix();
 
-        *(ptr++) =  sliceDistance;
-        *(ptr++) =  sliceDistance;
-        *(ptr++) =  zSlice;
+    if (!UsingBricks()) {
+        glBindTexture(GL_TEXTURE_3D, volumeTextureId_);
+        SelectMipLevel();
+    }
 
-        *(ptr++) = -sliceDistance;
-        *(ptr++) =  sliceDistance;
-        *(ptr++) =  zSlice;
+    if (textureMode_ == TEXTURE_MODE_SCALAR) {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_1D, transferFunctionTextureId_);
+        glActiveTexture(GL_TEXTURE0);
     }
 
-    // Vertex array
-    glEnableClientState(GL_VERTEX_ARRAY);
-    glVertexPointer(3, GL_FLOAT, 0, vPoints);
+    const int halfSlices = (sliceGeometry_.GetSliceCount() - 1) / 2;
+    coreRenderer_.Begin(projectionMatrix, modelViewMatrix, halfSlices,
+                        sliceGeometry_.GetSpacing(), sliceGeometry_.GetOffset(),
+                        GetOpacityExponent());
+
+    for (int i = 0; i < sliceBoxes_.size(); i++) {
+        const SliceBox& box = sliceBoxes_[i];
 
-    // Generate the display list
-    displayList_ = glGenLists(1);
-    glNewList(displayList_, GL_COMPILE);
-    glDrawArrays(GL_QUADS, 0, numVertecies);
-    glEndList();
+        QVector3D textureScale(1.0, 1.0, 1.0);
+        QVector3D textureOffset(0.0, 0.0, 0.0);
+        if (box.brick >= 0 &&
+                !BindBrick(box.brick, &textureScale, &textureOffset))
+            continue;
 
-    delete [] vPoints;
+        coreRenderer_.DrawBox(box.boxMin, box.boxMax,
+                              textureScale, textureOffset);
+    }
+
+    coreRenderer_.End();
 }
 
 /**
- * @brief VolumeSlicer::Initialize
+ * @brief VolumeSlicer::Render
  */
-void VolumeSlicer::Initialize()
+void VolumeSlicer::Render()
 {
-    // Read the input volume
-    ReadVolume();
+    TRACE_SCOPE("VolumeSlicer::Render");
+
+    // The frames refining a still view repeat its camera
+    const bool refining = (accumulator_.GetFrameCount() > 0);
+    if (recordingCamera_ && !refining)
+        cameraPath_.Append(recordingTimer_.elapsed(), view_.camera);
+
+    // Nothing to draw but the progress until the preview is there
+    if (loading_) {
+        UpdateLoading();
+
+        // Nothing to draw anymore, the application is exiting
+        if (LoadFailed())
+            return;
+
+        if (loading_ && !previewLoaded_) {
+            glClear(GL_COLOR_BUFFER_BIT);
+            DrawLoadProgress();
+            RequestFrame();
+            return;
+        }
+    }
 
-    // Upload the volume texture to the GPU
-    LoadVolumeTextures();
+    // Apply transfer function edits with the context current, the loader
+    // classifies with the table it started with
+    if (!loading_ && view_.threshold != classifier_.GetThreshold()) {
+        classifier_.SetThreshold(view_.threshold);
+        UpdateTransferFunction();
+    }
+
+    // Slices of this frame for the zoom and the frame budget, the same
+    // ones until a still view is refined
+    if (!refining)
+        AdaptSliceCount();
+    SetSliceOffset(0.f);
+
+    // Dragging is fill-rate bound, trade resolution for frame rate. The
+    // software renderer scales its image down by itself.
+    if (view_.interacting && interactionScale_ < 1.f &&
+            renderer_ != RENDERER_SOFTWARE) {
+        RenderReduced();
+    } else if (!view_.interacting && refinementFrames_ > 0 && !loading_ &&
+               IsSlicing()) {
+        RenderRefinement();
+    } else {
+        RenderFrame();
+    }
+
+    // Bricks over the page-in budget come in over the next frames, the
+    // refinement starts over once the picture is complete
+    if (UsingBricks() && brickCache_.GetDeferredCount() > 0) {
+        accumulator_.Reset();
+        RequestFrame();
+    }
 
-    // Compile the display list
-    SetDisplayList();
+    // Keep polling the loader and moving the progress bar
+    if (loading_) {
+        DrawLoadProgress();
+        RequestFrame();
+    }
 }
 
 /**
- * @brief VolumeSlicer::RenderFrame
+ * @brief VolumeSlicer::RenderReduced
+ * Renders the frame into a downscaled framebuffer object without
+ * multisampling, and stretches it over the window.
  */
-void VolumeSlicer::RenderFrame()
+void VolumeSlicer::RenderReduced()
 {
-    glEnable(GL_TEXTURE_3D);
-    glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
-    glBindTexture(GL_TEXTURE_3D, volumeTextureId_);
-
-    glClear(GL_COLOR_BUFFER_BIT);
+    const QSize reducedSize(qMax(1, (int) (windowWidth_ * interactionScale_)),
+                            qMax(1, (int) (windowHeight_ * interactionScale_)));
+
+    // Reallocate the target only when the window or the scale changed
+    if (!interactionFbo_ || interactionFbo_->size() != reducedSize) {
+        delete interactionFbo_;
+        interactionFbo_ = new QOpenGLFramebufferObject(reducedSize);
+
+        glBindTexture(GL_TEXTURE_2D, interactionFbo_->texture());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
 
-    // Clip planes
-    static GLdouble eqx0[4] = { 1.0, 0.0, 0.0, 0.0};
-    static GLdouble eqx1[4] = {-1.0, 0.0, 0.0, 1.0};
-    static GLdouble eqy0[4] = {0.0,  1.0, 0.0, 0.0};
-    static GLdouble eqy1[4] = {0.0, -1.0, 0.0, 1.0};
-    static GLdouble eqz0[4] = {0.0, 0.0,  1.0, 0.0};
-    static GLdouble eqz1[4] = {0.0, 0.0, -1.0, 1.0};
+    interactionFbo_->bind();
+    glViewport(0, 0, reducedSize.width(), reducedSize.height());
+    RenderFrame();
+    interactionFbo_->release();
+    glViewport(0, 0, windowWidth_, windowHeight_);
+
+    // There is no fixed-function quad in a core profile, and the core
+    // window is single-sampled so it can be a blit target
+    if (renderer_ == RENDERER_CORE) {
+        QOpenGLFramebufferObject::blitFramebuffer(
+                    NULL, QRect(0, 0, windowWidth_, windowHeight_),
+                    interactionFbo_, QRect(QPoint(0, 0), reducedSize),
+                    GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        return;
+    }
 
-    // Define equations for automatic texture coordinate generation
-    static GLfloat x[] = {1.0, 0.0, 0.0, 0.0};
-    static GLfloat y[] = {0.0, 1.0, 0.0, 0.0};
-    static GLfloat z[] = {0.0, 0.0, 1.0, 0.0};
+    DrawWindowTexture(interactionFbo_->texture(), false);
+}
 
-    glPushMatrix ();
-    glScalef(volumeScale_, volumeScale_, volumeScale_);
+/**
+ * @brief RadicalInverse
+ * @param index
+ * @param base
+ * @return The digits of _index_ mirrored about the radix point, a low
+ * discrepancy sequence in [0, 1) that starts at 0.
+ */
+static float RadicalInverse(int index, int base)
+{
+    float inverse = 0.f;
+    float digitWeight = 1.f / base;
+    for (; index > 0; index /= base) {
+        inverse += (index % base) * digitWeight;
+        digitWeight /= base;
+    }
+    return inverse;
+}
 
-    glPushMatrix ();
+/**
+ * @brief VolumeSlicer::RenderRefinement
+ * The first frame is the plain one. The next ones move the slices along
+ * the view axis and the pixel centres within the pixels by stratified
+ * fractions of their spacing, so the average samples the volume more
+ * densely than any single frame.
+ */
+void VolumeSlicer::RenderRefinement()
+{
+    TRACE_SCOPE("VolumeSlicer::RenderRefinement");
+
+    const int frame = accumulator_.GetFrameCount();
+    SetSliceOffset(RadicalInverse(frame, 5));
+
+    // Offsets in [-0.5, 0.5) pixels, 0 for the first frame
+    const float pixelX = RadicalInverse(frame, 2);
+    const float pixelY = RadicalInverse(frame, 3);
+    QMatrix4x4 jitter;
+    jitter.translate(2.f * (pixelX - floor(pixelX + 0.5f)) / windowWidth_,
+                     2.f * (pixelY - floor(pixelY + 0.5f)) / windowHeight_);
+    const QMatrix4x4 projection = projectionMatrix;
+    projectionMatrix = jitter * projection;
+    if (renderer_ != RENDERER_CORE) {
+        glMatrixMode(GL_PROJECTION);
+        glLoadMatrixf(projectionMatrix.constData());
+        glMatrixMode(GL_MODELVIEW);
+    }
 
-    // Transform the viewing direction
-    glRotatef(-zRotation_, 0.0, 0.0, 1.0);
-    glRotatef(-yRotation_, 0.0, 1.0, 0.0);
-    glRotatef(-xRotation_, 1.0, 0.0, 0.0);
-    glTranslatef(-0.5, -0.5, -0.5);
+    accumulator_.BeginFrame(QSize(windowWidth_, windowHeight_));
+    RenderFrame();
+    accumulator_.EndFrame();
 
-    // Take a copy of the model view matrix now shove it in to the GPU
-    // buffer for later use in automatic texture coord generation.
-    glTexGenfv(GL_S, GL_EYE_PLANE, x);
-    glTexGenfv(GL_T, GL_EYE_PLANE, y);
-    glTexGenfv(GL_R, GL_EYE_PLANE, z);
+    projectionMatrix = projection;
+    if (renderer_ != RENDERER_CORE) {
+        glMatrixMode(GL_PROJECTION);
+        glLoadMatrixf(projectionMatrix.constData());
+        glMatrixMode(GL_MODELVIEW);
+    }
 
-    // Take a copy of the model view matrix and shove it in to the GPU
-    // buffer for later use in clipping planes.
-    glClipPlane(GL_CLIP_PLANE0, eqx0);
-    glClipPlane(GL_CLIP_PLANE1, eqx1);
-    glClipPlane(GL_CLIP_PLANE2, eqy0);
-    glClipPlane(GL_CLIP_PLANE3, eqy1);
-    glClipPlane(GL_CLIP_PLANE4, eqz0);
-    glClipPlane(GL_CLIP_PLANE5, eqz1);
+    // One frame at a time, input is handled between them
+    if (accumulator_.GetFrameCount() < refinementFrames_)
+        RequestFrame();
+}
 
-    glPopMatrix ();
+/**
+ * @brief VolumeSlicer::DrawWindowTexture
+ * Stretches a 2D texture over the whole window.
+ * @param textureId
+ * @param topDown The first row of the texture is the top of the image.
+ */
+void VolumeSlicer::DrawWindowTexture(GLuint textureId, bool topDown)
+{
+    const GLfloat bottom = topDown ? 1.0 : 0.0;
+    const GLfloat top = 1.0 - bottom;
 
-    // Enable clip planes
-    glEnable(GL_CLIP_PLANE0);
-    glEnable(GL_CLIP_PLANE1);
-    glEnable(GL_CLIP_PLANE2);
-    glEnable(GL_CLIP_PLANE3);
-    glEnable(GL_CLIP_PLANE4);
-    glEnable(GL_CLIP_PLANE5);
+    // The frame is already composited, copy it as is
+    glDisable(GL_BLEND);
+    glDisable(GL_TEXTURE_GEN_S);
+    glDisable(GL_TEXTURE_GEN_T);
+    glDisable(GL_TEXTURE_GEN_R);
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, textureId);
 
-    // Render enclosing rectangles
-    glCallList(displayList_);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
 
-    glPopMatrix ();
+    glClear(GL_COLOR_BUFFER_BIT);
+    glBegin(GL_QUADS);
+    glTexCoord2f(0.0, bottom); glVertex2f(-1.0, -1.0);
+    glTexCoord2f(1.0, bottom); glVertex2f( 1.0, -1.0);
+    glTexCoord2f(1.0, top);    glVertex2f( 1.0,  1.0);
+    glTexCoord2f(0.0, top);    glVertex2f(-1.0,  1.0);
+    glEnd();
+
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
 
-    glDisable(GL_TEXTURE_3D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_TEXTURE_2D);
+    glEnable(GL_TEXTURE_GEN_S);
+    glEnable(GL_TEXTURE_GEN_T);
+    glEnable(GL_TEXTURE_GEN_R);
+    glEnable(GL_BLEND);
 }
 
 /**
- * @brief VolumeSlicer::Render
+ * @brief VolumeSlicer::SettleInteraction
  */
-void VolumeSlicer::Render()
+void VolumeSlicer::SettleInteraction()
 {
-    RenderFrame();
+    interacting_ = false;
+
+    // One full quality frame
+    RenderLater();
 }
 
 /**
@@ -303,40 +1520,98 @@ void VolumeSlicer::ResizeGLWindow(int windowWidth, int windowHeight)
         windowHeight = 1;
     }
 
+    // Restored after rendering into a reduced target
+    windowWidth_ = windowWidth;
+    windowHeight_ = windowHeight;
+
     // Adjust the viewing port
     glViewport(0, 0, (GLsizei) windowWidth, (GLsizei) windowHeight);
 
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-
     // Orthographic projection
     GLfloat windowSize = 1.0;
     GLfloat aspect = (GLfloat) windowHeight/(GLfloat) windowWidth;
+
+    // Adjust the MVP matrix, used by the core-profile pipeline
+    projectionMatrix.setToIdentity();
+    projectionMatrix.ortho(-windowSize, windowSize,
+                           -windowSize * aspect, windowSize * aspect,
+                           -windowSize, windowSize);
+    modelViewMatrix.setToIdentity();
+
+    // There are no matrix stacks in a core profile
+    if (renderer_ == RENDERER_CORE)
+        return;
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
     glOrtho(-windowSize, windowSize,
             -windowSize * aspect, windowSize * aspect,
             -windowSize, windowSize);
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
-
-    /*
-    // Adjust the MVP matrix
-    projectionMatrix.setToIdentity();
-    projectionMatrix.perspective(45, (float) windowWidth / (float)windowHeight,
-                                 1, 1000);
-    modelViewMatrix.setToIdentity();
-    */
 }
 
 /**
- * @brief VolumeSlicer::LoadVolumeTextures
+ * @brief VolumeSlicer::InitializePipeline
+ * Sets up everything that does not depend on the volume data, so that the
+ * preview can be rendered while the volume is loading.
  */
-void VolumeSlicer::LoadVolumeTextures()
+void VolumeSlicer::InitializePipeline()
 {
+    TRACE_SCOPE("VolumeSlicer::InitializePipeline");
+
     // Clear buffers
     glClearColor (0.0, 0.0, 0.0, 0.0);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-    // Generate the volume texture on the GPU
+    // The volume stays in memory, OpenGL only shows the image
+    if (renderer_ == RENDERER_SOFTWARE) {
+        softwareRayCaster_.SetThreadPool(&threadPool_);
+        qDebug() << "Software ray casting with the"
+                 << softwareRayCaster_.GetKernelName() << "kernel on"
+                 << threadPool_.GetThreadCount() << "threads";
+        return;
+    }
+
+    if (renderer_ == RENDERER_CORE) {
+        // The texture coordinates come from the vertex shader
+        if (!coreRenderer_.Initialize(textureMode_ == TEXTURE_MODE_SCALAR))
+            exit(0);
+    } else {
+        // For automatic texture coordinate generation
+        glTexGeni(GL_S, GL_TEXTURE_GEN_MODE, GL_EYE_LINEAR);
+        glTexGeni(GL_T, GL_TEXTURE_GEN_MODE, GL_EYE_LINEAR);
+        glTexGeni(GL_R, GL_TEXTURE_GEN_MODE, GL_EYE_LINEAR);
+
+        // Enable automatic texture generation
+        glEnable(GL_TEXTURE_GEN_S);
+        glEnable(GL_TEXTURE_GEN_T);
+        glEnable(GL_TEXTURE_GEN_R);
+    }
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_BLEND);
+
+    // Available next to the slicer, toggled at runtime
+    if (!rayCaster_.Initialize(renderer_ == RENDERER_CORE,
+                               textureMode_ == TEXTURE_MODE_SCALAR))
+        exit(0);
+
+    if (textureMode_ == TEXTURE_MODE_SCALAR) {
+        // Classification happens at sample time
+        LoadTransferFunction();
+    }
+
+    // The core pipeline has its own program
+    if (renderer_ != RENDERER_CORE)
+        LoadSliceProgram();
+
+    // Without the shaders a still view is simply not refined
+    if (refinementFrames_ > 0 &&
+            !accumulator_.Initialize(renderer_ == RENDERER_CORE))
+        refinementFrames_ = 0;
+
+    // Generate the volume texture on the GPU, it also holds the preview
+    // of a bricked volume
     glGenTextures(1, &volumeTextureId_);
     glBindTexture(GL_TEXTURE_3D, volumeTextureId_);
 
@@ -346,23 +1621,401 @@ void VolumeSlicer::LoadVolumeTextures()
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+}
+
+/**
+ * @brief VolumeSlicer::LoadVolumeTextures
+ * Hands the loaded volume to the renderer.
+ */
+void VolumeSlicer::LoadVolumeTextures()
+{
+    TRACE_SCOPE("VolumeSlicer::LoadVolumeTextures");
 
-    // For automatic texture coordinate generation
-    glTexGeni(GL_S, GL_TEXTURE_GEN_MODE, GL_EYE_LINEAR);
-    glTexGeni(GL_T, GL_TEXTURE_GEN_MODE, GL_EYE_LINEAR);
-    glTexGeni(GL_R, GL_TEXTURE_GEN_MODE, GL_EYE_LINEAR);
+    // The volume stays in memory, OpenGL only shows the image
+    if (renderer_ == RENDERER_SOFTWARE) {
+        softwareRayCaster_.SetVolume(rgbaVolume_, volumeWidth_,
+                                     volumeHeight_, volumeDepth_);
 
-    // Upload the texture to the GPU
-    glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA,
-                 volumeWidth_, volumeHeight_, volumeDepth_,
-                 0, GL_RGBA, GL_UNSIGNED_BYTE, rgbaVolume_);
+        // Run-length-encoded copies for the shear-warp mode
+        shearWarpRenderer_.Build(rgbaVolume_, volumeWidth_, volumeHeight_,
+                                 volumeDepth_, &threadPool_);
+        return;
+    }
 
-    // Enable automatic texture generation
-    glEnable(GL_TEXTURE_GEN_S);
-    glEnable(GL_TEXTURE_GEN_T);
-    glEnable(GL_TEXTURE_GEN_R);
-    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_BLEND);
+    // The bricks are paged in while rendering
+    if (bricked_) {
+        glDeleteTextures(1, &volumeTextureId_);
+        volumeTextureId_ = 0;
+
+        brickCache_.Initialize(&volumeFile_, &classifier_,
+                               volumeWidth_, volumeHeight_, volumeDepth_,
+                               brickSize_, brickMemory_,
+                               textureMode_ == TEXTURE_MODE_SCALAR);
+        return;
+    }
+
+    LoadEmptySpaceTexture();
+
+    glBindTexture(GL_TEXTURE_3D, volumeTextureId_);
+
+    // Only the coarse levels stay resident if the volume does not fit
+    const int bytesPerVoxel = (textureMode_ == TEXTURE_MODE_SCALAR) ? 1 : 4;
+    mipFinestLevel_ = pyramid_.GetFinestLevel(mipMemory_, bytesPerVoxel);
+    mipLevel_ = mipFinestLevel_;
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_BASE_LEVEL, mipLevel_);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL,
+                    pyramid_.GetLevelCount() - 1);
+    LoadPyramidLevels();
+
+    if (mipFinestLevel_ > 0) {
+        // The finest levels do not fit, the raw volume is not needed
+        CloseVolumeFile();
+    } else if (textureMode_ == TEXTURE_MODE_SCALAR) {
+        // Upload the raw scalars as a single-channel texture, straight from
+        // the mapped volume
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_R8,
+                     volumeWidth_, volumeHeight_, volumeDepth_,
+                     0, GL_RED, GL_UNSIGNED_BYTE, rawVolume_);
+
+        // The raw volume is read-only, so the outline goes into the texture
+        LoadScalarOutline();
+
+        // The raw volume is not needed anymore
+        CloseVolumeFile();
+    } else {
+        // Upload the texture to the GPU
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA,
+                     volumeWidth_, volumeHeight_, volumeDepth_,
+                     0, GL_RGBA, GL_UNSIGNED_BYTE, rgbaVolume_);
+    }
+}
+
+/**
+ * @brief VolumeSlicer::LoadScalarOutline
+ * Writes the box around the volume into the scalar texture as the twelve
+ * 4x4-voxel edges of the bounding box.
+ */
+void VolumeSlicer::LoadScalarOutline()
+{
+    const int band = VolumeClassifier::OUTLINE_WIDTH;
+    const int size[3] = { volumeWidth_, volumeHeight_, volumeDepth_ };
+
+    // Large enough for the longest edge
+    const int longestEdge = qMax(volumeWidth_,
+                                 qMax(volumeHeight_, volumeDepth_));
+    QVector<GLubyte> edge(band * band * longestEdge,
+                          VolumeClassifier::OUTLINE_VALUE);
+
+    // Every edge runs along one axis and sits at the low or high end of the
+    // two others
+    for (int axis = 0; axis < 3; axis++) {
+        const int u = (axis + 1) % 3;
+        const int v = (axis + 2) % 3;
+
+        for (int corner = 0; corner < 4; corner++) {
+            int offset[3];
+            int extent[3];
+
+            offset[axis] = 0;
+            extent[axis] = size[axis];
+
+            offset[u] = (corner & 1) ? qMax(0, size[u] - band) : 0;
+            extent[u] = qMin(band, size[u]);
+
+            offset[v] = (corner & 2) ? qMax(0, size[v] - band) : 0;
+            extent[v] = qMin(band, size[v]);
+
+            glTexSubImage3D(GL_TEXTURE_3D, 0,
+                            offset[0], offset[1], offset[2],
+                            extent[0], extent[1], extent[2],
+                            GL_RED, GL_UNSIGNED_BYTE, edge.constData());
+        }
+    }
+}
+
+/**
+ * @brief VolumeSlicer::LoadPyramidLevels
+ */
+void VolumeSlicer::LoadPyramidLevels()
+{
+    TRACE_SCOPE("VolumeSlicer::LoadPyramidLevels");
+
+    QVector<GLubyte> rgbaLevel;
+    for (int level = qMax(mipFinestLevel_, 1);
+         level < pyramid_.GetLevelCount(); level++) {
+        const GLubyte* scalars = pyramid_.GetLevelData(level);
+        const int width = pyramid_.GetLevelSize(level, 0);
+        const int height = pyramid_.GetLevelSize(level, 1);
+        const int depth = pyramid_.GetLevelSize(level, 2);
+
+        if (textureMode_ == TEXTURE_MODE_SCALAR) {
+            glTexImage3D(GL_TEXTURE_3D, level, GL_R8, width, height, depth,
+                         0, GL_RED, GL_UNSIGNED_BYTE, scalars);
+        } else {
+            // The outline is part of the scalars already
+            const qint64 voxels = pyramid_.GetLevelVoxelCount(level);
+            rgbaLevel.resize(voxels * 4);
+            classifier_.Classify(scalars, rgbaLevel.data(), voxels);
+            glTexImage3D(GL_TEXTURE_3D, level, GL_RGBA, width, height, depth,
+                         0, GL_RGBA, GL_UNSIGNED_BYTE, rgbaLevel.constData());
+        }
+    }
+
+    // Classification happens on the GPU, the levels are not needed anymore
+    if (textureMode_ == TEXTURE_MODE_SCALAR)
+        pyramid_.Clear();
+}
+
+/**
+ * @brief VolumeSlicer::SelectMipLevel
+ * A voxel of the full resolution covers the zoom / longest side of
+ * the two units the window spans. Once two or more voxels fall on a pixel,
+ * the next level loses nothing.
+ */
+void VolumeSlicer::SelectMipLevel()
+{
+    const int levelCount = pyramid_.GetLevelCount();
+    if (loading_ || levelCount <= 1)
+        return;
+
+    // Dragging renders at a reduced resolution, the footprint grows with it
+    const float voxelPixels = GetVoxelPixels();
+
+    int level = 0;
+    if (voxelPixels > 0.f && voxelPixels < 0.5f)
+        level = (int) floor(log2(1.f / voxelPixels));
+
+    // The empty cells are only empty down to the level they were built for
+    if (view_.skipEmptySpace)
+        level = qMin(level, emptySpaceMipLevel_);
+    level = qBound(mipFinestLevel_, level, levelCount - 1);
+
+    if (level != mipLevel_) {
+        mipLevel_ = level;
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_BASE_LEVEL, mipLevel_);
+    }
+}
+
+/**
+ * @brief VolumeSlicer::GetPixelScale
+ * @return
+ */
+float VolumeSlicer::GetPixelScale() const
+{
+    // The software renderer scales its own image, not the window
+    return (view_.interacting && renderer_ != RENDERER_SOFTWARE) ?
+                interactionScale_ : 1.f;
+}
+
+/**
+ * @brief VolumeSlicer::GetVoxelPixels
+ * @return
+ */
+float VolumeSlicer::GetVoxelPixels() const
+{
+    const int longestSide = qMax(volumeWidth_,
+                                 qMax(volumeHeight_, volumeDepth_));
+    return 0.5f * windowWidth_ * GetPixelScale() * view_.camera.scale /
+            longestSide;
+}
+
+/**
+ * @brief VolumeSlicer::IsSlicing
+ * @return
+ */
+bool VolumeSlicer::IsSlicing() const
+{
+    // Bricks are only sliced, a ray would have to cross brick textures
+    return renderer_ != RENDERER_SOFTWARE &&
+            (view_.renderMode != RENDER_MODE_RAY_CASTING || UsingBricks());
+}
+
+/**
+ * @brief VolumeSlicer::AdaptSliceCount
+ */
+void VolumeSlicer::AdaptSliceCount()
+{
+    if (!sliceController_.IsEnabled() || loading_ || !IsSlicing())
+        return;
+
+    // The CPU and the GPU overlap, the slower one bounds the frame
+    const FrameStatistics& statistics = GetFrameStatistics();
+    const float frameCost =
+            qMax(statistics.GetLast(FrameStatistics::SERIES_RENDER),
+                 statistics.GetLast(FrameStatistics::SERIES_GPU));
+    const float pixelScale = GetPixelScale();
+    const int slices = sliceController_.Update(frameCost, GetVoxelPixels(),
+                                               pixelScale * pixelScale);
+
+    // An odd count keeps a plane through the centre
+    const int halfSlices = (slices - 1) / 2;
+    if (2 * halfSlices + 1 == sliceGeometry_.GetSliceCount())
+        return;
+
+    sliceGeometry_.SetSlices(halfSlices, sqrt(3.0) / (2 * halfSlices + 1));
+    sliceGeometryChanged_ = true;
+}
+
+/**
+ * @brief VolumeSlicer::SetSliceOffset
+ * @param offset
+ */
+void VolumeSlicer::SetSliceOffset(float offset)
+{
+    if (offset == sliceGeometry_.GetOffset())
+        return;
+
+    sliceGeometry_.SetOffset(offset);
+    sliceGeometryChanged_ = true;
+}
+
+/**
+ * @brief VolumeSlicer::GetOpacityExponent
+ * @return
+ */
+float VolumeSlicer::GetOpacityExponent() const
+{
+    return sliceGeometry_.GetSpacing() / referenceSpacing_;
+}
+
+/**
+ * @brief VolumeSlicer::LoadTransferFunction
+ * Creates the 1D lookup texture that classifies the scalar texture.
+ */
+void VolumeSlicer::LoadTransferFunction()
+{
+    glGenTextures(1, &transferFunctionTextureId_);
+    glBindTexture(GL_TEXTURE_1D, transferFunctionTextureId_);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA, 256, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, classifier_.GetLookupTable());
+}
+
+/**
+ * @brief VolumeSlicer::LoadEmptySpaceTexture
+ * Uploads the distance of every cell to the nearest non-empty one, which
+ * the ray caster reads with nearest filtering at the cell centres.
+ */
+void VolumeSlicer::LoadEmptySpaceTexture()
+{
+    const int ni = minMaxGrid_.GetCellCount(0);
+    const int nj = minMaxGrid_.GetCellCount(1);
+    const int nk = minMaxGrid_.GetCellCount(2);
+    QVector<GLubyte> distances(ni * nj * nk);
+    minMaxGrid_.GetDistanceField(distances.data());
+
+    if (!emptySpaceTextureId_) {
+        glGenTextures(1, &emptySpaceTextureId_);
+        glBindTexture(GL_TEXTURE_3D, emptySpaceTextureId_);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, 0);
+    }
+
+    glBindTexture(GL_TEXTURE_3D, emptySpaceTextureId_);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_R8, ni, nj, nk, 0,
+                 GL_RED, GL_UNSIGNED_BYTE, distances.constData());
+}
+
+/**
+ * @brief VolumeSlicer::LoadSliceProgram
+ */
+void VolumeSlicer::LoadSliceProgram()
+{
+    QByteArray fragmentSource("#version 120\n");
+    if (textureMode_ == TEXTURE_MODE_SCALAR)
+        fragmentSource += "#define SCALAR_TEXTURE\n";
+
+    // Only the fragment stage is replaced, the vertices and the texture
+    // coordinates still come from the fixed-function pipeline. The scalar
+    // is rescaled so that it hits the centres of the table texels.
+    fragmentSource +=
+        "uniform sampler3D volume;\n"
+        "uniform sampler1D transferFunction;\n"
+        "uniform float opacityExponent;\n"
+        "void main()\n"
+        "{\n"
+        "    vec4 color = texture3D(volume, gl_TexCoord[0].stp);\n"
+        "#ifdef SCALAR_TEXTURE\n"
+        "    color = texture1D(transferFunction,\n"
+        "                      color.r * (255.0 / 256.0) + 0.5 / 256.0);\n"
+        "#endif\n"
+        "    if (color.a > 0.0)\n"
+        "        color *= (1.0 - pow(1.0 - color.a, opacityExponent)) / color.a;\n"
+        "    gl_FragColor = color;\n"
+        "}\n";
+
+    sliceProgram_ = new QOpenGLShaderProgram();
+    sliceProgram_->addShaderFromSourceCode(QOpenGLShader::Fragment,
+                                           fragmentSource);
+    if (!sliceProgram_->link()) {
+        qDebug() << "Could not link the slicing shader "
+                 << sliceProgram_->log();
+        exit(0);
+    }
+
+    sliceProgram_->bind();
+    sliceProgram_->setUniformValue("volume", 0);
+    sliceProgram_->setUniformValue("transferFunction", 1);
+    sliceProgram_->release();
+}
+
+/**
+ * @brief VolumeSlicer::UpdateTransferFunction
+ * Pushes the current lookup table to the GPU. With a scalar texture this
+ * is a 256-entry upload, with an RGBA texture the whole volume has to be
+ * classified and uploaded again.
+ */
+void VolumeSlicer::UpdateTransferFunction()
+{
+    TRACE_SCOPE("VolumeSlicer::UpdateTransferFunction");
+
+    // Cells that were empty may be visible now and the other way around
+    minMaxGrid_.Classify(classifier_.GetLookupTable());
+    sliceGeometryChanged_ = true;
+    if (emptySpaceTextureId_)
+        LoadEmptySpaceTexture();
+
+    if (textureMode_ == TEXTURE_MODE_SCALAR) {
+        glBindTexture(GL_TEXTURE_1D, transferFunctionTextureId_);
+        glTexSubImage1D(GL_TEXTURE_1D, 0, 0, 256, GL_RGBA, GL_UNSIGNED_BYTE,
+                        classifier_.GetLookupTable());
+        return;
+    }
+
+    // Bricks are classified again when they are paged back in
+    if (bricked_) {
+        brickCache_.Invalidate();
+        return;
+    }
+
+    // Keep the current classification if the file went away
+    if (!OpenVolumeFile())
+        return;
+    ClassifyVolume();
+    CloseVolumeFile();
+
+    // The software renderers read the RGBA volume directly
+    if (renderer_ == RENDERER_SOFTWARE) {
+        shearWarpRenderer_.Build(rgbaVolume_, volumeWidth_, volumeHeight_,
+                                 volumeDepth_, &threadPool_);
+        return;
+    }
+
+    glBindTexture(GL_TEXTURE_3D, volumeTextureId_);
+    if (mipFinestLevel_ == 0) {
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0,
+                        volumeWidth_, volumeHeight_, volumeDepth_,
+                        GL_RGBA, GL_UNSIGNED_BYTE, rgbaVolume_);
+    }
+
+    // The reduced levels are classified again from their scalars
+    LoadPyramidLevels();
 }
 
 /**
@@ -406,11 +2059,66 @@ void VolumeSlicer::keyPressEvent(QKeyEvent *event)
     case Qt::Key_V:
         volumeScale_ /= 1.1;
         break;
+    case Qt::Key_R:
+        // The software renderer has no slicing, the GPU no shear-warp
+        if (renderer_ == RENDERER_SOFTWARE) {
+            renderMode_ = (renderMode_ == RENDER_MODE_SHEAR_WARP) ?
+                        RENDER_MODE_RAY_CASTING : RENDER_MODE_SHEAR_WARP;
+        } else {
+            renderMode_ = (renderMode_ == RENDER_MODE_SLICING) ?
+                        RENDER_MODE_RAY_CASTING : RENDER_MODE_SLICING;
+        }
+        break;
+    case Qt::Key_E:
+        skipEmptySpace_ = !skipEmptySpace_;
+        break;
+    case Qt::Key_T:
+        threshold_ = qMin(threshold_ + 4, 255);
+        break;
+    case Qt::Key_G:
+        threshold_ = qMax(threshold_ - 4, 0);
+        break;
+    case Qt::Key_H:
+        ToggleFrameStatistics();
+        break;
 
     case Qt::Key_Escape:
         qApp->exit();
         break;
+
+    default:
+        // Unhandled keys leave the view as it is
+        QWindow::keyPressEvent(event);
+        return;
     }
 
+    // Every key above changes the view
+    RenderLater();
+
     QWindow::keyPressEvent(event);
 }
+
+/**
+ * @brief VolumeSlicer::mousePressEvent
+ * @param event
+ */
+void VolumeSlicer::mousePressEvent(QMouseEvent *event)
+{
+    interacting_ = true;
+    settleTimer_.stop();
+
+    OpenGLWindow::mousePressEvent(event);
+}
+
+/**
+ * @brief VolumeSlicer::mouseReleaseEvent
+ * @param event
+ */
+void VolumeSlicer::mouseReleaseEvent(QMouseEvent *event)
+{
+    // Wait until no button is held any more
+    if (event->buttons() == Qt::NoButton)
+        settleTimer_.start();
+
+    QWindow::mouseReleaseEvent(event);
+}
@@ -21,19 +21,250 @@
 #define TEXTUREMAPPINGWINDOW_H
 
 #include "OpenGLWindow.h"
+#include "VolumeFile.h"
+#include "VolumeClassifier.h"
+#include "ThreadPool.h"
+#include "BrickCache.h"
+#include "MinMaxGrid.h"
+#include "VolumePyramid.h"
+#include "SliceGeometry.h"
+#include "SliceCountController.h"
+#include "FrameAccumulator.h"
+#include "CoreSliceRenderer.h"
+#include "RayCastRenderer.h"
+#include "SoftwareRayCaster.h"
+#include "ShearWarpRenderer.h"
+#include "CameraPath.h"
 #include <QOpenGLShaderProgram>
+#include <QOpenGLBuffer>
+#include <QOpenGLFramebufferObject>
+#include <QTimer>
+#include <QVector>
+#include <thread>
+#include <atomic>
 
 class VolumeSlicer : public OpenGLWindow
 {
     Q_OBJECT
 
 public:
+    /**
+     * @brief The TextureMode enum
+     * How the volume is stored on the GPU.
+     */
+    enum TextureMode {
+        /** Classified on the CPU, 4 bytes per voxel */
+        TEXTURE_MODE_RGBA,
+
+        /** Raw 8-bit scalars classified in the fragment shader */
+        TEXTURE_MODE_SCALAR
+    };
+
+    /**
+     * @brief The BrickingMode enum
+     * Whether the volume is split into bricks paged in on demand.
+     */
+    enum BrickingMode {
+        /** Only if the volume does not fit in one texture */
+        BRICKING_MODE_AUTO,
+
+        /** Always */
+        BRICKING_MODE_ON,
+
+        /** Never */
+        BRICKING_MODE_OFF
+    };
+
+    /**
+     * @brief The Renderer enum
+     * OpenGL pipeline used to draw the slices.
+     */
+    enum Renderer {
+        /** Fixed-function, compatibility profile */
+        RENDERER_LEGACY,
+
+        /** Shaders and instancing, OpenGL 3.3 core profile */
+        RENDERER_CORE,
+
+        /** Ray casting on the CPU, OpenGL only shows the image */
+        RENDERER_SOFTWARE
+    };
+
+    /**
+     * @brief The RenderMode enum
+     * How the volume is turned into pixels.
+     */
+    enum RenderMode {
+        /** View-aligned slices blended back to front */
+        RENDER_MODE_SLICING,
+
+        /** One ray per pixel, front to back with early termination */
+        RENDER_MODE_RAY_CASTING,
+
+        /** Sheared slices of a run-length-encoded volume, software only */
+        RENDER_MODE_SHEAR_WARP
+    };
 
     explicit VolumeSlicer(QWindow *parent = 0, char* volumePrefix = "");
     ~VolumeSlicer();
 
     void ResizeGLWindow(int windowWidth, int windowHeight);
 
+    /**
+     * @brief SetLoadMode
+     * Selects how the .img file is brought into memory, must be called
+     * before the window is shown.
+     * @param loadMode
+     */
+    void SetLoadMode(VolumeFile::LoadMode loadMode);
+
+    /**
+     * @brief SetClassifierKernel
+     * Overrides the classification kernel picked from the CPU features.
+     * @param kernel
+     */
+    void SetClassifierKernel(VolumeClassifier::Kernel kernel);
+
+    /**
+     * @brief SetThreadCount
+     * Number of threads used to load the volume, 0 for all cores.
+     * @param threadCount
+     */
+    void SetThreadCount(int threadCount);
+
+    /**
+     * @brief SetTextureMode
+     * Must be called before the window is shown.
+     * @param textureMode
+     */
+    void SetTextureMode(TextureMode textureMode);
+
+    /**
+     * @brief SetBricking
+     * Must be called before the window is shown.
+     * @param brickingMode
+     * @param brickSize Edge of a brick in voxels.
+     * @param brickMemory Bytes of texture memory for the resident bricks,
+     * also the largest single texture in auto mode.
+     */
+    void SetBricking(BrickingMode brickingMode, int brickSize,
+                     qint64 brickMemory);
+
+    /**
+     * @brief SetMipPyramid
+     * Must be called before the window is shown. The pyramid is only built
+     * for a single GPU volume texture.
+     * @param filter Reduction between two levels, FILTER_NONE to always
+     * sample the full resolution.
+     * @param textureMemory Bytes of texture memory for the volume and its
+     * levels, the finest levels are left out if they do not fit. 0 for no
+     * limit.
+     */
+    void SetMipPyramid(VolumePyramid::Filter filter, qint64 textureMemory);
+
+    /**
+     * @brief SetInteractionQuality
+     * While a mouse button is held, the frames are rendered at a reduced
+     * resolution and stretched over the window.
+     * @param scale Fraction of the window resolution, 1 to disable.
+     * @param settleDelay Milliseconds after the release of the mouse until
+     * a full quality frame is rendered.
+     */
+    void SetInteractionQuality(float scale, int settleDelay);
+
+    /**
+     * @brief SetRenderer
+     * Must be called before the window is shown, the core renderer needs a
+     * 3.3 core-profile surface format.
+     * @param renderer
+     */
+    void SetRenderer(Renderer renderer);
+
+    /**
+     * @brief SetRenderMode
+     * Can be toggled at runtime with the R key.
+     * @param renderMode
+     */
+    void SetRenderMode(RenderMode renderMode);
+
+    /**
+     * @brief SetSamplingStep
+     * Must be called before the window is shown.
+     * @param voxels Distance between two ray-casting samples in voxels.
+     */
+    void SetSamplingStep(float voxels);
+
+    /**
+     * @brief SetTargetFrameRate
+     * Adapts the number of slices to the zoom and to the measured frame
+     * times. Must be called before the window is shown.
+     * @param framesPerSecond Frame rate to hold, 0 keeps the number of
+     * slices given by the volume size.
+     */
+    void SetTargetFrameRate(float framesPerSecond);
+
+    /**
+     * @brief SetRefinement
+     * Keeps improving a still view after the first frame, by averaging
+     * frames with the slices and the pixel centres moved by fractions of
+     * their spacing. Any change of the view starts over. Must be called
+     * before the window is shown.
+     * @param frames Frames averaged at most, 0 to disable.
+     */
+    void SetRefinement(int frames);
+
+    /**
+     * @brief SetCamera
+     * Places the camera without rendering a frame, as the offscreen mode
+     * renders the views one after the other.
+     * @param xRotation Rotation about the X axis in degrees.
+     * @param yRotation Rotation about the Y axis in degrees.
+     * @param zRotation Rotation about the Z axis in degrees.
+     * @param scale Zoom factor, 1 fits the volume in the view.
+     */
+    void SetCamera(float xRotation, float yRotation, float zRotation,
+                   float scale);
+
+    /**
+     * @brief GetCameraState
+     * @return
+     */
+    CameraState GetCameraState() const;
+
+    /**
+     * @brief SetCameraState
+     * Places the camera without rendering a frame, for replays.
+     * @param camera
+     */
+    void SetCameraState(const CameraState& camera);
+
+    /**
+     * @brief StartCameraRecording
+     * Records the camera of every frame rendered from now on.
+     */
+    void StartCameraRecording();
+
+    /**
+     * @brief GetCameraPath
+     * @return The camera of every frame since StartCameraRecording.
+     */
+    const CameraPath& GetCameraPath() const;
+
+    /**
+     * @brief SetAsyncLoading
+     * Loads the volume on a background thread and shows a low-resolution
+     * preview until it is ready, the default. Has to be called before the
+     * window is shown.
+     * @param asyncLoading
+     */
+    void SetAsyncLoading(bool asyncLoading);
+
+    /**
+     * @brief LoadFailed
+     * @return True if the volume files could not be read.
+     */
+    bool LoadFailed() const;
+
 protected:
     /**
      * @brief Initialize
@@ -45,44 +276,336 @@ protected:
      */
     void Render();
 
+    /**
+     * @brief PublishState
+     */
+    void PublishState();
+
+    /**
+     * @brief SynchronizeState
+     */
+    void SynchronizeState();
+
     /**
      * @brief keyPressEvent
      * @param event
      */
     void keyPressEvent(QKeyEvent *event);
 
+    /**
+     * @brief mousePressEvent
+     * @param event
+     */
+    void mousePressEvent(QMouseEvent *event);
+
+    /**
+     * @brief mouseReleaseEvent
+     * @param event
+     */
+    void mouseReleaseEvent(QMouseEvent *event);
+
+private slots:
+    /**
+     * @brief SettleInteraction
+     */
+    void SettleInteraction();
+
 private:
+    /**
+     * @brief The ViewState struct
+     * Everything the UI thread edits and the renderer reads.
+     */
+    struct ViewState
+    {
+        /** \brief Camera */
+        CameraState camera;
+
+        /** \brief Rendering technique */
+        RenderMode renderMode;
+
+        /** \brief Do not draw the fully transparent cells */
+        bool skipEmptySpace;
+
+        /** \brief Transfer function threshold */
+        int threshold;
+
+        /** \brief The mouse is dragging */
+        bool interacting;
+    };
+
+    /**
+     * @brief GetViewState
+     * @return
+     */
+    ViewState GetViewState() const;
 
     /**
      * @brief ReadHeader
+     * @return False if the header file could not be read.
      */
-    void ReadHeader();
+    bool ReadHeader();
 
     /**
      * @brief ReadVolume
+     * @return False if the volume file could not be read.
+     */
+    bool ReadVolume();
+
+    /**
+     * @brief UseBricks
+     * @return
+     */
+    bool UseBricks();
+
+    /**
+     * @brief OpenVolumeFile
+     * @return False if the volume file is missing or too short.
+     */
+    bool OpenVolumeFile();
+
+    /**
+     * @brief CloseVolumeFile
+     */
+    void CloseVolumeFile();
+
+    /**
+     * @brief ClassifyVolume
+     * Fills the RGBA volume from the raw volume.
      */
-    void ReadVolume();
+    void ClassifyVolume();
 
     /**
      * @brief InitializeVolume
      */
     void InitializeVolume();
 
+    /**
+     * @brief InitializePipeline
+     */
+    void InitializePipeline();
+
     /**
      * @brief LoadVolumeTextures
      */
     void LoadVolumeTextures();
 
     /**
-     * @brief SetDisplayList
+     * @brief LoadVolumeAsync
+     * Body of the loader thread.
+     */
+    void LoadVolumeAsync();
+
+    /**
+     * @brief BuildPreview
+     */
+    void BuildPreview();
+
+    /**
+     * @brief LoadPreviewTexture
+     */
+    void LoadPreviewTexture();
+
+    /**
+     * @brief UpdateLoading
+     * Exits the application if the load failed.
+     */
+    void UpdateLoading();
+
+    /**
+     * @brief DrawLoadProgress
+     */
+    void DrawLoadProgress();
+
+    /**
+     * @brief UsingBricks
+     * @return True if the frame is drawn from the brick cache, the preview
+     * is a single texture.
+     */
+    bool UsingBricks() const { return bricked_ && !loading_; }
+
+    /**
+     * @brief LoadScalarOutline
+     */
+    void LoadScalarOutline();
+
+    /**
+     * @brief LoadPyramidLevels
+     * Uploads the resident reduced levels as mipmaps of the volume texture.
+     */
+    void LoadPyramidLevels();
+
+    /**
+     * @brief SelectMipLevel
+     * Samples the bound volume texture from the level whose voxels are
+     * closest to the size of a pixel.
      */
-    void SetDisplayList();
+    void SelectMipLevel();
+
+    /**
+     * @brief GetPixelScale
+     * @return Resolution of the frame relative to the window.
+     */
+    float GetPixelScale() const;
+
+    /**
+     * @brief GetVoxelPixels
+     * @return Pixels across a voxel of the full resolution volume.
+     */
+    float GetVoxelPixels() const;
+
+    /**
+     * @brief LoadTransferFunction
+     */
+    void LoadTransferFunction();
+
+    /**
+     * @brief LoadEmptySpaceTexture
+     */
+    void LoadEmptySpaceTexture();
+
+    /**
+     * @brief LoadSliceProgram
+     * Builds the fragment shader of the fixed-function slicing.
+     */
+    void LoadSliceProgram();
+
+    /**
+     * @brief IsSlicing
+     * @return The frames are drawn as a stack of slices.
+     */
+    bool IsSlicing() const;
+
+    /**
+     * @brief AdaptSliceCount
+     * Sets the slices of the next frame from the zoom and the frame times.
+     */
+    void AdaptSliceCount();
+
+    /**
+     * @brief SetSliceOffset
+     * @param offset Shift of the slices as a fraction of their spacing.
+     */
+    void SetSliceOffset(float offset);
+
+    /**
+     * @brief GetOpacityExponent
+     * @return Ratio between the slice distance and the reference one.
+     */
+    float GetOpacityExponent() const;
+
+    /**
+     * @brief UpdateTransferFunction
+     */
+    void UpdateTransferFunction();
+
+    /**
+     * @brief SetSliceStack
+     */
+    void SetSliceStack();
+
+    /**
+     * @brief LoadVolumeTransform
+     */
+    void LoadVolumeTransform();
+
+    /**
+     * @brief LoadTextureGen
+     * @param textureScale
+     * @param textureOffset
+     */
+    void LoadTextureGen(const QVector3D& textureScale,
+                        const QVector3D& textureOffset);
+
+    /**
+     * @brief GetVolumeRotation
+     * @return
+     */
+    QMatrix4x4 GetVolumeRotation() const;
+
+    /**
+     * @brief GetViewDirection
+     * @return
+     */
+    QVector3D GetViewDirection() const;
+
+    /**
+     * @brief AddSliceBox
+     * @param boxMin
+     * @param boxMax
+     * @param brick
+     */
+    void AddSliceBox(const QVector3D& boxMin, const QVector3D& boxMax,
+                     int brick);
+
+    /**
+     * @brief CollectBricks
+     */
+    void CollectBricks();
+
+    /**
+     * @brief CollectCells
+     */
+    void CollectCells();
+
+    /**
+     * @brief UpdateSliceGeometry
+     */
+    void UpdateSliceGeometry();
 
     /**
      * @brief RenderFrame
      */
     void RenderFrame();
 
+    /**
+     * @brief RenderReduced
+     */
+    void RenderReduced();
+
+    /**
+     * @brief RenderRefinement
+     * Adds one jittered frame to the average of the still view and shows
+     * the average.
+     */
+    void RenderRefinement();
+
+    /**
+     * @brief LoadModelViewMatrix
+     */
+    void LoadModelViewMatrix();
+
+    /**
+     * @brief RenderRayCastFrame
+     */
+    void RenderRayCastFrame();
+
+    /**
+     * @brief RenderSoftwareFrame
+     */
+    void RenderSoftwareFrame();
+
+    /**
+     * @brief DrawWindowTexture
+     * @param textureId
+     * @param topDown
+     */
+    void DrawWindowTexture(GLuint textureId, bool topDown);
+
+    /**
+     * @brief RenderCoreFrame
+     */
+    void RenderCoreFrame();
+
+    /**
+     * @brief BindBrick
+     * @param brick
+     * @param textureScale
+     * @param textureOffset
+     * @return False if the brick is deferred to a later frame.
+     */
+    bool BindBrick(int brick, QVector3D* textureScale,
+                   QVector3D* textureOffset);
+
 private:
 
     /** \brief Volume prefix */
@@ -100,8 +623,8 @@ private:
     /** \brief Volume scale */
     float volumeScale_;
 
-    /** \brief Volume raw image */
-    GLubyte* rawVolume_;
+    /** \brief Volume raw image, owned by _volumeFile_ */
+    const GLubyte* rawVolume_;
 
     /** \brief Volume image with RGBA components */
     GLubyte* rgbaVolume_;
@@ -109,11 +632,217 @@ private:
     /** \brief Volume texture ID */
     GLuint volumeTextureId_;
 
-    /** \brief Sampling step */
+    /** \brief Sampling step of the ray caster in the unit cube */
     float samplingStep_;
 
-    /** \brief Display list */
-    GLuint displayList_;
+    /**
+     * @brief The SliceBox struct
+     * Range of the slice vertices drawn for one box of the volume.
+     */
+    struct SliceBox
+    {
+        /** \brief First vertex */
+        int first;
+
+        /** \brief Number of vertices */
+        int count;
+
+        /** \brief Brick index, -1 for the single volume texture */
+        int brick;
+
+        /** \brief Bounds in the unit volume cube */
+        QVector3D boxMin;
+        QVector3D boxMax;
+    };
+
+    /** \brief Mapped or streamed volume file */
+    VolumeFile volumeFile_;
+
+    /** \brief How the volume file is loaded */
+    VolumeFile::LoadMode loadMode_;
+
+    /** \brief Transfer function and outline */
+    VolumeClassifier classifier_;
+
+    /** \brief Workers shared by the parallel stages */
+    ThreadPool threadPool_;
+
+    /** \brief How the volume is stored on the GPU */
+    TextureMode textureMode_;
+
+    /** \brief Transfer function lookup texture ID */
+    GLuint transferFunctionTextureId_;
+
+    /** \brief Classifies the scalar texture and corrects the opacities of
+     * the fixed-function slicing */
+    QOpenGLShaderProgram* sliceProgram_;
+
+    /** \brief Whether the volume is split into bricks */
+    BrickingMode brickingMode_;
+
+    /** \brief Edge of a brick in voxels */
+    int brickSize_;
+
+    /** \brief Bytes of texture memory for the resident bricks */
+    qint64 brickMemory_;
+
+    /** \brief The volume is rendered from bricks */
+    bool bricked_;
+
+    /** \brief Resident bricks */
+    BrickCache brickCache_;
+
+    /** \brief Scalar range of the cells or bricks of the volume */
+    MinMaxGrid minMaxGrid_;
+
+    /** \brief Reduced copies of the volume */
+    VolumePyramid pyramid_;
+
+    /** \brief Reduction filter of the pyramid */
+    VolumePyramid::Filter mipFilter_;
+
+    /** \brief Bytes of texture memory for the volume and its levels */
+    qint64 mipMemory_;
+
+    /** \brief Finest level uploaded to the GPU */
+    int mipFinestLevel_;
+
+    /** \brief Level the volume texture is sampled from */
+    int mipLevel_;
+
+    /** \brief Coarsest level sampled while empty space is skipped */
+    int emptySpaceMipLevel_;
+
+    /** \brief Do not draw the fully transparent cells */
+    bool skipEmptySpace_;
+
+    /** \brief View-aligned slice polygons */
+    SliceGeometry sliceGeometry_;
+
+    /** \brief Slice distance the opacities of the volume are defined
+     * for, the one of the slices given by the volume size */
+    float referenceSpacing_;
+
+    /** \brief Number of slices for the zoom and the frame budget */
+    SliceCountController sliceController_;
+
+    /** \brief Average of the frames of a still view */
+    FrameAccumulator accumulator_;
+
+    /** \brief Frames averaged at most, 0 if disabled */
+    int refinementFrames_;
+
+    /** \brief Boxes to draw, back to front */
+    QVector<SliceBox> sliceBoxes_;
+
+    /** \brief Vertex buffer holding the slice polygons */
+    QOpenGLBuffer sliceBuffer_;
+
+    /** \brief Rotation the slice polygons were computed for */
+    QMatrix4x4 sliceRotation_;
+
+    /** \brief The slice polygons have to be computed again */
+    bool sliceGeometryChanged_;
+
+    /** \brief Window size in pixels */
+    int windowWidth_;
+    int windowHeight_;
+
+    /** \brief Resolution scale while interacting */
+    float interactionScale_;
+
+    /** \brief A mouse button is held or was released recently */
+    bool interacting_;
+
+    /** \brief Reduced-resolution render target */
+    QOpenGLFramebufferObject* interactionFbo_;
+
+    /** \brief Delays the full quality frame after an interaction */
+    QTimer settleTimer_;
+
+    /** \brief OpenGL pipeline */
+    Renderer renderer_;
+
+    /** \brief Instanced slicing for the core profile */
+    CoreSliceRenderer coreRenderer_;
+
+    /** \brief Slicing or ray casting */
+    RenderMode renderMode_;
+
+    /** \brief Sampling step of the ray caster in voxels */
+    float samplingVoxels_;
+
+    /** \brief GPU ray caster */
+    RayCastRenderer rayCaster_;
+
+    /** \brief Distance field of the empty cells for the GPU ray caster */
+    GLuint emptySpaceTextureId_;
+
+    /** \brief CPU ray caster */
+    SoftwareRayCaster softwareRayCaster_;
+
+    /** \brief CPU shear-warp renderer */
+    ShearWarpRenderer shearWarpRenderer_;
+
+    /** \brief Frame of the CPU renderers */
+    QImage softwareImage_;
+
+    /** \brief Texture showing _softwareImage_ */
+    GLuint softwareTextureId_;
+
+    /** \brief The camera of every frame is recorded */
+    bool recordingCamera_;
+
+    /** \brief Started with the recording */
+    QElapsedTimer recordingTimer_;
+
+    /** \brief Recorded camera path */
+    CameraPath cameraPath_;
+
+    /** \brief The volume is read on a background thread */
+    bool asyncLoading_;
+
+    /** \brief The loader thread has not been picked up yet */
+    bool loading_;
+
+    /** \brief The preview has been handed to the renderer */
+    bool previewLoaded_;
+
+    /** \brief Reads and classifies the volume */
+    std::thread loaderThread_;
+
+    /** \brief Progress of the loader thread in per mille */
+    std::atomic<int> loadProgress_;
+
+    /** \brief Set by the loader thread once the preview is built */
+    std::atomic<bool> previewReady_;
+
+    /** \brief Set by the loader thread once the volume is ready */
+    std::atomic<bool> volumeLoaded_;
+
+    /** \brief Set instead of _volumeLoaded_ if the volume could not be read */
+    std::atomic<bool> loadFailed_;
+
+    /** \brief Point-sampled raw volume shown while loading */
+    QVector<GLubyte> previewRawVolume_;
+
+    /** \brief Classified preview */
+    QVector<GLubyte> previewRgbaVolume_;
+
+    /** \brief Preview dimensions */
+    int previewWidth_;
+    int previewHeight_;
+    int previewDepth_;
+
+    /** \brief Transfer function threshold set on the UI thread, the
+     * renderer applies it to the classifier */
+    int threshold_;
+
+    /** \brief View states from the UI thread */
+    TripleBuffer<ViewState> viewStates_;
+
+    /** \brief State of the frame being rendered */
+    ViewState view_;
 };
 
 #endif // TEXTUREMAPPINGWINDOW_H
@@ -24,10 +24,50 @@ greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 TARGET = VolumeSlicer
 INSTALLS += target
 TEMPLATE = app
+CONFIG += c++11
 
 SOURCES +=      RunVolumeSlicer.cpp \
                 OpenGLWindow.cpp \
-                VolumeSlicer.cpp
+                VolumeSlicer.cpp \
+                VolumeFile.cpp \
+                VolumeClassifier.cpp \
+                ThreadPool.cpp \
+                BrickCache.cpp \
+                MinMaxGrid.cpp \
+                VolumePyramid.cpp \
+                SliceGeometry.cpp \
+                SliceCountController.cpp \
+                FrameAccumulator.cpp \
+                CoreSliceRenderer.cpp \
+                RayCastRenderer.cpp \
+                ShaderPrelude.cpp \
+                SoftwareRayCaster.cpp \
+                ShearWarpRenderer.cpp \
+                FrameReadback.cpp \
+                FrameStatistics.cpp \
+                GpuTimer.cpp \
+                Trace.cpp \
+                CameraPath.cpp
 
 HEADERS +=      OpenGLWindow.h \
-                VolumeSlicer.h
+                VolumeSlicer.h \
+                VolumeFile.h \
+                VolumeClassifier.h \
+                ThreadPool.h \
+                BrickCache.h \
+                MinMaxGrid.h \
+                VolumePyramid.h \
+                SliceGeometry.h \
+                SliceCountController.h \
+                FrameAccumulator.h \
+                CoreSliceRenderer.h \
+                RayCastRenderer.h \
+                ShaderPrelude.h \
+                SoftwareRayCaster.h \
+                ShearWarpRenderer.h \
+                FrameReadback.h \
+                FrameStatistics.h \
+                GpuTimer.h \
+                Trace.h \
+                CameraPath.h \
+                TripleBuffer.h
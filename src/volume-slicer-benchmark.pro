@@ -0,0 +1,47 @@
+ ###############################################################################
+ #
+ # Copyrights Marwan Abdellah 2014 <marwan.m.abdellah@ieee.org>
+ #
+ # This program is free software: you can redistribute it and/or modify
+ # it under the terms of the GNU General Public License as published by
+ # the Free Software Foundation, either version 3 of the License, or
+ # (at your option) any later version.
+ #
+ # This program is distributed in the hope that it will be useful,
+ # but WITHOUT ANY WARRANTY; without even the implied warranty of
+ # MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ # GNU General Public License for more details.
+ #
+ # You should have received a copy of the GNU General Public License
+ # along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ #
+ ##############################################################################
+
+# Benchmark of the CPU stages of the load path, needs no display
+
+QT       += core gui
+QT       -= widgets
+
+TARGET = VolumeSlicerBenchmark
+TEMPLATE = app
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+SOURCES +=      RunBenchmark.cpp \
+                PhantomGenerator.cpp \
+                VolumeFile.cpp \
+                VolumeClassifier.cpp \
+                ThreadPool.cpp \
+                MinMaxGrid.cpp \
+                VolumePyramid.cpp \
+                SliceGeometry.cpp \
+                Trace.cpp
+
+HEADERS +=      PhantomGenerator.h \
+                VolumeFile.h \
+                VolumeClassifier.h \
+                ThreadPool.h \
+                MinMaxGrid.h \
+                VolumePyramid.h \
+                SliceGeometry.h \
+                Trace.h